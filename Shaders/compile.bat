@@ -1,3 +1,6 @@
 C:/VulkanSDK/1.3.216.0/Bin/glslc.exe shader.vert -o vert.spv
+C:/VulkanSDK/1.3.216.0/Bin/glslc.exe -DPACKED_VERTEX shader.vert -o vert_packed.spv
 C:/VulkanSDK/1.3.216.0/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.3.216.0/Bin/glslc.exe -DVIRTUAL_TEXTURE shader.frag -o frag_virtual.spv
+C:/VulkanSDK/1.3.216.0/Bin/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
 pause
\ No newline at end of file
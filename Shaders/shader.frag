@@ -1,6 +1,66 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+// Entries in the texture table, set by the pipeline to the binding's descriptor count
+layout(constant_id = 0) const uint texture_table_size = 1;
+
+// One entry per texture array, see texture_packer.h
+layout(binding = 1) uniform sampler2DArray textures[texture_table_size];
+
+// Per draw material: texture table entry and where the texture sits in that array
+layout(push_constant) uniform Material {
+    vec4 texture_transform;   // scale, offset into the array layer
+    vec4 texture_bounds;      // min, max
+    uint texture_index;
+    uint texture_layer;
+    vec2 feedback_scale;      // framebuffer pixel to feedback texel
+} material;
+
+#ifdef VIRTUAL_TEXTURE
+// Virtual texture size, level count and page cache slots per side, see virtual_texture.h
+layout(constant_id = 1) const uint virtual_width = 1;
+layout(constant_id = 2) const uint virtual_height = 1;
+layout(constant_id = 3) const uint virtual_levels = 1;
+layout(constant_id = 4) const uint cache_slots = 1;
+
+const uint page_size = 128;
+const uint page_border = 4;
+const uint slot_size = page_size + 2 * page_border;
+const uint feedback_extent = 128;
+
+layout(binding = 2) uniform sampler2D page_cache;
+// A layer per level: slot x, slot y, level of the finest resident page, and 255 once set
+layout(binding = 3) uniform usampler2DArray page_table;
+// The page each part of the screen wanted, read back by the host
+layout(binding = 4) buffer Feedback {
+    uint pages[];
+} feedback;
+
+vec4 sample_virtual(vec2 uv) {
+   vec2 texel = uv * vec2(virtual_width, virtual_height);
+   vec2 texel_dx = dFdx(texel);
+   vec2 texel_dy = dFdy(texel);
+   float lod = 0.5 * log2(max(dot(texel_dx, texel_dx), dot(texel_dy, texel_dy)));
+   uint level = uint(clamp(lod, 0.0, float(virtual_levels - 1)));
+
+   texel = clamp(texel, vec2(0.0), vec2(virtual_width, virtual_height) - 1.0);
+   uvec2 page = uvec2(texel) / (page_size << level);
+
+   uvec2 feedback_texel = min(uvec2(gl_FragCoord.xy * material.feedback_scale), uvec2(feedback_extent - 1));
+   feedback.pages[feedback_texel.y * feedback_extent + feedback_texel.x] = (level << 24) | (page.y << 12) | page.x;
+
+   uvec4 entry = texelFetch(page_table, ivec3(page, level), 0);
+   if (entry.a == 0) {
+      return vec4(1.0);
+   }
+
+   // The resident page may be coarser than the one asked for
+   float resident_page_size = float(page_size << entry.b);
+   vec2 in_page = fract(texel / resident_page_size) * float(page_size);
+   vec2 cache_texel = vec2(entry.rg * slot_size + page_border) + in_page;
+
+   return textureLod(page_cache, cache_texel / float(cache_slots * slot_size), 0.0);
+}
+#endif
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -8,7 +68,19 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-   // outColor = texture(texSampler, fragTexCoord);
-   // outColor = texture(texSampler, fragTexCoord * 2.0);
-   outColor = vec4(fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
-}
\ No newline at end of file
+#ifdef VIRTUAL_TEXTURE
+   vec4 texel = sample_virtual(fract(fragTexCoord));
+   outColor = vec4(fragColor * texel.rgb, 1.0);
+#else
+   // Wrapping is done here so atlas neighbours are never sampled; the gradients of the
+   // unwrapped coordinates keep the mip selection continuous across the wrap
+   vec2 uv = fract(fragTexCoord) * material.texture_transform.xy + material.texture_transform.zw;
+   uv = clamp(uv, material.texture_bounds.xy, material.texture_bounds.zw);
+
+   vec2 uv_dx = dFdx(fragTexCoord) * material.texture_transform.xy;
+   vec2 uv_dy = dFdy(fragTexCoord) * material.texture_transform.xy;
+
+   vec4 texel = textureGrad(textures[material.texture_index], vec3(uv, material.texture_layer), uv_dx, uv_dy);
+   outColor = vec4(fragColor * texel.rgb, 1.0);
+#endif
+}
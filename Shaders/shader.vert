@@ -4,17 +4,28 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 position_scale;
+    vec4 position_offset;
 } ubo;
 
+#ifdef PACKED_VERTEX
+// snorm16 position relative to the mesh bounds, unorm16 texture coordinates, no colour
+layout(location = 0) in vec4 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+const vec3 inColor = vec3(1.0);
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
+#endif
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec3 position = inPosition.xyz * ubo.position_scale.xyz + ubo.position_offset.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
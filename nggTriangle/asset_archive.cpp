@@ -0,0 +1,284 @@
+#include "asset_archive.h"
+#include "hash_utils.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace
+{
+constexpr std::array<char, 8> archive_magic{ 'N', 'G', 'G', 'P', 'A', 'C', 'K', '\0' };
+constexpr uint64_t payload_alignment = 64;
+
+struct archive_header_t
+{
+   std::array<char, 8> magic;
+   uint32_t version;
+   uint32_t entry_count;
+   uint64_t toc_offset;
+   uint64_t names_offset;
+   uint64_t names_size;
+};
+
+static_assert( std::is_trivially_copyable_v<archive_header_t> );
+
+auto align_up(
+   uint64_t value,
+   uint64_t alignment )
+   -> uint64_t
+{
+   return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+}   // namespace
+
+asset_archive_t::asset_archive_t(
+   const std::filesystem::path& path )
+   : file( path )
+{
+   auto bytes = file.data();
+   if ( bytes.size() < sizeof( archive_header_t ) )
+   {
+      throw std::runtime_error( "asset archive too small: " + path.string() );
+   }
+
+   archive_header_t header;
+   std::memcpy( &header, bytes.data(), sizeof( header ) );
+
+   if ( header.magic != archive_magic || header.version != version )
+   {
+      throw std::runtime_error( "not an asset archive of this version: " + path.string() );
+   }
+
+   uint64_t toc_size = uint64_t{ header.entry_count } * sizeof( toc_entry_t );
+   if ( header.toc_offset % alignof( toc_entry_t ) != 0 || header.toc_offset + toc_size > bytes.size() ||
+        header.names_offset + header.names_size > bytes.size() )
+   {
+      throw std::runtime_error( "asset archive truncated: " + path.string() );
+   }
+
+   toc = {
+      reinterpret_cast<const toc_entry_t*>( bytes.data() + header.toc_offset ),
+      static_cast<size_t>( header.entry_count ) };
+
+   names = {
+      reinterpret_cast<const char*>( bytes.data() + header.names_offset ),
+      static_cast<size_t>( header.names_size ) };
+
+   for ( size_t i = 0;
+         i < toc.size();
+         ++i )
+   {
+      const auto& entry = toc[i];
+      if ( entry.name_offset + entry.name_size > names.size() || entry.offset + entry.size > bytes.size() ||
+           entry.offset % payload_alignment != 0 )
+      {
+         throw std::runtime_error( "asset archive truncated: " + path.string() );
+      }
+
+      // find() relies on the order
+      if ( i > 0 && name_of( toc[i - 1] ) >= name_of( entry ) )
+      {
+         throw std::runtime_error( "asset archive table of contents not sorted: " + path.string() );
+      }
+   }
+}
+
+void asset_archive_t::write(
+   const std::filesystem::path& archive_path,
+   std::span<const asset_archive_input_t> inputs )
+{
+   std::vector<const asset_archive_input_t*> sorted;
+   for ( const auto& input : inputs )
+   {
+      sorted.push_back( &input );
+   }
+
+   std::sort(
+      sorted.begin(),
+      sorted.end(),
+      []( const asset_archive_input_t* a, const asset_archive_input_t* b )
+      {
+         return a->name < b->name;
+      } );
+
+   for ( size_t i = 1;
+         i < sorted.size();
+         ++i )
+   {
+      if ( sorted[i - 1]->name == sorted[i]->name )
+      {
+         throw std::runtime_error( "asset archive input named twice: " + sorted[i]->name );
+      }
+   }
+
+   // Inputs are hashed in parallel while mapped, then streamed out in order
+   std::vector<mapped_file_t> files( sorted.size() );
+   std::vector<toc_entry_t> entries( sorted.size() );
+
+   thread_pool_t::shared().parallel_for(
+      sorted.size(),
+      [&]( size_t i )
+      {
+         files[i] = mapped_file_t( sorted[i]->path );
+         entries[i].size = files[i].data().size();
+         entries[i].content_hash = hash_utils::hash_bytes( files[i].data() );
+      } );
+
+   std::string name_table;
+   for ( size_t i = 0;
+         i < sorted.size();
+         ++i )
+   {
+      entries[i].name_offset = name_table.size();
+      entries[i].name_size = static_cast<uint32_t>( sorted[i]->name.size() );
+      name_table += sorted[i]->name;
+   }
+
+   archive_header_t header{};
+   header.magic = archive_magic;
+   header.version = version;
+   header.entry_count = static_cast<uint32_t>( entries.size() );
+   header.toc_offset = align_up( sizeof( header ), payload_alignment );
+   header.names_offset = header.toc_offset + entries.size() * sizeof( toc_entry_t );
+   header.names_size = name_table.size();
+
+   uint64_t offset = align_up( header.names_offset + header.names_size, payload_alignment );
+   for ( auto& entry : entries )
+   {
+      entry.offset = offset;
+      offset = align_up( offset + entry.size, payload_alignment );
+   }
+
+   // Write to a temporary file first so a crash never leaves a truncated archive behind
+   auto temp_path = archive_path;
+   temp_path += ".tmp";
+
+   {
+      std::ofstream out( temp_path, std::ios::binary | std::ios::trunc );
+      if ( !out.is_open() )
+      {
+         throw std::runtime_error( "failed to create asset archive!" );
+      }
+
+      std::array<char, payload_alignment> padding{};
+      uint64_t written = 0;
+
+      auto write_bytes =
+         [&]( const void* data, uint64_t size )
+         {
+            out.write( static_cast<const char*>( data ), static_cast<std::streamsize>( size ) );
+            written += size;
+         };
+
+      auto pad_to =
+         [&]( uint64_t target )
+         {
+            write_bytes( padding.data(), target - written );
+         };
+
+      write_bytes( &header, sizeof( header ) );
+      pad_to( header.toc_offset );
+      write_bytes( entries.data(), entries.size() * sizeof( toc_entry_t ) );
+      write_bytes( name_table.data(), name_table.size() );
+
+      for ( size_t i = 0;
+            i < entries.size();
+            ++i )
+      {
+         pad_to( entries[i].offset );
+         write_bytes( files[i].data().data(), entries[i].size );
+      }
+
+      if ( !out )
+      {
+         throw std::runtime_error( "failed to write asset archive!" );
+      }
+   }
+
+   std::filesystem::rename( temp_path, archive_path );
+}
+
+auto asset_archive_t::find(
+   std::string_view name ) const
+   -> std::optional<asset_entry_t>
+{
+   auto it =
+      std::lower_bound(
+         toc.begin(),
+         toc.end(),
+         name,
+         [&]( const toc_entry_t& entry, std::string_view key )
+         {
+            return name_of( entry ) < key;
+         } );
+
+   if ( it == toc.end() || name_of( *it ) != name )
+   {
+      return std::nullopt;
+   }
+
+   return entry( static_cast<size_t>( it - toc.begin() ) );
+}
+
+auto asset_archive_t::entry(
+   size_t index ) const
+   -> asset_entry_t
+{
+   const auto& entry = toc[index];
+   return {
+      name_of( entry ),
+      file.data().subspan( static_cast<size_t>( entry.offset ), static_cast<size_t>( entry.size ) ),
+      entry.content_hash };
+}
+
+auto asset_archive_t::verify() const
+   -> std::vector<std::string>
+{
+   std::vector<char> damaged( toc.size(), 0 );
+
+   thread_pool_t::shared().parallel_for(
+      toc.size(),
+      [&]( size_t i )
+      {
+         auto asset = entry( i );
+         damaged[i] = hash_utils::hash_bytes( asset.data ) != asset.content_hash;
+      } );
+
+   std::vector<std::string> names_damaged;
+   for ( size_t i = 0;
+         i < toc.size();
+         ++i )
+   {
+      if ( damaged[i] )
+      {
+         names_damaged.emplace_back( name_of( toc[i] ) );
+      }
+   }
+
+   return names_damaged;
+}
+
+auto asset_archive_t::name_of(
+   const toc_entry_t& entry ) const
+   -> std::string_view
+{
+   return names.substr( static_cast<size_t>( entry.name_offset ), entry.name_size );
+}
+
+asset_data_t::asset_data_t(
+   const asset_archive_t& archive,
+   std::string_view name )
+{
+   if ( auto entry = archive.find( name ) )
+   {
+      bytes = entry->data;
+      return;
+   }
+
+   loose = mapped_file_t( std::filesystem::path( name ) );
+   bytes = loose.data();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An asset stored in the archive, named by its path relative to the asset root with
+// '/' separators, e.g. "shaders/frag.spv"
+struct asset_entry_t
+{
+   std::string_view name;
+   std::span<const std::byte> data;
+   uint64_t content_hash;
+};
+
+// A file to pack under the given name
+struct asset_archive_input_t
+{
+   std::string name;
+   std::filesystem::path path;
+};
+
+// Read-only pack of asset files, memory-mapped once. The table of contents is sorted
+// by name and every payload starts on a 64 byte boundary, so cooked data is read in
+// place: SPIR-V as words, mesh cache vertices as Vertex, texture levels as blocks.
+// Each entry carries the hash_utils hash of its payload.
+class asset_archive_t
+{
+public:
+   static constexpr uint32_t version = 1;
+
+   // Every lookup in an empty archive misses
+   asset_archive_t() = default;
+
+   explicit asset_archive_t(
+      const std::filesystem::path& path );
+
+   // Packs the inputs in name order. Names have to be unique.
+   static
+   void write(
+      const std::filesystem::path& archive_path,
+      std::span<const asset_archive_input_t> inputs );
+
+   auto find(
+      std::string_view name ) const
+      -> std::optional<asset_entry_t>;
+
+   auto size() const
+      -> size_t
+   {
+      return toc.size();
+   }
+
+   auto entry(
+      size_t index ) const
+      -> asset_entry_t;
+
+   // Names of the entries whose payload no longer matches its hash
+   auto verify() const
+      -> std::vector<std::string>;
+
+private:
+   struct toc_entry_t
+   {
+      uint64_t name_offset;
+      uint64_t offset;
+      uint64_t size;
+      uint64_t content_hash;
+      uint32_t name_size;
+      uint32_t reserved;
+   };
+
+   auto name_of(
+      const toc_entry_t& entry ) const
+      -> std::string_view;
+
+   mapped_file_t file;
+   std::span<const toc_entry_t> toc;
+   std::string_view names;
+};
+
+// Bytes of one asset: a view into the archive when it holds the asset, else the loose
+// file of the same name below the working directory, mapped for as long as this lives
+class asset_data_t
+{
+public:
+   asset_data_t(
+      const asset_archive_t& archive,
+      std::string_view name );
+
+   auto data() const
+      -> std::span<const std::byte>
+   {
+      return bytes;
+   }
+
+   auto is_archived() const
+      -> bool
+   {
+      return !loose.is_open();
+   }
+
+private:
+   mapped_file_t loose;
+   std::span<const std::byte> bytes;
+};
@@ -0,0 +1,473 @@
+// Offline cooker for the renderer's assets.
+//
+//    NggAssetCooker [asset root] [--archive <file>] [--texture-format bc7|bc1|rgba8]
+//                   [--glslc <path>] [--force]
+//
+// Cooks below the asset root (default: the working directory), next to each source:
+// models/*.obj into mesh caches, textures/* into KTX2 texture caches and the GLSL in
+// Shaders/ into the SPIR-V variants Shaders/compile.bat builds. Every output's key,
+// a hash of its source's contents, the cooking tool's version and the settings, is
+// kept in <root>/.asset_cooker.db; outputs whose key has not changed are skipped.
+// All jobs run at once on the shared thread pool. --archive then packs the outputs
+// and model sources under the names the renderer reads them by, all but the SPIR-V:
+// NggTriangle embeds its shaders at build time and only reads loose ones to hot reload.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "asset_archive.h"
+#include "hash_utils.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "mesh_cooker.h"
+#include "texture_cache.h"
+#include "texture_cooker.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+// Bump whenever a cooking step changes what it writes, so every output is cooked again
+constexpr uint64_t cooker_version = 1;
+
+constexpr std::string_view database_name = ".asset_cooker.db";
+
+// Mirrors Shaders/compile.bat
+struct shader_variant_t
+{
+   std::string_view source;
+   std::string_view defines;
+   std::string_view output;
+};
+
+constexpr std::array<shader_variant_t, 5> shader_variants{ {
+   { "shader.vert", "", "vert.spv" },
+   { "shader.vert", "-DPACKED_VERTEX", "vert_packed.spv" },
+   { "shader.frag", "", "frag.spv" },
+   { "shader.frag", "-DVIRTUAL_TEXTURE", "frag_virtual.spv" },
+   { "meshlet_cull.comp", "", "meshlet_cull.spv" } } };
+
+constexpr std::array<std::string_view, 5> image_extensions{ ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+struct cook_job_t
+{
+   // Name the renderer reads the output by, which is also its database entry
+   std::string name;
+   std::filesystem::path source;
+   std::filesystem::path output;
+   // Tool version and settings
+   uint64_t settings_key;
+   std::function<void( const cook_job_t& job, std::ostream& log )> cook;
+};
+
+auto hash_values(
+   std::initializer_list<uint64_t> values )
+   -> uint64_t
+{
+   return hash_utils::hash_bytes( std::data( values ), values.size() * sizeof( uint64_t ) );
+}
+
+auto hash_string(
+   std::string_view text )
+   -> uint64_t
+{
+   return hash_utils::hash_bytes( text.data(), text.size() );
+}
+
+// Runs command through the shell, returning its exit status and everything it printed
+auto run_command(
+   const std::string& command )
+   -> std::pair<int, std::string>
+{
+#ifdef _WIN32
+   // cmd.exe strips the outer quotes, which keeps those around the program intact
+   FILE* pipe = _popen( ( "\"" + command + " 2>&1\"" ).c_str(), "r" );
+#else
+   FILE* pipe = popen( ( command + " 2>&1" ).c_str(), "r" );
+#endif
+
+   if ( !pipe )
+   {
+      throw std::runtime_error( "failed to run: " + command );
+   }
+
+   std::string output;
+   std::array<char, 4096> buffer;
+   while ( size_t read = std::fread( buffer.data(), 1, buffer.size(), pipe ) )
+   {
+      output.append( buffer.data(), read );
+   }
+
+#ifdef _WIN32
+   int status = _pclose( pipe );
+#else
+   int status = pclose( pipe );
+#endif
+
+   return { status, output };
+}
+
+// glslc of the Vulkan SDK the build uses, else whichever is on the path
+auto find_glslc()
+   -> std::filesystem::path
+{
+   if ( const char* sdk = std::getenv( "VULKAN_SDK" ) )
+   {
+      for ( const char* name : { "Bin/glslc.exe", "bin/glslc" } )
+      {
+         std::error_code error;
+         auto path = std::filesystem::path( sdk ) / name;
+         if ( std::filesystem::exists( path, error ) )
+         {
+            return path;
+         }
+      }
+   }
+
+   return "glslc";
+}
+
+auto parse_texture_format(
+   std::string_view name )
+   -> VkFormat
+{
+   if ( name == "bc7" )
+   {
+      return VK_FORMAT_BC7_SRGB_BLOCK;
+   }
+   if ( name == "bc1" )
+   {
+      return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+   }
+   if ( name == "rgba8" )
+   {
+      return VK_FORMAT_R8G8B8A8_SRGB;
+   }
+
+   throw std::runtime_error( "unknown texture format: " + std::string( name ) );
+}
+
+// One "<key> <name>" line per output cooked successfully
+auto read_database(
+   const std::filesystem::path& path )
+   -> std::map<std::string, uint64_t>
+{
+   std::map<std::string, uint64_t> keys;
+
+   std::ifstream in( path );
+   std::string line;
+   while ( std::getline( in, line ) )
+   {
+      auto space = line.find( ' ' );
+      if ( space == std::string::npos )
+      {
+         continue;
+      }
+
+      keys[line.substr( space + 1 )] = std::strtoull( line.substr( 0, space ).c_str(), nullptr, 16 );
+   }
+
+   return keys;
+}
+
+void write_database(
+   const std::filesystem::path& path,
+   const std::map<std::string, uint64_t>& keys )
+{
+   auto temp_path = path;
+   temp_path += ".tmp";
+
+   {
+      std::ofstream out( temp_path, std::ios::trunc );
+      if ( !out.is_open() )
+      {
+         throw std::runtime_error( "failed to create cooker database!" );
+      }
+
+      for ( const auto& [name, key] : keys )
+      {
+         out << std::hex << key << ' ' << name << '\n';
+      }
+   }
+
+   std::filesystem::rename( temp_path, path );
+}
+
+auto collect_jobs(
+   const std::filesystem::path& root,
+   VkFormat texture_format,
+   const std::filesystem::path& glslc )
+   -> std::vector<cook_job_t>
+{
+   std::vector<cook_job_t> jobs;
+   std::error_code error;
+
+   // The renderer imports with the default options unless told otherwise
+   mesh_import_options_t mesh_options{};
+   uint64_t mesh_key = hash_values( { cooker_version, mesh_cache_t::version, mesh_options.key() } );
+
+   if ( std::filesystem::is_directory( root / "models", error ) )
+   {
+      for ( const auto& entry : std::filesystem::directory_iterator( root / "models" ) )
+      {
+         if ( entry.path().extension() != ".obj" )
+         {
+            continue;
+         }
+
+         auto output = entry.path();
+         output += ".meshcache";
+
+         jobs.push_back( {
+            "models/" + output.filename().string(),
+            entry.path(),
+            output,
+            mesh_key,
+            [mesh_options]( const cook_job_t& job, std::ostream& log )
+            {
+               mapped_file_t source( job.source );
+               auto mesh = cook_mesh( source.data(), mesh_options, log );
+               mesh_cache_t::write( job.output, job.source, mesh_options.key(), mesh.vertices, mesh.indices, mesh.lods, mesh.bounds );
+            } } );
+      }
+   }
+
+   uint64_t texture_key =
+      hash_values( { cooker_version, texture_cache_t::version, static_cast<uint64_t>( texture_format ) } );
+
+   if ( std::filesystem::is_directory( root / "textures", error ) )
+   {
+      for ( const auto& entry : std::filesystem::directory_iterator( root / "textures" ) )
+      {
+         auto extension = entry.path().extension().string();
+         if ( std::find( image_extensions.begin(), image_extensions.end(), extension ) == image_extensions.end() )
+         {
+            continue;
+         }
+
+         auto output = entry.path();
+         output += ".ktx2";
+
+         jobs.push_back( {
+            "textures/" + output.filename().string(),
+            entry.path(),
+            output,
+            texture_key,
+            [texture_format]( const cook_job_t& job, std::ostream& log )
+            {
+               auto texture = cook_texture( job.source, texture_format );
+               texture_cache_t::write( job.output, job.source, texture.view() );
+               log << texture.width << "x" << texture.height << ", " << texture.levels.size() << " levels\n";
+            } } );
+      }
+   }
+
+   // A new compiler may emit different code, so its version is part of every shader's key
+   auto [status, version] = run_command( "\"" + glslc.string() + "\" --version" );
+   uint64_t glslc_key = status == 0 ? hash_string( version ) : 0;
+
+   for ( const auto& variant : shader_variants )
+   {
+      auto source = root / "Shaders" / variant.source;
+      if ( !std::filesystem::exists( source, error ) )
+      {
+         continue;
+      }
+
+      jobs.push_back( {
+         "shaders/" + std::string( variant.output ),
+         source,
+         root / "Shaders" / variant.output,
+         hash_values( { cooker_version, glslc_key, hash_string( variant.defines ) } ),
+         [glslc, defines = std::string( variant.defines ), status]( const cook_job_t& job, std::ostream& log )
+         {
+            if ( status != 0 )
+            {
+               throw std::runtime_error( "glslc not found, set VULKAN_SDK or pass --glslc" );
+            }
+
+            auto [result, output] =
+               run_command(
+                  "\"" + glslc.string() + "\" " + defines + " \"" + job.source.string() + "\" -o \"" +
+                  job.output.string() + "\"" );
+
+            log << output;
+            if ( result != 0 )
+            {
+               throw std::runtime_error( "glslc failed" );
+            }
+         } } );
+   }
+
+   return jobs;
+}
+}   // namespace
+
+int main(
+   int argc,
+   char* argv[] )
+{
+   using clock_t = std::chrono::steady_clock;
+   auto start_time = clock_t::now();
+
+   try
+   {
+      std::filesystem::path root = ".";
+      std::optional<std::filesystem::path> archive_path;
+      VkFormat texture_format = VK_FORMAT_BC7_SRGB_BLOCK;
+      std::filesystem::path glslc = find_glslc();
+      bool force = false;
+
+      for ( int i = 1;
+            i < argc;
+            ++i )
+      {
+         std::string_view arg( argv[i] );
+
+         if ( arg == "--archive" && i + 1 < argc )
+         {
+            archive_path = argv[++i];
+         }
+         else if ( arg == "--texture-format" && i + 1 < argc )
+         {
+            texture_format = parse_texture_format( argv[++i] );
+         }
+         else if ( arg == "--glslc" && i + 1 < argc )
+         {
+            glslc = argv[++i];
+         }
+         else if ( arg == "--force" )
+         {
+            force = true;
+         }
+         else
+         {
+            root = argv[i];
+         }
+      }
+
+      auto jobs = collect_jobs( root, texture_format, glslc );
+
+      auto database_path = root / database_name;
+      auto previous_keys = force ? std::map<std::string, uint64_t>{} : read_database( database_path );
+
+      std::vector<uint64_t> keys( jobs.size(), 0 );
+      std::vector<char> succeeded( jobs.size(), 0 );
+      std::atomic<size_t> cooked{ 0 };
+      std::atomic<size_t> skipped{ 0 };
+      std::mutex log_mutex;
+
+      thread_pool_t::shared().parallel_for(
+         jobs.size(),
+         [&]( size_t i )
+         {
+            const auto& job = jobs[i];
+            std::ostringstream log;
+
+            try
+            {
+               mapped_file_t source( job.source );
+               keys[i] = hash_values( { hash_utils::hash_bytes( source.data() ), job.settings_key } );
+
+               std::error_code error;
+               auto previous = previous_keys.find( job.name );
+               if ( previous != previous_keys.end() && previous->second == keys[i] &&
+                    std::filesystem::exists( job.output, error ) )
+               {
+                  succeeded[i] = 1;
+                  ++skipped;
+                  return;
+               }
+
+               auto job_start = clock_t::now();
+               job.cook( job, log );
+               succeeded[i] = 1;
+               ++cooked;
+
+               log << "cooked in " << std::chrono::duration<double, std::milli>( clock_t::now() - job_start ).count()
+                   << " ms\n";
+            }
+            catch ( const std::exception& e )
+            {
+               log << "error: " << e.what() << "\n";
+            }
+
+            std::lock_guard lock( log_mutex );
+            std::cout << job.name << ":\n" << log.str();
+         } );
+
+      // Failed outputs are left out, so they are cooked again next time
+      std::map<std::string, uint64_t> current_keys;
+      size_t failed = 0;
+
+      for ( size_t i = 0;
+            i < jobs.size();
+            ++i )
+      {
+         if ( succeeded[i] )
+         {
+            current_keys[jobs[i].name] = keys[i];
+         }
+         else
+         {
+            ++failed;
+         }
+      }
+
+      write_database( database_path, current_keys );
+
+      if ( archive_path.has_value() && failed == 0 )
+      {
+         std::vector<asset_archive_input_t> inputs;
+         for ( const auto& job : jobs )
+         {
+            if ( job.output.extension() == ".spv" )
+            {
+               continue;
+            }
+
+            inputs.push_back( { job.name, job.output } );
+
+            // Packed models can still be imported with other settings
+            if ( job.source.extension() == ".obj" )
+            {
+               inputs.push_back( { "models/" + job.source.filename().string(), job.source } );
+            }
+         }
+
+         asset_archive_t::write( *archive_path, inputs );
+      }
+
+      double seconds = std::chrono::duration<double>( clock_t::now() - start_time ).count();
+      std::cout << cooked.load() << " cooked, " << skipped.load() << " up to date, " << failed << " failed in " << seconds << " s on "
+                << thread_pool_t::shared().size() << " threads" << std::endl;
+
+      return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+   }
+}
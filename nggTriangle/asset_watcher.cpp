@@ -0,0 +1,161 @@
+#include "asset_watcher.h"
+
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Write times are compared at most this often where there is no inotify watch
+constexpr std::chrono::milliseconds scan_interval{ 250 };
+
+auto write_time_of(
+   const std::filesystem::path& path )
+   -> std::filesystem::file_time_type
+{
+   // A file being replaced may briefly not exist
+   std::error_code error;
+   auto write_time = std::filesystem::last_write_time( path, error );
+   return error ? std::filesystem::file_time_type{} : write_time;
+}
+}   // namespace
+
+asset_watcher_t::asset_watcher_t(
+   std::chrono::milliseconds settle_time )
+   : settle_time( settle_time )
+{
+#ifdef __linux__
+   inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if ( inotify_fd < 0 )
+   {
+      throw std::runtime_error( "failed to create inotify instance!" );
+   }
+#endif
+}
+
+asset_watcher_t::~asset_watcher_t()
+{
+#ifdef __linux__
+   if ( inotify_fd >= 0 )
+   {
+      close( inotify_fd );
+   }
+#endif
+}
+
+void asset_watcher_t::watch(
+   const std::filesystem::path& path )
+{
+   watched_file_t file;
+   file.path = path;
+   file.write_time = write_time_of( path );
+
+#ifdef __linux__
+   // Editors and the cooker often replace a file rather than rewrite it, which a watch
+   // on the file itself would lose, so its directory is watched. Watching a directory
+   // twice returns the same descriptor. A directory that does not exist, such as that
+   // of the optional loose shaders, leaves its files to the write time scan.
+   auto directory = path.parent_path().empty() ? std::filesystem::path( "." ) : path.parent_path();
+
+   file.directory_watch = inotify_add_watch( inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+   if ( file.directory_watch < 0 )
+   {
+      std::cerr << "cannot watch " << directory.string() << ", polling " << path.string() << std::endl;
+   }
+#endif
+
+   files.push_back( std::move( file ) );
+}
+
+auto asset_watcher_t::poll()
+   -> std::vector<std::filesystem::path>
+{
+   auto now = clock_t::now();
+   read_changes( now );
+
+   std::vector<std::filesystem::path> changed;
+   for ( auto& file : files )
+   {
+      if ( file.changed_at.has_value() && now - *file.changed_at >= settle_time )
+      {
+         file.changed_at.reset();
+         changed.push_back( file.path );
+      }
+   }
+
+   return changed;
+}
+
+void asset_watcher_t::read_changes(
+   clock_t::time_point now )
+{
+#ifdef __linux__
+   alignas( inotify_event ) std::array<char, 4096> buffer;
+
+   // Drained until the non-blocking descriptor has nothing left
+   for ( ssize_t length = read( inotify_fd, buffer.data(), buffer.size() );
+         length > 0;
+         length = read( inotify_fd, buffer.data(), buffer.size() ) )
+   {
+      for ( ssize_t offset = 0;
+            offset < length; )
+      {
+         const auto* event = reinterpret_cast<const inotify_event*>( buffer.data() + offset );
+         offset += static_cast<ssize_t>( sizeof( inotify_event ) + event->len );
+
+         // Events were dropped, any file may have changed
+         if ( event->mask & IN_Q_OVERFLOW )
+         {
+            for ( auto& file : files )
+            {
+               file.changed_at = now;
+            }
+            continue;
+         }
+
+         if ( event->len == 0 )
+         {
+            continue;
+         }
+
+         std::filesystem::path name( event->name );
+         for ( auto& file : files )
+         {
+            if ( file.directory_watch == event->wd && file.path.filename() == name )
+            {
+               file.changed_at = now;
+            }
+         }
+      }
+   }
+#endif
+
+   if ( now - last_scan < scan_interval )
+   {
+      return;
+   }
+
+   last_scan = now;
+
+   // Everywhere without inotify, and on Linux the files whose directory is not watched
+   for ( auto& file : files )
+   {
+      if ( file.directory_watch >= 0 )
+      {
+         continue;
+      }
+
+      auto write_time = write_time_of( file.path );
+      if ( write_time != file.write_time )
+      {
+         file.write_time = write_time;
+         file.changed_at = now;
+      }
+   }
+}
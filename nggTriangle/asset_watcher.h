@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// Reports changes to a set of loose asset files. On Linux the directories holding them
+// are watched with inotify, elsewhere, or where a directory cannot be watched, their
+// write times are compared every few hundred milliseconds. A change is only reported
+// once the file has been left alone for settle_time, so an editor saving in several
+// steps causes one reload of the whole file.
+class asset_watcher_t
+{
+public:
+   explicit asset_watcher_t(
+      std::chrono::milliseconds settle_time = std::chrono::milliseconds( 200 ) );
+
+   asset_watcher_t(
+      const asset_watcher_t& ) = delete;
+
+   auto operator=(
+      const asset_watcher_t& )
+      -> asset_watcher_t& = delete;
+
+   ~asset_watcher_t();
+
+   void watch(
+      const std::filesystem::path& path );
+
+   // Watched paths, as passed to watch(), that changed and settled since the last call.
+   // Never blocks.
+   auto poll()
+      -> std::vector<std::filesystem::path>;
+
+private:
+   using clock_t = std::chrono::steady_clock;
+
+   struct watched_file_t
+   {
+      std::filesystem::path path;
+      std::filesystem::file_time_type write_time{};
+      int directory_watch{ -1 };
+      std::optional<clock_t::time_point> changed_at;
+   };
+
+   void read_changes(
+      clock_t::time_point now );
+
+   std::chrono::milliseconds settle_time;
+   std::vector<watched_file_t> files;
+   int inotify_fd{ -1 };
+   clock_t::time_point last_scan{};
+};
@@ -0,0 +1,1025 @@
+#include "bc_encoder.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( _M_ARM64 )
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+using endpoint_t = std::array<float, 4>;
+using block_indices_t = std::array<uint8_t, 16>;
+
+// The 16 texels of a block, channel major so the index search covers a row of
+// texels per vector
+struct block_texels_t
+{
+   alignas( 32 ) std::array<std::array<float, 16>, 4> channels;
+};
+
+// BC7 4 bit index interpolation weights, out of 64
+constexpr std::array<uint32_t, 16> bc7_weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct encoder_settings_t
+{
+   int refinements;
+   // Try all four BC7 p-bit pairs instead of rounding each endpoint on its own
+   bool search_pbits;
+};
+
+auto settings_for(
+   bc_quality_t quality )
+   -> encoder_settings_t
+{
+   switch ( quality )
+   {
+   case bc_quality_t::fast:
+      return { 0, false };
+   case bc_quality_t::normal:
+      return { 2, false };
+   case bc_quality_t::best:
+      return { 6, true };
+   }
+
+   throw std::runtime_error( "unknown block encoder quality!" );
+}
+
+auto is_bc1(
+   VkFormat format )
+   -> bool
+{
+   return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+}
+
+auto is_bc7(
+   VkFormat format )
+   -> bool
+{
+   return format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+void load_block(
+   std::span<const std::byte> rgba,
+   uint32_t width,
+   uint32_t height,
+   uint32_t block_x,
+   uint32_t block_y,
+   block_texels_t& block )
+{
+   for ( uint32_t y = 0;
+         y < 4;
+         ++y )
+   {
+      uint32_t source_y = std::min( block_y * 4 + y, height - 1 );
+
+      for ( uint32_t x = 0;
+            x < 4;
+            ++x )
+      {
+         uint32_t source_x = std::min( block_x * 4 + x, width - 1 );
+         const std::byte* texel = rgba.data() + ( size_t{ source_y } * width + source_x ) * 4;
+
+         for ( size_t channel = 0;
+               channel < 4;
+               ++channel )
+         {
+            block.channels[channel][y * 4 + x] = std::to_integer<uint8_t>( texel[channel] );
+         }
+      }
+   }
+}
+
+// Picks for every texel the nearest of index_max + 1 evenly spaced points from e0 to
+// e1 and returns the squared error of the fit. The points lie on a line, so the
+// nearest one follows from projecting the texel onto it.
+auto fit_indices(
+   const block_texels_t& block,
+   const endpoint_t& e0,
+   const endpoint_t& e1,
+   size_t channel_count,
+   uint32_t index_max,
+   block_indices_t& indices )
+   -> float
+{
+   endpoint_t direction{};
+   float length2 = 0.0f;
+   for ( size_t channel = 0;
+         channel < channel_count;
+         ++channel )
+   {
+      direction[channel] = e1[channel] - e0[channel];
+      length2 += direction[channel] * direction[channel];
+   }
+
+   if ( length2 < 1e-6f )
+   {
+      direction = {};
+      length2 = 1.0f;
+   }
+
+   float scale = static_cast<float>( index_max ) / length2;
+   float step = 1.0f / static_cast<float>( index_max );
+
+   alignas( 32 ) std::array<int32_t, 16> picked;
+   float error = 0.0f;
+
+#if defined( __AVX2__ )
+   __m256 error8 = _mm256_setzero_ps();
+   for ( size_t i = 0; i < 16; i += 8 )
+   {
+      __m256 t = _mm256_setzero_ps();
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         __m256 offset = _mm256_sub_ps( _mm256_load_ps( &block.channels[channel][i] ), _mm256_set1_ps( e0[channel] ) );
+         t = _mm256_add_ps( t, _mm256_mul_ps( offset, _mm256_set1_ps( direction[channel] ) ) );
+      }
+
+      t = _mm256_mul_ps( t, _mm256_set1_ps( scale ) );
+      t = _mm256_min_ps( _mm256_max_ps( t, _mm256_setzero_ps() ), _mm256_set1_ps( static_cast<float>( index_max ) ) );
+
+      __m256i index = _mm256_cvtps_epi32( t );
+      __m256 weight = _mm256_mul_ps( _mm256_cvtepi32_ps( index ), _mm256_set1_ps( step ) );
+      _mm256_store_si256( reinterpret_cast<__m256i*>( picked.data() + i ), index );
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         __m256 fitted = _mm256_add_ps( _mm256_set1_ps( e0[channel] ), _mm256_mul_ps( weight, _mm256_set1_ps( direction[channel] ) ) );
+         __m256 difference = _mm256_sub_ps( _mm256_load_ps( &block.channels[channel][i] ), fitted );
+         error8 = _mm256_add_ps( error8, _mm256_mul_ps( difference, difference ) );
+      }
+   }
+
+   alignas( 32 ) std::array<float, 8> lanes;
+   _mm256_store_ps( lanes.data(), error8 );
+   for ( float lane : lanes )
+   {
+      error += lane;
+   }
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+   __m128 error4 = _mm_setzero_ps();
+   for ( size_t i = 0; i < 16; i += 4 )
+   {
+      __m128 t = _mm_setzero_ps();
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         __m128 offset = _mm_sub_ps( _mm_load_ps( &block.channels[channel][i] ), _mm_set1_ps( e0[channel] ) );
+         t = _mm_add_ps( t, _mm_mul_ps( offset, _mm_set1_ps( direction[channel] ) ) );
+      }
+
+      t = _mm_mul_ps( t, _mm_set1_ps( scale ) );
+      t = _mm_min_ps( _mm_max_ps( t, _mm_setzero_ps() ), _mm_set1_ps( static_cast<float>( index_max ) ) );
+
+      __m128i index = _mm_cvtps_epi32( t );
+      __m128 weight = _mm_mul_ps( _mm_cvtepi32_ps( index ), _mm_set1_ps( step ) );
+      _mm_store_si128( reinterpret_cast<__m128i*>( picked.data() + i ), index );
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         __m128 fitted = _mm_add_ps( _mm_set1_ps( e0[channel] ), _mm_mul_ps( weight, _mm_set1_ps( direction[channel] ) ) );
+         __m128 difference = _mm_sub_ps( _mm_load_ps( &block.channels[channel][i] ), fitted );
+         error4 = _mm_add_ps( error4, _mm_mul_ps( difference, difference ) );
+      }
+   }
+
+   alignas( 16 ) std::array<float, 4> lanes;
+   _mm_store_ps( lanes.data(), error4 );
+   for ( float lane : lanes )
+   {
+      error += lane;
+   }
+#elif defined( __ARM_NEON ) || defined( _M_ARM64 )
+   float32x4_t error4 = vdupq_n_f32( 0.0f );
+   for ( size_t i = 0; i < 16; i += 4 )
+   {
+      float32x4_t t = vdupq_n_f32( 0.0f );
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         float32x4_t offset = vsubq_f32( vld1q_f32( &block.channels[channel][i] ), vdupq_n_f32( e0[channel] ) );
+         t = vmlaq_n_f32( t, offset, direction[channel] );
+      }
+
+      t = vmulq_n_f32( t, scale );
+      t = vminq_f32( vmaxq_f32( t, vdupq_n_f32( 0.0f ) ), vdupq_n_f32( static_cast<float>( index_max ) ) );
+
+      int32x4_t index = vcvtnq_s32_f32( t );
+      float32x4_t weight = vmulq_n_f32( vcvtq_f32_s32( index ), step );
+      vst1q_s32( picked.data() + i, index );
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         float32x4_t fitted = vmlaq_n_f32( vdupq_n_f32( e0[channel] ), weight, direction[channel] );
+         float32x4_t difference = vsubq_f32( vld1q_f32( &block.channels[channel][i] ), fitted );
+         error4 = vmlaq_f32( error4, difference, difference );
+      }
+   }
+
+   error = vaddvq_f32( error4 );
+#else
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      float t = 0.0f;
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         t += ( block.channels[channel][i] - e0[channel] ) * direction[channel];
+      }
+
+      t = std::clamp( t * scale, 0.0f, static_cast<float>( index_max ) );
+      picked[i] = static_cast<int32_t>( std::lround( t ) );
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         float difference = block.channels[channel][i] - ( e0[channel] + picked[i] * step * direction[channel] );
+         error += difference * difference;
+      }
+   }
+#endif
+
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      indices[i] = static_cast<uint8_t>( picked[i] );
+   }
+
+   return error;
+}
+
+// Endpoints at the extremes of the block along its principal axis
+void principal_endpoints(
+   const block_texels_t& block,
+   size_t channel_count,
+   endpoint_t& e0,
+   endpoint_t& e1 )
+{
+   endpoint_t mean{};
+   for ( size_t channel = 0;
+         channel < channel_count;
+         ++channel )
+   {
+      for ( float value : block.channels[channel] )
+      {
+         mean[channel] += value / 16.0f;
+      }
+   }
+
+   std::array<endpoint_t, 4> covariance{};
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      for ( size_t a = 0;
+            a < channel_count;
+            ++a )
+      {
+         for ( size_t b = 0;
+               b < channel_count;
+               ++b )
+         {
+            covariance[a][b] += ( block.channels[a][i] - mean[a] ) * ( block.channels[b][i] - mean[b] );
+         }
+      }
+   }
+
+   // Power iteration, starting from the row of the channel that varies the most
+   size_t widest = 0;
+   for ( size_t channel = 1;
+         channel < channel_count;
+         ++channel )
+   {
+      if ( covariance[channel][channel] > covariance[widest][widest] )
+      {
+         widest = channel;
+      }
+   }
+
+   e0 = mean;
+   e1 = mean;
+
+   if ( covariance[widest][widest] < 1e-6f )
+   {
+      return;
+   }
+
+   endpoint_t axis = covariance[widest];
+   for ( int iteration = 0;
+         iteration < 8;
+         ++iteration )
+   {
+      endpoint_t next{};
+      float largest = 0.0f;
+      for ( size_t a = 0;
+            a < channel_count;
+            ++a )
+      {
+         for ( size_t b = 0;
+               b < channel_count;
+               ++b )
+         {
+            next[a] += covariance[a][b] * axis[b];
+         }
+         largest = std::max( largest, std::abs( next[a] ) );
+      }
+
+      if ( largest < 1e-12f )
+      {
+         break;
+      }
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         axis[channel] = next[channel] / largest;
+      }
+   }
+
+   float length2 = 0.0f;
+   for ( size_t channel = 0;
+         channel < channel_count;
+         ++channel )
+   {
+      length2 += axis[channel] * axis[channel];
+   }
+
+   float t_min = std::numeric_limits<float>::max();
+   float t_max = std::numeric_limits<float>::lowest();
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      float t = 0.0f;
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         t += ( block.channels[channel][i] - mean[channel] ) * axis[channel];
+      }
+      t_min = std::min( t_min, t / length2 );
+      t_max = std::max( t_max, t / length2 );
+   }
+
+   for ( size_t channel = 0;
+         channel < channel_count;
+         ++channel )
+   {
+      e0[channel] = std::clamp( mean[channel] + axis[channel] * t_min, 0.0f, 255.0f );
+      e1[channel] = std::clamp( mean[channel] + axis[channel] * t_max, 0.0f, 255.0f );
+   }
+}
+
+// Least squares endpoints for fixed indices. False when the indices do not pin
+// down two endpoints, e.g. when they are all the same.
+auto least_squares_endpoints(
+   const block_texels_t& block,
+   const block_indices_t& indices,
+   uint32_t index_max,
+   size_t channel_count,
+   endpoint_t& e0,
+   endpoint_t& e1 )
+   -> bool
+{
+   float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+   endpoint_t ax{}, bx{};
+
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      float b = static_cast<float>( indices[i] ) / static_cast<float>( index_max );
+      float a = 1.0f - b;
+
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+
+      for ( size_t channel = 0;
+            channel < channel_count;
+            ++channel )
+      {
+         ax[channel] += a * block.channels[channel][i];
+         bx[channel] += b * block.channels[channel][i];
+      }
+   }
+
+   float determinant = aa * bb - ab * ab;
+   if ( std::abs( determinant ) < 1e-6f )
+   {
+      return false;
+   }
+
+   for ( size_t channel = 0;
+         channel < channel_count;
+         ++channel )
+   {
+      e0[channel] = std::clamp( ( bb * ax[channel] - ab * bx[channel] ) / determinant, 0.0f, 255.0f );
+      e1[channel] = std::clamp( ( aa * bx[channel] - ab * ax[channel] ) / determinant, 0.0f, 255.0f );
+   }
+
+   return true;
+}
+
+auto quantize_channel(
+   float value,
+   int levels )
+   -> uint32_t
+{
+   return static_cast<uint32_t>( std::lround( std::clamp( value, 0.0f, 255.0f ) * static_cast<float>( levels - 1 ) / 255.0f ) );
+}
+
+auto pack_565(
+   const endpoint_t& e )
+   -> uint16_t
+{
+   return static_cast<uint16_t>( quantize_channel( e[0], 32 ) << 11 | quantize_channel( e[1], 64 ) << 5 | quantize_channel( e[2], 32 ) );
+}
+
+auto unpack_565(
+   uint16_t packed )
+   -> endpoint_t
+{
+   uint32_t r = packed >> 11;
+   uint32_t g = ( packed >> 5 ) & 63;
+   uint32_t b = packed & 31;
+
+   return {
+      static_cast<float>( r << 3 | r >> 2 ),
+      static_cast<float>( g << 2 | g >> 4 ),
+      static_cast<float>( b << 3 | b >> 2 ),
+      255.0f };
+}
+
+void encode_bc1_block(
+   const block_texels_t& block,
+   const encoder_settings_t& settings,
+   std::byte* out )
+{
+   endpoint_t e0, e1;
+   principal_endpoints( block, 3, e0, e1 );
+
+   uint16_t best_c0 = 0, best_c1 = 0;
+   block_indices_t best_indices{};
+   float best_error = std::numeric_limits<float>::max();
+
+   for ( int pass = 0;
+         pass <= settings.refinements;
+         ++pass )
+   {
+      uint16_t c0 = pack_565( e0 );
+      uint16_t c1 = pack_565( e1 );
+
+      block_indices_t indices;
+      float error = fit_indices( block, unpack_565( c0 ), unpack_565( c1 ), 3, 3, indices );
+
+      if ( error < best_error )
+      {
+         best_error = error;
+         best_c0 = c0;
+         best_c1 = c1;
+         best_indices = indices;
+      }
+
+      if ( !least_squares_endpoints( block, indices, 3, 3, e0, e1 ) )
+      {
+         break;
+      }
+   }
+
+   // Four colour blocks need c0 > c1. Indices run from e0 to e1 and map to the BC1
+   // order c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1.
+   std::array<uint32_t, 4> codes = { 0, 2, 3, 1 };
+   if ( best_c0 < best_c1 )
+   {
+      std::swap( best_c0, best_c1 );
+      codes = { 1, 3, 2, 0 };
+   }
+   else if ( best_c0 == best_c1 )
+   {
+      codes = { 0, 0, 0, 0 };
+   }
+
+   uint32_t selectors = 0;
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      selectors |= codes[best_indices[i]] << ( 2 * i );
+   }
+
+   std::memcpy( out, &best_c0, 2 );
+   std::memcpy( out + 2, &best_c1, 2 );
+   std::memcpy( out + 4, &selectors, 4 );
+}
+
+// Mode 6 endpoint: 7 bits per channel plus a shared lowest bit
+struct mode6_endpoint_t
+{
+   std::array<uint32_t, 4> bits;
+   uint32_t pbit;
+
+   auto value() const
+      -> endpoint_t
+   {
+      return {
+         static_cast<float>( bits[0] << 1 | pbit ),
+         static_cast<float>( bits[1] << 1 | pbit ),
+         static_cast<float>( bits[2] << 1 | pbit ),
+         static_cast<float>( bits[3] << 1 | pbit ) };
+   }
+};
+
+auto quantize_mode6(
+   const endpoint_t& e,
+   uint32_t pbit )
+   -> mode6_endpoint_t
+{
+   mode6_endpoint_t quantized{ {}, pbit };
+   for ( size_t channel = 0;
+         channel < 4;
+         ++channel )
+   {
+      long bits = std::lround( ( e[channel] - static_cast<float>( pbit ) ) / 2.0f );
+      quantized.bits[channel] = static_cast<uint32_t>( std::clamp( bits, 0l, 127l ) );
+   }
+
+   return quantized;
+}
+
+// The p-bit that keeps the endpoint closest to e
+auto nearest_mode6(
+   const endpoint_t& e )
+   -> mode6_endpoint_t
+{
+   auto distance =
+      [&]( const mode6_endpoint_t& quantized )
+      {
+         endpoint_t value = quantized.value();
+         float sum = 0.0f;
+         for ( size_t channel = 0;
+               channel < 4;
+               ++channel )
+         {
+            sum += ( value[channel] - e[channel] ) * ( value[channel] - e[channel] );
+         }
+         return sum;
+      };
+
+   auto even = quantize_mode6( e, 0 );
+   auto odd = quantize_mode6( e, 1 );
+
+   return distance( even ) <= distance( odd ) ? even : odd;
+}
+
+struct bit_writer_t
+{
+   std::array<uint64_t, 2> words{};
+   size_t position{ 0 };
+
+   void write(
+      uint32_t value,
+      size_t bit_count )
+   {
+      for ( size_t bit = 0;
+            bit < bit_count;
+            ++bit, ++position )
+      {
+         words[position / 64] |= uint64_t{ ( value >> bit ) & 1 } << ( position % 64 );
+      }
+   }
+};
+
+struct bit_reader_t
+{
+   std::array<uint64_t, 2> words{};
+   size_t position{ 0 };
+
+   auto read(
+      size_t bit_count )
+      -> uint32_t
+   {
+      uint32_t value = 0;
+      for ( size_t bit = 0;
+            bit < bit_count;
+            ++bit, ++position )
+      {
+         value |= static_cast<uint32_t>( ( words[position / 64] >> ( position % 64 ) ) & 1 ) << bit;
+      }
+      return value;
+   }
+};
+
+void encode_bc7_block(
+   const block_texels_t& block,
+   const encoder_settings_t& settings,
+   std::byte* out )
+{
+   endpoint_t e0, e1;
+   principal_endpoints( block, 4, e0, e1 );
+
+   mode6_endpoint_t best_q0{}, best_q1{};
+   block_indices_t best_indices{};
+   float best_error = std::numeric_limits<float>::max();
+
+   for ( int pass = 0;
+         pass <= settings.refinements;
+         ++pass )
+   {
+      std::array<std::pair<mode6_endpoint_t, mode6_endpoint_t>, 4> candidates;
+      size_t candidate_count = 1;
+
+      if ( settings.search_pbits )
+      {
+         for ( uint32_t pbits = 0;
+               pbits < 4;
+               ++pbits )
+         {
+            candidates[pbits] = { quantize_mode6( e0, pbits & 1 ), quantize_mode6( e1, pbits >> 1 ) };
+         }
+         candidate_count = 4;
+      }
+      else
+      {
+         candidates[0] = { nearest_mode6( e0 ), nearest_mode6( e1 ) };
+      }
+
+      // Refine from the best candidate of this pass
+      block_indices_t indices;
+      float pass_error = std::numeric_limits<float>::max();
+
+      for ( size_t candidate = 0;
+            candidate < candidate_count;
+            ++candidate )
+      {
+         const auto& [q0, q1] = candidates[candidate];
+
+         block_indices_t fitted;
+         float error = fit_indices( block, q0.value(), q1.value(), 4, 15, fitted );
+
+         if ( error < pass_error )
+         {
+            pass_error = error;
+            indices = fitted;
+         }
+
+         if ( error < best_error )
+         {
+            best_error = error;
+            best_q0 = q0;
+            best_q1 = q1;
+            best_indices = fitted;
+         }
+      }
+
+      if ( !least_squares_endpoints( block, indices, 15, 4, e0, e1 ) )
+      {
+         break;
+      }
+   }
+
+   // The first index is stored without its top bit, so it has to be below 8
+   if ( best_indices[0] >= 8 )
+   {
+      std::swap( best_q0, best_q1 );
+      for ( auto& index : best_indices )
+      {
+         index = static_cast<uint8_t>( 15 - index );
+      }
+   }
+
+   bit_writer_t writer;
+   writer.write( 1u << 6, 7 );
+
+   for ( size_t channel = 0;
+         channel < 4;
+         ++channel )
+   {
+      writer.write( best_q0.bits[channel], 7 );
+      writer.write( best_q1.bits[channel], 7 );
+   }
+
+   writer.write( best_q0.pbit, 1 );
+   writer.write( best_q1.pbit, 1 );
+
+   writer.write( best_indices[0], 3 );
+   for ( size_t i = 1;
+         i < 16;
+         ++i )
+   {
+      writer.write( best_indices[i], 4 );
+   }
+
+   std::memcpy( out, writer.words.data(), 16 );
+}
+
+void decode_bc1_block(
+   const std::byte* in,
+   std::array<std::array<uint8_t, 4>, 16>& texels )
+{
+   uint16_t c0, c1;
+   uint32_t selectors;
+   std::memcpy( &c0, in, 2 );
+   std::memcpy( &c1, in + 2, 2 );
+   std::memcpy( &selectors, in + 4, 4 );
+
+   endpoint_t e0 = unpack_565( c0 );
+   endpoint_t e1 = unpack_565( c1 );
+
+   std::array<std::array<uint8_t, 4>, 4> palette{};
+   for ( size_t channel = 0;
+         channel < 3;
+         ++channel )
+   {
+      auto a = static_cast<uint32_t>( e0[channel] );
+      auto b = static_cast<uint32_t>( e1[channel] );
+
+      palette[0][channel] = static_cast<uint8_t>( a );
+      palette[1][channel] = static_cast<uint8_t>( b );
+      palette[2][channel] = static_cast<uint8_t>( c0 > c1 ? ( 2 * a + b + 1 ) / 3 : ( a + b ) / 2 );
+      palette[3][channel] = static_cast<uint8_t>( c0 > c1 ? ( a + 2 * b + 1 ) / 3 : 0 );
+   }
+
+   palette[0][3] = palette[1][3] = palette[2][3] = 255;
+   palette[3][3] = c0 > c1 ? 255 : 0;
+
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      texels[i] = palette[( selectors >> ( 2 * i ) ) & 3];
+   }
+}
+
+void decode_bc7_block(
+   const std::byte* in,
+   std::array<std::array<uint8_t, 4>, 16>& texels )
+{
+   bit_reader_t reader;
+   std::memcpy( reader.words.data(), in, 16 );
+
+   if ( reader.read( 7 ) != 1u << 6 )
+   {
+      throw std::runtime_error( "only BC7 mode 6 blocks can be decoded!" );
+   }
+
+   mode6_endpoint_t q0{}, q1{};
+   for ( size_t channel = 0;
+         channel < 4;
+         ++channel )
+   {
+      q0.bits[channel] = reader.read( 7 );
+      q1.bits[channel] = reader.read( 7 );
+   }
+   q0.pbit = reader.read( 1 );
+   q1.pbit = reader.read( 1 );
+
+   endpoint_t e0 = q0.value();
+   endpoint_t e1 = q1.value();
+
+   for ( size_t i = 0;
+         i < 16;
+         ++i )
+   {
+      uint32_t weight = bc7_weights[reader.read( i == 0 ? 3 : 4 )];
+
+      for ( size_t channel = 0;
+            channel < 4;
+            ++channel )
+      {
+         auto a = static_cast<uint32_t>( e0[channel] );
+         auto b = static_cast<uint32_t>( e1[channel] );
+         texels[i][channel] = static_cast<uint8_t>( ( ( 64 - weight ) * a + weight * b + 32 ) >> 6 );
+      }
+   }
+}
+}   // namespace
+
+auto bc_quality_name(
+   bc_quality_t quality )
+   -> const char*
+{
+   switch ( quality )
+   {
+   case bc_quality_t::fast:
+      return "fast";
+   case bc_quality_t::normal:
+      return "normal";
+   case bc_quality_t::best:
+      return "best";
+   }
+
+   return "unknown";
+}
+
+auto bc_format_name(
+   VkFormat format )
+   -> const char*
+{
+   if ( is_bc1( format ) )
+   {
+      return "BC1";
+   }
+   if ( is_bc7( format ) )
+   {
+      return "BC7";
+   }
+
+   return "unknown";
+}
+
+void encode_bc_level(
+   VkFormat format,
+   std::span<const std::byte> rgba,
+   uint32_t width,
+   uint32_t height,
+   bc_quality_t quality,
+   std::span<std::byte> blocks )
+{
+   if ( !is_bc1( format ) && !is_bc7( format ) )
+   {
+      throw std::runtime_error( "block encoder only writes BC1 and BC7!" );
+   }
+
+   uint32_t blocks_x = ( width + 3 ) / 4;
+   uint32_t blocks_y = ( height + 3 ) / 4;
+   size_t block_bytes = is_bc7( format ) ? 16 : 8;
+
+   if ( rgba.size() < size_t{ width } * height * 4 || blocks.size() < size_t{ blocks_x } * blocks_y * block_bytes )
+   {
+      throw std::runtime_error( "block encoder buffers too small!" );
+   }
+
+   encoder_settings_t settings = settings_for( quality );
+
+   thread_pool_t::shared().parallel_for(
+      blocks_y,
+      [&]( size_t row )
+      {
+         block_texels_t block;
+
+         for ( uint32_t column = 0;
+               column < blocks_x;
+               ++column )
+         {
+            load_block( rgba, width, height, column, static_cast<uint32_t>( row ), block );
+
+            std::byte* out = blocks.data() + ( row * blocks_x + column ) * block_bytes;
+            if ( is_bc7( format ) )
+            {
+               encode_bc7_block( block, settings, out );
+            }
+            else
+            {
+               encode_bc1_block( block, settings, out );
+            }
+         }
+      } );
+}
+
+void decode_bc_level(
+   VkFormat format,
+   std::span<const std::byte> blocks,
+   uint32_t width,
+   uint32_t height,
+   std::span<std::byte> rgba )
+{
+   if ( !is_bc1( format ) && !is_bc7( format ) )
+   {
+      throw std::runtime_error( "block decoder only reads BC1 and BC7!" );
+   }
+
+   uint32_t blocks_x = ( width + 3 ) / 4;
+   uint32_t blocks_y = ( height + 3 ) / 4;
+   size_t block_bytes = is_bc7( format ) ? 16 : 8;
+
+   if ( rgba.size() < size_t{ width } * height * 4 || blocks.size() < size_t{ blocks_x } * blocks_y * block_bytes )
+   {
+      throw std::runtime_error( "block decoder buffers too small!" );
+   }
+
+   std::array<std::array<uint8_t, 4>, 16> texels;
+
+   for ( uint32_t block_y = 0;
+         block_y < blocks_y;
+         ++block_y )
+   {
+      for ( uint32_t block_x = 0;
+            block_x < blocks_x;
+            ++block_x )
+      {
+         const std::byte* in = blocks.data() + ( size_t{ block_y } * blocks_x + block_x ) * block_bytes;
+         if ( is_bc7( format ) )
+         {
+            decode_bc7_block( in, texels );
+         }
+         else
+         {
+            decode_bc1_block( in, texels );
+         }
+
+         for ( uint32_t i = 0;
+               i < 16;
+               ++i )
+         {
+            uint32_t x = block_x * 4 + i % 4;
+            uint32_t y = block_y * 4 + i / 4;
+            if ( x < width && y < height )
+            {
+               std::memcpy( rgba.data() + ( size_t{ y } * width + x ) * 4, texels[i].data(), 4 );
+            }
+         }
+      }
+   }
+}
+
+auto benchmark_bc_encoder(
+   std::span<const std::byte> rgba,
+   uint32_t width,
+   uint32_t height )
+   -> std::vector<bc_benchmark_t>
+{
+   using clock_t = std::chrono::steady_clock;
+
+   // Small images are encoded repeatedly until the timing is long enough to trust
+   constexpr std::chrono::milliseconds minimum_duration( 250 );
+
+   std::vector<bc_benchmark_t> results;
+   std::vector<std::byte> decoded( rgba.size() );
+
+   for ( VkFormat format : { VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK } )
+   {
+      size_t block_bytes = is_bc7( format ) ? 16 : 8;
+      std::vector<std::byte> blocks( size_t{ ( width + 3 ) / 4 } * ( ( height + 3 ) / 4 ) * block_bytes );
+
+      for ( bc_quality_t quality : { bc_quality_t::fast, bc_quality_t::normal, bc_quality_t::best } )
+      {
+         size_t runs = 0;
+         auto start = clock_t::now();
+         auto elapsed = clock_t::duration::zero();
+
+         do
+         {
+            encode_bc_level( format, rgba, width, height, quality, blocks );
+            ++runs;
+            elapsed = clock_t::now() - start;
+         } while ( elapsed < minimum_duration );
+
+         decode_bc_level( format, blocks, width, height, decoded );
+
+         size_t channel_count = is_bc7( format ) ? 4 : 3;
+         double squared_error = 0.0;
+         for ( size_t texel = 0;
+               texel < size_t{ width } * height;
+               ++texel )
+         {
+            for ( size_t channel = 0;
+                  channel < channel_count;
+                  ++channel )
+            {
+               double difference =
+                  std::to_integer<int>( rgba[texel * 4 + channel] ) - std::to_integer<int>( decoded[texel * 4 + channel] );
+               squared_error += difference * difference;
+            }
+         }
+
+         double mse = squared_error / ( static_cast<double>( width ) * height * static_cast<double>( channel_count ) );
+         double seconds = std::chrono::duration<double>( elapsed ).count();
+
+         results.push_back( {
+            format,
+            quality,
+            static_cast<double>( width ) * height * static_cast<double>( runs ) / seconds / 1e6,
+            mse > 0.0 ? 10.0 * std::log10( 255.0 * 255.0 / mse ) : std::numeric_limits<double>::infinity() } );
+      }
+   }
+
+   return results;
+}
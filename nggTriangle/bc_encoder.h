@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Encoder effort: endpoint refinement passes and, for BC7, how hard the p-bits are searched
+enum class bc_quality_t
+{
+   fast,
+   normal,
+   best
+};
+
+auto bc_quality_name(
+   bc_quality_t quality )
+   -> const char*;
+
+auto bc_format_name(
+   VkFormat format )
+   -> const char*;
+
+// Compresses an RGBA8 level of width x height texels to BC1 (opaque, four colour blocks)
+// or BC7 (mode 6 only) blocks, one row of blocks per task on the shared thread pool.
+// Edge blocks of sizes that are not a multiple of 4 repeat the last row and column.
+// sRGB and UNORM variants encode alike.
+void encode_bc_level(
+   VkFormat format,
+   std::span<const std::byte> rgba,
+   uint32_t width,
+   uint32_t height,
+   bc_quality_t quality,
+   std::span<std::byte> blocks );
+
+// Expands blocks written by encode_bc_level() back to RGBA8
+void decode_bc_level(
+   VkFormat format,
+   std::span<const std::byte> blocks,
+   uint32_t width,
+   uint32_t height,
+   std::span<std::byte> rgba );
+
+struct bc_benchmark_t
+{
+   VkFormat format;
+   bc_quality_t quality;
+   double megapixels_per_second;
+   // Over the channels the format stores: RGB for BC1, RGBA for BC7
+   double psnr;
+};
+
+// Encodes the image with every format and quality and measures throughput and error
+auto benchmark_bc_encoder(
+   std::span<const std::byte> rgba,
+   uint32_t width,
+   uint32_t height )
+   -> std::vector<bc_benchmark_t>;
@@ -0,0 +1,660 @@
+#include "device_allocator.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+using namespace datapath;
+
+namespace
+{
+// Every range offset and size is a multiple of this, so ranges never share a
+// bufferImageGranularity page when the granularity is no larger
+constexpr VkDeviceSize min_alignment = 256;
+
+// TLSF: the first level splits free ranges by power of two, the second splits each power
+// of two linearly. Ranges below small_range_size all share the first list of the first level.
+constexpr uint32_t second_level_log2 = 4;
+constexpr uint32_t second_level_count = 1u << second_level_log2;
+constexpr uint32_t first_level_shift = static_cast<uint32_t>( std::countr_zero( min_alignment ) ) + second_level_log2;
+constexpr VkDeviceSize small_range_size = VkDeviceSize( 1 ) << first_level_shift;
+constexpr uint32_t first_level_count = 32;
+
+constexpr uint32_t null_range = std::numeric_limits<uint32_t>::max();
+
+// Heaps up to this size, such as a resizable BAR window or an integrated GPU's, take
+// blocks of an eighth of the heap
+constexpr VkDeviceSize small_heap_size = VkDeviceSize( 1 ) << 30;
+constexpr VkDeviceSize default_block_size = VkDeviceSize( 64 ) << 20;
+
+auto align_up(
+   VkDeviceSize value,
+   VkDeviceSize alignment )
+   -> VkDeviceSize
+{
+   return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+auto floor_log2(
+   VkDeviceSize value )
+   -> uint32_t
+{
+   return static_cast<uint32_t>( std::bit_width( value ) ) - 1;
+}
+
+// Lists holding free ranges of the given size
+auto list_of(
+   VkDeviceSize size )
+   -> std::pair<uint32_t, uint32_t>
+{
+   if ( size < small_range_size )
+   {
+      return { 0, static_cast<uint32_t>( size / min_alignment ) };
+   }
+
+   uint32_t log2 = floor_log2( size );
+   uint32_t second_level = static_cast<uint32_t>( size >> ( log2 - second_level_log2 ) ) - second_level_count;
+
+   return { log2 - first_level_shift + 1, second_level };
+}
+
+// First list whose every range holds the given size
+auto list_fitting(
+   VkDeviceSize size )
+   -> std::pair<uint32_t, uint32_t>
+{
+   if ( size >= small_range_size )
+   {
+      size += ( VkDeviceSize( 1 ) << ( floor_log2( size ) - second_level_log2 ) ) - 1;
+   }
+
+   return list_of( size );
+}
+}   // namespace
+
+// One vkAllocateMemory. Its free ranges are kept in the TLSF lists, and every range in
+// a doubly linked list by address so a freed range merges with free neighbours.
+class device_memory_block_t
+{
+public:
+   device_memory_block_t(
+      VkDeviceMemory_resource_t memory,
+      VkDeviceSize size,
+      std::byte* mapped,
+      uint32_t pool,
+      bool dedicated )
+      : memory( std::move( memory ) ),
+        size( size ),
+        mapped( mapped ),
+        pool( pool ),
+        dedicated( dedicated )
+   {
+      for ( auto& lists : free_lists )
+      {
+         lists.fill( null_range );
+      }
+
+      insert_free( new_range( 0, size, null_range, null_range ) );
+   }
+
+   // The range and its aligned offset, if a free range is large enough
+   auto allocate(
+      VkDeviceSize allocation_size,
+      VkDeviceSize alignment )
+      -> std::optional<std::pair<uint32_t, VkDeviceSize>>
+   {
+      if ( allocation_size > size )
+      {
+         return std::nullopt;
+      }
+
+      // Free ranges start at a multiple of min_alignment, so larger alignments may need
+      // up to the difference in front
+      VkDeviceSize padding_needed = alignment > min_alignment ? alignment - min_alignment : 0;
+      uint32_t index = find_free( std::min( allocation_size + padding_needed, size ) );
+      if ( index == null_range )
+      {
+         return std::nullopt;
+      }
+
+      VkDeviceSize aligned_offset = align_up( ranges[index].offset, alignment );
+      if ( aligned_offset + allocation_size > ranges[index].offset + ranges[index].size )
+      {
+         return std::nullopt;
+      }
+
+      remove_free( index );
+
+      if ( aligned_offset > ranges[index].offset )
+      {
+         // The padding in front stays free
+         VkDeviceSize padding = aligned_offset - ranges[index].offset;
+         uint32_t prev = ranges[index].prev_physical;
+         uint32_t front = new_range( ranges[index].offset, padding, prev, index );
+
+         if ( prev != null_range )
+         {
+            ranges[prev].next_physical = front;
+         }
+         ranges[index].prev_physical = front;
+         ranges[index].offset = aligned_offset;
+         ranges[index].size -= padding;
+         insert_free( front );
+      }
+
+      if ( ranges[index].size > allocation_size )
+      {
+         uint32_t next = ranges[index].next_physical;
+         uint32_t back =
+            new_range(
+               ranges[index].offset + allocation_size,
+               ranges[index].size - allocation_size,
+               index,
+               next );
+
+         if ( next != null_range )
+         {
+            ranges[next].prev_physical = back;
+         }
+         ranges[index].next_physical = back;
+         ranges[index].size = allocation_size;
+         insert_free( back );
+      }
+
+      ranges[index].free = false;
+      used += allocation_size;
+      ++allocation_count;
+
+      return std::pair( index, aligned_offset );
+   }
+
+   void free(
+      uint32_t index )
+   {
+      used -= ranges[index].size;
+      --allocation_count;
+      ranges[index].free = true;
+
+      uint32_t prev = ranges[index].prev_physical;
+      if ( prev != null_range && ranges[prev].free )
+      {
+         remove_free( prev );
+         ranges[prev].size += ranges[index].size;
+         link_next( prev, ranges[index].next_physical );
+         release_range( index );
+         index = prev;
+      }
+
+      uint32_t next = ranges[index].next_physical;
+      if ( next != null_range && ranges[next].free )
+      {
+         remove_free( next );
+         ranges[index].size += ranges[next].size;
+         link_next( index, ranges[next].next_physical );
+         release_range( next );
+      }
+
+      insert_free( index );
+   }
+
+   auto empty() const
+      -> bool
+   {
+      return allocation_count == 0;
+   }
+
+   VkDeviceMemory_resource_t memory;
+   VkDeviceSize size;
+   std::byte* mapped;
+   uint32_t pool;
+   bool dedicated;
+   VkDeviceSize used{ 0 };
+   uint32_t allocation_count{ 0 };
+
+private:
+   struct range_t
+   {
+      VkDeviceSize offset;
+      VkDeviceSize size;
+      uint32_t prev_physical;
+      uint32_t next_physical;
+      uint32_t prev_free;
+      uint32_t next_free;
+      bool free;
+   };
+
+   auto new_range(
+      VkDeviceSize offset,
+      VkDeviceSize range_size,
+      uint32_t prev_physical,
+      uint32_t next_physical )
+      -> uint32_t
+   {
+      range_t range{ offset, range_size, prev_physical, next_physical, null_range, null_range, true };
+
+      if ( !unused_ranges.empty() )
+      {
+         uint32_t index = unused_ranges.back();
+         unused_ranges.pop_back();
+         ranges[index] = range;
+         return index;
+      }
+
+      ranges.push_back( range );
+      return static_cast<uint32_t>( ranges.size() - 1 );
+   }
+
+   void release_range(
+      uint32_t index )
+   {
+      unused_ranges.push_back( index );
+   }
+
+   // Makes next the range after index, and index the one in front of next, when merging
+   void link_next(
+      uint32_t index,
+      uint32_t next )
+   {
+      ranges[index].next_physical = next;
+
+      if ( next != null_range )
+      {
+         ranges[next].prev_physical = index;
+      }
+   }
+
+   void insert_free(
+      uint32_t index )
+   {
+      auto [first_level, second_level] = list_of( ranges[index].size );
+      uint32_t& head = free_lists[first_level][second_level];
+
+      ranges[index].free = true;
+      ranges[index].prev_free = null_range;
+      ranges[index].next_free = head;
+      if ( head != null_range )
+      {
+         ranges[head].prev_free = index;
+      }
+      head = index;
+
+      first_level_bitmap |= 1u << first_level;
+      second_level_bitmaps[first_level] |= 1u << second_level;
+   }
+
+   void remove_free(
+      uint32_t index )
+   {
+      auto [first_level, second_level] = list_of( ranges[index].size );
+      const range_t& range = ranges[index];
+
+      if ( range.prev_free != null_range )
+      {
+         ranges[range.prev_free].next_free = range.next_free;
+      }
+      else
+      {
+         free_lists[first_level][second_level] = range.next_free;
+      }
+
+      if ( range.next_free != null_range )
+      {
+         ranges[range.next_free].prev_free = range.prev_free;
+      }
+
+      if ( free_lists[first_level][second_level] == null_range )
+      {
+         second_level_bitmaps[first_level] &= ~( 1u << second_level );
+         if ( second_level_bitmaps[first_level] == 0 )
+         {
+            first_level_bitmap &= ~( 1u << first_level );
+         }
+      }
+   }
+
+   // A free range of at least the given size, found from the bitmaps without walking
+   // any list. Only when no list is certain to fit is the list the size itself falls
+   // in searched, which is what lets a range as large as the whole block be found.
+   auto find_free(
+      VkDeviceSize range_size )
+      -> uint32_t
+   {
+      auto [first_level, second_level] = list_fitting( range_size );
+
+      uint32_t second_level_map =
+         first_level < first_level_count ? second_level_bitmaps[first_level] & ( ~0u << second_level ) : 0;
+      if ( second_level_map == 0 )
+      {
+         uint32_t first_level_map =
+            first_level + 1 < first_level_count ? first_level_bitmap & ( ~0u << ( first_level + 1 ) ) : 0;
+         if ( first_level_map == 0 )
+         {
+            return find_free_in_own_list( range_size );
+         }
+
+         first_level = static_cast<uint32_t>( std::countr_zero( first_level_map ) );
+         second_level_map = second_level_bitmaps[first_level];
+      }
+
+      second_level = static_cast<uint32_t>( std::countr_zero( second_level_map ) );
+      return free_lists[first_level][second_level];
+   }
+
+   auto find_free_in_own_list(
+      VkDeviceSize range_size )
+      -> uint32_t
+   {
+      auto [first_level, second_level] = list_of( range_size );
+      if ( first_level >= first_level_count )
+      {
+         return null_range;
+      }
+
+      for ( uint32_t index = free_lists[first_level][second_level];
+            index != null_range;
+            index = ranges[index].next_free )
+      {
+         if ( ranges[index].size >= range_size )
+         {
+            return index;
+         }
+      }
+
+      return null_range;
+   }
+
+   std::vector<range_t> ranges;
+   std::vector<uint32_t> unused_ranges;
+   std::array<std::array<uint32_t, second_level_count>, first_level_count> free_lists;
+   uint32_t first_level_bitmap{ 0 };
+   std::array<uint32_t, first_level_count> second_level_bitmaps{};
+};
+
+//______________________________________________________________________________
+
+device_allocation_t::device_allocation_t(
+   device_allocation_t&& other ) noexcept
+   : allocator( std::exchange( other.allocator, nullptr ) ),
+     block( std::exchange( other.block, nullptr ) ),
+     range( other.range ),
+     device_memory( std::exchange( other.device_memory, VK_NULL_HANDLE ) ),
+     range_offset( std::exchange( other.range_offset, 0 ) ),
+     range_size( std::exchange( other.range_size, 0 ) ),
+     mapped( std::exchange( other.mapped, nullptr ) )
+{
+}
+
+auto device_allocation_t::operator=(
+   device_allocation_t&& other ) noexcept
+   -> device_allocation_t&
+{
+   if ( this != &other )
+   {
+      reset();
+
+      allocator = std::exchange( other.allocator, nullptr );
+      block = std::exchange( other.block, nullptr );
+      range = other.range;
+      device_memory = std::exchange( other.device_memory, VK_NULL_HANDLE );
+      range_offset = std::exchange( other.range_offset, 0 );
+      range_size = std::exchange( other.range_size, 0 );
+      mapped = std::exchange( other.mapped, nullptr );
+   }
+
+   return *this;
+}
+
+device_allocation_t::~device_allocation_t()
+{
+   reset();
+}
+
+void device_allocation_t::reset()
+{
+   if ( allocator )
+   {
+      allocator->free( *this );
+
+      allocator = nullptr;
+      block = nullptr;
+      device_memory = VK_NULL_HANDLE;
+      range_offset = 0;
+      range_size = 0;
+      mapped = nullptr;
+   }
+}
+
+//______________________________________________________________________________
+
+device_allocator_t::device_allocator_t(
+   std::shared_ptr<const datapath::device_dispatcher_t> logical_device,
+   const VkPhysicalDeviceMemoryProperties& memory_properties,
+   VkDeviceSize buffer_image_granularity )
+   : logical_device( std::move( logical_device ) ),
+     memory_properties( memory_properties ),
+     separate_layouts( buffer_image_granularity > min_alignment )
+{
+   // With a coarse granularity linear and optimal resources live in separate blocks,
+   // rather than every range being padded to it
+   uint32_t layouts = separate_layouts ? 2 : 1;
+
+   for ( uint32_t memory_type = 0;
+         memory_type < memory_properties.memoryTypeCount;
+         ++memory_type )
+   {
+      VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+      VkDeviceSize block_size =
+         heap_size <= small_heap_size ? align_up( heap_size / 8, min_alignment ) : default_block_size;
+
+      for ( uint32_t layout = 0;
+            layout < layouts;
+            ++layout )
+      {
+         pool_t pool;
+         pool.memory_type = memory_type;
+         pool.block_size = std::max( block_size, small_range_size );
+         pools.push_back( std::move( pool ) );
+      }
+   }
+}
+
+device_allocator_t::~device_allocator_t() = default;
+
+auto device_allocator_t::allocate(
+   const VkMemoryRequirements& requirements,
+   VkMemoryPropertyFlags properties,
+   device_resource_layout_t layout )
+   -> device_allocation_t
+{
+   uint32_t memory_type = find_memory_type( requirements.memoryTypeBits, properties );
+   uint32_t pool = separate_layouts ? memory_type * 2 + ( layout == device_resource_layout_t::optimal ? 1 : 0 )
+                                    : memory_type;
+
+   VkDeviceSize size = align_up( requirements.size, min_alignment );
+   VkDeviceSize alignment = std::max( requirements.alignment, min_alignment );
+   VkDeviceSize block_size = pools[pool].block_size;
+
+   // A large image would leave too little of a block for anything else, and anything
+   // over half a block could strand the rest of it
+   bool dedicated = size > block_size / 2 ||
+                    ( layout == device_resource_layout_t::optimal && size >= block_size / 4 );
+
+   std::scoped_lock lock( mutex );
+
+   auto& blocks = pools[pool].blocks;
+   device_memory_block_t* block = nullptr;
+   std::optional<std::pair<uint32_t, VkDeviceSize>> range;
+
+   if ( !dedicated )
+   {
+      for ( auto& candidate : blocks )
+      {
+         if ( !candidate->dedicated )
+         {
+            range = candidate->allocate( size, alignment );
+            if ( range.has_value() )
+            {
+               block = candidate.get();
+               break;
+            }
+         }
+      }
+   }
+
+   if ( !block )
+   {
+      blocks.push_back( allocate_block( pool, dedicated ? size : block_size, size, dedicated ) );
+      block = blocks.back().get();
+      range = block->allocate( size, alignment );
+
+      if ( !range.has_value() )
+      {
+         blocks.pop_back();
+         throw std::runtime_error( "failed to allocate device memory!" );
+      }
+   }
+
+   device_allocation_t allocation;
+   allocation.allocator = this;
+   allocation.block = block;
+   allocation.range = range->first;
+   allocation.device_memory = block->memory.get();
+   allocation.range_offset = range->second;
+   allocation.range_size = size;
+   allocation.mapped = block->mapped ? block->mapped + range->second : nullptr;
+
+   return allocation;
+}
+
+auto device_allocator_t::statistics() const
+   -> device_allocator_statistics_t
+{
+   std::scoped_lock lock( mutex );
+
+   device_allocator_statistics_t stats;
+   for ( const auto& pool : pools )
+   {
+      for ( const auto& block : pool.blocks )
+      {
+         ++stats.block_count;
+         stats.dedicated_count += block->dedicated ? 1 : 0;
+         stats.allocation_count += block->allocation_count;
+         stats.bytes_reserved += block->size;
+         stats.bytes_allocated += block->used;
+      }
+   }
+
+   return stats;
+}
+
+void device_allocator_t::free(
+   device_allocation_t& allocation )
+{
+   std::scoped_lock lock( mutex );
+
+   device_memory_block_t* block = allocation.block;
+   block->free( allocation.range );
+
+   if ( !block->empty() )
+   {
+      return;
+   }
+
+   // One empty block per pool is kept, so a resource recreated every frame or on resize
+   // does not allocate and free device memory each time
+   auto& blocks = pools[block->pool].blocks;
+   bool keep =
+      !block->dedicated &&
+      std::none_of(
+         blocks.begin(),
+         blocks.end(),
+         [block]( const auto& other )
+         {
+            return other.get() != block && !other->dedicated && other->empty();
+         } );
+
+   if ( !keep )
+   {
+      std::erase_if(
+         blocks,
+         [block]( const auto& other )
+         {
+            return other.get() == block;
+         } );
+   }
+}
+
+auto device_allocator_t::find_memory_type(
+   uint32_t type_filter,
+   VkMemoryPropertyFlags properties ) const
+   -> uint32_t
+{
+   for ( uint32_t i = 0;
+         i < memory_properties.memoryTypeCount;
+         i++ )
+   {
+      if ( ( type_filter & ( 1 << i ) ) &&
+           ( memory_properties.memoryTypes[i].propertyFlags & properties ) == properties )
+      {
+         return i;
+      }
+   }
+
+   throw std::runtime_error( "failed to find suitable memory type!" );
+}
+
+auto device_allocator_t::allocate_block(
+   uint32_t pool,
+   VkDeviceSize size,
+   VkDeviceSize min_size,
+   bool dedicated )
+   -> std::unique_ptr<device_memory_block_t>
+{
+   uint32_t memory_type = pools[pool].memory_type;
+
+   // A full block may not fit in what is left of the heap when a smaller one would
+   for ( VkDeviceSize block_size = size;
+         ;
+         block_size /= 2 )
+   {
+      auto memory = logical_device->vkAllocateMemory(
+         VkMemoryAllocateInfo{
+            .sType = get_sType<VkMemoryAllocateInfo>(),
+            .allocationSize = block_size,
+            .memoryTypeIndex = memory_type } );
+
+      if ( memory.holds_error() )
+      {
+         if ( block_size / 2 < min_size )
+         {
+            throw std::runtime_error( "failed to allocate device memory!" );
+         }
+
+         continue;
+      }
+
+      auto device_memory = std::move( memory ).value();
+
+      // Mapped once; vkFreeMemory unmaps it
+      void* mapped = nullptr;
+      if ( memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+      {
+         if ( logical_device->vkMapMemory( device_memory.get(), 0, VK_WHOLE_SIZE, 0, &mapped ) != VK_SUCCESS )
+         {
+            throw std::runtime_error( "failed to map device memory!" );
+         }
+      }
+
+      return
+         std::make_unique<device_memory_block_t>(
+            std::move( device_memory ),
+            block_size,
+            static_cast<std::byte*>( mapped ),
+            pool,
+            dedicated );
+   }
+}
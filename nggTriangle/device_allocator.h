@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vulkan_utils/vulkan_utils.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class device_allocator_t;
+class device_memory_block_t;
+
+// Buffers and linear images are laid out linearly, optimal tiling images are not. The two
+// must not share a bufferImageGranularity page of the same memory.
+enum class device_resource_layout_t
+{
+   linear,
+   optimal
+};
+
+// Memory bound to one buffer or image: a range of a shared block, or a dedicated
+// vkAllocateMemory of its own. Host visible memory is mapped for the life of its block.
+// Returned to the allocator on destruction.
+class device_allocation_t
+{
+public:
+   device_allocation_t() = default;
+
+   device_allocation_t(
+      device_allocation_t&& other ) noexcept;
+
+   auto operator=(
+      device_allocation_t&& other ) noexcept
+      -> device_allocation_t&;
+
+   ~device_allocation_t();
+
+   void reset();
+
+   auto memory() const
+      -> VkDeviceMemory
+   {
+      return device_memory;
+   }
+
+   auto offset() const
+      -> VkDeviceSize
+   {
+      return range_offset;
+   }
+
+   auto size() const
+      -> VkDeviceSize
+   {
+      return range_size;
+   }
+
+   // Start of the allocation in host address space, null unless the memory is host visible
+   auto mapped_data() const
+      -> std::byte*
+   {
+      return mapped;
+   }
+
+private:
+   friend class device_allocator_t;
+
+   device_allocator_t* allocator{ nullptr };
+   device_memory_block_t* block{ nullptr };
+   uint32_t range{ 0 };
+   VkDeviceMemory device_memory{ VK_NULL_HANDLE };
+   VkDeviceSize range_offset{ 0 };
+   VkDeviceSize range_size{ 0 };
+   std::byte* mapped{ nullptr };
+};
+
+struct device_allocator_statistics_t
+{
+   // Live vkAllocateMemory allocations, dedicated ones included
+   uint32_t block_count{ 0 };
+   uint32_t dedicated_count{ 0 };
+   // Live buffers and images
+   uint32_t allocation_count{ 0 };
+   VkDeviceSize bytes_reserved{ 0 };
+   VkDeviceSize bytes_allocated{ 0 };
+};
+
+// Sub-allocates buffer and image memory from a few large blocks per memory type, rather
+// than calling vkAllocateMemory for every resource. Each block hands out ranges with a
+// two-level segregated fit (TLSF) allocator, so finding and freeing a range does not
+// depend on how many the block holds. Large images get memory of their own. Safe to use
+// from any thread.
+class device_allocator_t
+{
+public:
+   device_allocator_t(
+      std::shared_ptr<const datapath::device_dispatcher_t> logical_device,
+      const VkPhysicalDeviceMemoryProperties& memory_properties,
+      VkDeviceSize buffer_image_granularity );
+
+   device_allocator_t(
+      const device_allocator_t& ) = delete;
+
+   auto operator=(
+      const device_allocator_t& )
+      -> device_allocator_t& = delete;
+
+   ~device_allocator_t();
+
+   auto allocate(
+      const VkMemoryRequirements& requirements,
+      VkMemoryPropertyFlags properties,
+      device_resource_layout_t layout )
+      -> device_allocation_t;
+
+   auto statistics() const
+      -> device_allocator_statistics_t;
+
+private:
+   friend class device_allocation_t;
+
+   // The blocks of one memory type, and of one layout when linear and optimal resources
+   // have to be kept apart
+   struct pool_t
+   {
+      uint32_t memory_type{ 0 };
+      VkDeviceSize block_size{ 0 };
+      std::vector<std::unique_ptr<device_memory_block_t>> blocks;
+   };
+
+   void free(
+      device_allocation_t& allocation );
+
+   auto find_memory_type(
+      uint32_t type_filter,
+      VkMemoryPropertyFlags properties ) const
+      -> uint32_t;
+
+   auto allocate_block(
+      uint32_t pool,
+      VkDeviceSize size,
+      VkDeviceSize min_size,
+      bool dedicated )
+      -> std::unique_ptr<device_memory_block_t>;
+
+   std::shared_ptr<const datapath::device_dispatcher_t> logical_device;
+   VkPhysicalDeviceMemoryProperties memory_properties;
+   bool separate_layouts{ false };
+   std::vector<pool_t> pools;
+   mutable std::mutex mutex;
+};
@@ -0,0 +1,39 @@
+#[[
+  Writes SPIRV_FILE as a header defining a constexpr std::array<uint32_t> named ARRAY_NAME.
+
+  cmake -DSPIRV_FILE=<file.spv> -DHEADER_FILE=<file.h> -DARRAY_NAME=<name> -P embed_spirv.cmake
+]]
+
+file(READ "${SPIRV_FILE}" spirv_hex HEX)
+
+string(LENGTH "${spirv_hex}" hex_length)
+math(EXPR word_count "${hex_length} / 8")
+math(EXPR remainder "${hex_length} % 8")
+
+if (word_count EQUAL 0 OR NOT remainder EQUAL 0)
+   message(FATAL_ERROR "${SPIRV_FILE} is not SPIR-V: its size is not a multiple of 4 bytes")
+endif()
+
+# SPIR-V is stored little endian, eight words to a line
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " spirv_words "${spirv_hex}")
+set(line_pattern "")
+foreach (word RANGE 1 8)
+   string(APPEND line_pattern "0x[0-9a-f]+u, ")
+endforeach()
+
+string(REGEX REPLACE "(${line_pattern})" "\\1\n   " spirv_words "${spirv_words}")
+string(REPLACE " \n" "\n" spirv_words "${spirv_words}")
+string(REGEX REPLACE "[, \n]+$" "" spirv_words "${spirv_words}")
+
+get_filename_component(spirv_name "${SPIRV_FILE}" NAME)
+
+file(WRITE "${HEADER_FILE}"
+"// Generated from ${spirv_name} by embed_spirv.cmake, do not edit
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+inline constexpr std::array<uint32_t, ${word_count}> ${ARRAY_NAME}{ {
+   ${spirv_words} } };
+")
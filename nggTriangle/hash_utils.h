@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined( _MSC_VER ) && defined( _M_X64 )
+#include <intrin.h>
+#endif
+
+// wyhash-style 64 bit hashing of raw bytes.
+namespace hash_utils
+{
+inline constexpr uint64_t secret0 = 0xa0761d6478bd642full;
+inline constexpr uint64_t secret1 = 0xe7037ed1a0b428dbull;
+inline constexpr uint64_t secret2 = 0x8ebc6af09c88c6e3ull;
+inline constexpr uint64_t secret3 = 0x589965cc75374cc3ull;
+
+// Multiply to 128 bits and fold the halves together
+inline auto mix(
+   uint64_t a,
+   uint64_t b )
+   -> uint64_t
+{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+   uint64_t high{};
+   uint64_t low = _umul128( a, b, &high );
+   return low ^ high;
+#elif defined( __SIZEOF_INT128__ )
+   __extension__ using uint128_t = unsigned __int128;
+   uint128_t product = static_cast<uint128_t>( a ) * b;
+   return static_cast<uint64_t>( product ) ^ static_cast<uint64_t>( product >> 64 );
+#else
+   uint64_t a_lo = a & 0xffffffffull, a_hi = a >> 32;
+   uint64_t b_lo = b & 0xffffffffull, b_hi = b >> 32;
+   uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+   uint64_t cross = ( lo_lo >> 32 ) + ( hi_lo & 0xffffffffull ) + lo_hi;
+   uint64_t low = ( cross << 32 ) | ( lo_lo & 0xffffffffull );
+   uint64_t high = ( hi_lo >> 32 ) + ( cross >> 32 ) + hi_hi;
+   return low ^ high;
+#endif
+}
+
+inline auto read64(
+   const std::byte* p )
+   -> uint64_t
+{
+   uint64_t value;
+   std::memcpy( &value, p, sizeof( value ) );
+   return value;
+}
+
+inline auto hash_bytes(
+   const void* data,
+   size_t length,
+   uint64_t seed = 0 )
+   -> uint64_t
+{
+   const auto* p = static_cast<const std::byte*>( data );
+   uint64_t h = seed ^ mix( seed ^ secret0, length ^ secret1 );
+
+   size_t remaining = length;
+   while ( remaining >= 16 )
+   {
+      h = mix( read64( p ) ^ secret1, read64( p + 8 ) ^ h );
+      p += 16;
+      remaining -= 16;
+   }
+
+   uint64_t a{ 0 };
+   uint64_t b{ 0 };
+   if ( remaining > 8 )
+   {
+      a = read64( p );
+      std::memcpy( &b, p + 8, remaining - 8 );
+   }
+   else
+   {
+      std::memcpy( &a, p, remaining );
+   }
+
+   return mix( secret1 ^ length, mix( a ^ secret1, b ^ h ^ secret2 ) );
+}
+
+inline auto hash_bytes(
+   std::span<const std::byte> bytes,
+   uint64_t seed = 0 )
+   -> uint64_t
+{
+   return hash_bytes( bytes.data(), bytes.size(), seed );
+}
+}   // namespace hash_utils
@@ -0,0 +1,82 @@
+#include "index_ranges.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr uint32_t index16_vertex_span = 65536;
+}   // namespace
+
+auto build_index16_buffer(
+   std::span<const uint32_t> indices,
+   size_t max_ranges )
+   -> std::optional<index16_buffer_t>
+{
+   index16_buffer_t buffer;
+   buffer.indices.resize( indices.size() );
+
+   size_t range_begin = 0;
+   uint32_t range_min = UINT32_MAX;
+   uint32_t range_max = 0;
+
+   auto close_range =
+      [&]( size_t range_end )
+      {
+         for ( size_t i = range_begin;
+               i < range_end;
+               ++i )
+         {
+            buffer.indices[i] = static_cast<uint16_t>( indices[i] - range_min );
+         }
+
+         buffer.ranges.push_back( {
+            .first_index = static_cast<uint32_t>( range_begin ),
+            .index_count = static_cast<uint32_t>( range_end - range_begin ),
+            .vertex_offset = static_cast<int32_t>( range_min ) } );
+      };
+
+   // Ranges are cut on triangle boundaries
+   for ( size_t triangle = 0;
+         triangle < indices.size() / 3;
+         ++triangle )
+   {
+      auto [triangle_min, triangle_max] =
+         std::minmax( { indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2] } );
+
+      // No range can hold a triangle spanning this many vertices by itself
+      if ( triangle_max - triangle_min >= index16_vertex_span )
+      {
+         return std::nullopt;
+      }
+
+      uint32_t new_min = std::min( range_min, triangle_min );
+      uint32_t new_max = std::max( range_max, triangle_max );
+
+      if ( new_max - new_min >= index16_vertex_span )
+      {
+         if ( range_begin < triangle * 3 )
+         {
+            close_range( triangle * 3 );
+         }
+
+         if ( buffer.ranges.size() >= max_ranges )
+         {
+            return std::nullopt;
+         }
+
+         range_begin = triangle * 3;
+         new_min = triangle_min;
+         new_max = triangle_max;
+      }
+
+      range_min = new_min;
+      range_max = new_max;
+   }
+
+   if ( range_begin < indices.size() )
+   {
+      close_range( indices.size() );
+   }
+
+   return buffer;
+}
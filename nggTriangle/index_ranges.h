@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// One vkCmdDrawIndexed call: indices are relative to vertex_offset
+struct index_range_t
+{
+   uint32_t first_index;
+   uint32_t index_count;
+   int32_t vertex_offset;
+};
+
+struct index16_buffer_t
+{
+   std::vector<uint16_t> indices;
+   std::vector<index_range_t> ranges;
+};
+
+// Splits the triangle list into consecutive ranges whose vertices span at most 65536
+// entries, so each range can use 16-bit indices with a base vertex offset. Meshes with
+// fewer than 65536 vertices always give a single range. Returns nothing if more than
+// max_ranges ranges would be needed, the extra draws not being worth the saved bandwidth,
+// or if a single triangle spans 65536 vertices or more.
+auto build_index16_buffer(
+   std::span<const uint32_t> indices,
+   size_t max_ranges )
+   -> std::optional<index16_buffer_t>;
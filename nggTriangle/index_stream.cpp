@@ -0,0 +1,65 @@
+#include "index_stream.h"
+
+auto encode_index_stream(
+   std::span<const uint32_t> indices )
+   -> std::vector<std::byte>
+{
+   std::vector<std::byte> stream;
+   stream.reserve( indices.size() + indices.size() / 4 );
+
+   uint32_t previous = 0;
+
+   for ( uint32_t index : indices )
+   {
+      // Wrapping subtraction keeps every delta in 32 bits
+      auto delta = static_cast<int32_t>( index - previous );
+      auto zigzag = ( static_cast<uint32_t>( delta ) << 1 ) ^ static_cast<uint32_t>( delta >> 31 );
+      previous = index;
+
+      while ( zigzag >= 0x80 )
+      {
+         stream.push_back( static_cast<std::byte>( ( zigzag & 0x7f ) | 0x80 ) );
+         zigzag >>= 7;
+      }
+      stream.push_back( static_cast<std::byte>( zigzag ) );
+   }
+
+   return stream;
+}
+
+auto decode_index_stream(
+   std::span<const std::byte> stream,
+   std::span<uint32_t> indices )
+   -> bool
+{
+   const auto* cursor = stream.data();
+   const auto* end = stream.data() + stream.size();
+
+   uint32_t previous = 0;
+
+   for ( uint32_t& index : indices )
+   {
+      uint32_t zigzag = 0;
+
+      for ( uint32_t shift = 0;; shift += 7 )
+      {
+         if ( cursor == end || shift > 28 )
+         {
+            return false;
+         }
+
+         auto byte = static_cast<uint32_t>( *cursor++ );
+         zigzag |= ( byte & 0x7f ) << shift;
+
+         if ( ( byte & 0x80 ) == 0 )
+         {
+            break;
+         }
+      }
+
+      previous += ( zigzag >> 1 ) ^ ( 0u - ( zigzag & 1 ) );
+      index = previous;
+   }
+
+   return cursor == end;
+}
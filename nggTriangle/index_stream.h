@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Compact on-disk form of an index buffer: each index is stored as the zigzag encoded
+// difference to the previous one in LEB128 varint bytes. After the vertex fetch pass
+// most indices are close to their predecessor and take a single byte.
+auto encode_index_stream(
+   std::span<const uint32_t> indices )
+   -> std::vector<std::byte>;
+
+// Decodes exactly indices.size() indices. Returns false if the stream is malformed or
+// does not hold exactly that many.
+auto decode_index_stream(
+   std::span<const std::byte> stream,
+   std::span<uint32_t> indices )
+   -> bool;
@@ -1,7 +1,12 @@
+#include "texture_cooker.h"
+#include "virtual_texture.h"
 #include "vulkan_tutorial.h"
+#include <charconv>
 #include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
+#include <string_view>
 
 constexpr uint32_t WIDTH = 800;
 constexpr uint32_t HEIGHT = 600;
@@ -11,10 +16,136 @@ const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation
 const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
 
-int main()
+int main(
+   int argc,
+   char* argv[] )
 {
    vulkan_tutorial app;
 
+   mesh_import_options_t mesh_options{};
+
+   // An archive next to the executable is found whatever the working directory
+   std::error_code error;
+   auto default_archive = std::filesystem::path( argv[0] ).parent_path() / "assets.ngpack";
+   if ( std::filesystem::exists( default_archive, error ) )
+   {
+      app.set_asset_archive( default_archive );
+   }
+
+   for ( int i = 1;
+         i < argc;
+         ++i )
+   {
+      std::string_view arg( argv[i] );
+
+      if ( arg == "--no-vertex-cache-optimization" )
+      {
+         mesh_options.optimize_vertex_cache = false;
+      }
+      else if ( arg == "--no-overdraw-optimization" )
+      {
+         mesh_options.optimize_overdraw = false;
+      }
+      else if ( arg == "--no-vertex-fetch-optimization" )
+      {
+         mesh_options.optimize_vertex_fetch = false;
+      }
+      else if ( arg == "--no-lods" )
+      {
+         mesh_options.generate_lods = false;
+      }
+      else if ( arg == "--full-vertices" )
+      {
+         mesh_options.packed_vertices = false;
+      }
+      else if ( arg == "--no-meshlet-culling" )
+      {
+         mesh_options.meshlet_culling = false;
+      }
+      else if ( arg == "--sync-mesh-loading" )
+      {
+         mesh_options.async_loading = false;
+      }
+      else if ( arg == "--benchmark-texture-encoder" && i + 1 < argc )
+      {
+         // Only measures the block encoder on the given image, the app is not started
+         try
+         {
+            for ( const auto& result : benchmark_texture_encoder( argv[++i] ) )
+            {
+               std::cout << bc_format_name( result.format ) << " " << bc_quality_name( result.quality ) << ": "
+                         << result.megapixels_per_second << " MPix/s, PSNR " << result.psnr << " dB" << std::endl;
+            }
+         }
+         catch ( const std::exception& e )
+         {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+         }
+
+         return EXIT_SUCCESS;
+      }
+      else if ( arg == "--cook-virtual-texture" && i + 2 < argc )
+      {
+         // Tiles the image into a BC7 virtual texture file, the app is not started
+         try
+         {
+            virtual_texture_file_t::cook( argv[i + 1], argv[i + 2], VK_FORMAT_BC7_SRGB_BLOCK );
+         }
+         catch ( const std::exception& e )
+         {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+         }
+
+         return EXIT_SUCCESS;
+      }
+      else if ( arg == "--pack-assets" && i + 1 < argc )
+      {
+         // Packs the loose assets below the working directory, the app is not started
+         try
+         {
+            vulkan_tutorial::pack_assets( argv[++i] );
+         }
+         catch ( const std::exception& e )
+         {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+         }
+
+         return EXIT_SUCCESS;
+      }
+      else if ( arg == "--asset-archive" && i + 1 < argc )
+      {
+         app.set_asset_archive( argv[++i] );
+      }
+      else if ( arg == "--verify-asset-archive" )
+      {
+         app.set_verify_asset_archive( true );
+      }
+      else if ( arg == "--hot-reload" )
+      {
+         app.set_hot_reload( true );
+      }
+      else if ( arg == "--virtual-texture" && i + 1 < argc )
+      {
+         app.set_virtual_texture( argv[++i] );
+      }
+      else if ( arg == "--overdraw-threshold" && i + 1 < argc )
+      {
+         std::string_view value( argv[++i] );
+         auto result = std::from_chars( value.data(), value.data() + value.size(), mesh_options.overdraw_threshold );
+
+         if ( result.ec != std::errc() || mesh_options.overdraw_threshold < 1.0f )
+         {
+            std::cerr << "--overdraw-threshold expects a number of at least 1.0" << std::endl;
+            return EXIT_FAILURE;
+         }
+      }
+   }
+
+   app.set_mesh_import_options( mesh_options );
+
    try
    {
       app.run( "Vulkan DP Tutorial", WIDTH, HEIGHT );
@@ -0,0 +1,160 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file_t::mapped_file_t(
+   const std::filesystem::path& path )
+{
+#ifdef _WIN32
+   HANDLE file =
+      CreateFileW(
+         path.c_str(),
+         GENERIC_READ,
+         FILE_SHARE_READ,
+         nullptr,
+         OPEN_EXISTING,
+         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+         nullptr );
+
+   if ( file == INVALID_HANDLE_VALUE )
+   {
+      throw std::runtime_error( "failed to open file for mapping: " + path.string() );
+   }
+
+   LARGE_INTEGER file_size{};
+   if ( !GetFileSizeEx( file, &file_size ) )
+   {
+      CloseHandle( file );
+      throw std::runtime_error( "failed to query file size: " + path.string() );
+   }
+
+   file_handle = file;
+   size = static_cast<size_t>( file_size.QuadPart );
+   opened = true;
+
+   if ( size == 0 )
+   {
+      return;
+   }
+
+   mapping_handle = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+   if ( !mapping_handle )
+   {
+      close();
+      throw std::runtime_error( "failed to create file mapping: " + path.string() );
+   }
+
+   view = static_cast<const std::byte*>( MapViewOfFile( mapping_handle, FILE_MAP_READ, 0, 0, 0 ) );
+   if ( !view )
+   {
+      close();
+      throw std::runtime_error( "failed to map view of file: " + path.string() );
+   }
+#else
+   int fd = ::open( path.c_str(), O_RDONLY );
+   if ( fd < 0 )
+   {
+      throw std::runtime_error( "failed to open file for mapping: " + path.string() );
+   }
+
+   struct stat file_stat{};
+   if ( ::fstat( fd, &file_stat ) != 0 )
+   {
+      ::close( fd );
+      throw std::runtime_error( "failed to query file size: " + path.string() );
+   }
+
+   size = static_cast<size_t>( file_stat.st_size );
+   opened = true;
+
+   if ( size > 0 )
+   {
+      void* address = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if ( address == MAP_FAILED )
+      {
+         ::close( fd );
+         size = 0;
+         opened = false;
+         throw std::runtime_error( "failed to map file: " + path.string() );
+      }
+
+      ::madvise( address, size, MADV_SEQUENTIAL );
+      view = static_cast<const std::byte*>( address );
+   }
+
+   // The mapping keeps its own reference to the file
+   ::close( fd );
+#endif
+}
+
+mapped_file_t::mapped_file_t(
+   mapped_file_t&& other ) noexcept
+{
+   *this = std::move( other );
+}
+
+auto mapped_file_t::operator=(
+   mapped_file_t&& other ) noexcept
+   -> mapped_file_t&
+{
+   if ( this != &other )
+   {
+      close();
+
+      view = std::exchange( other.view, nullptr );
+      size = std::exchange( other.size, 0 );
+      opened = std::exchange( other.opened, false );
+#ifdef _WIN32
+      file_handle = std::exchange( other.file_handle, nullptr );
+      mapping_handle = std::exchange( other.mapping_handle, nullptr );
+#endif
+   }
+
+   return *this;
+}
+
+mapped_file_t::~mapped_file_t()
+{
+   close();
+}
+
+void mapped_file_t::close()
+{
+#ifdef _WIN32
+   if ( view )
+   {
+      UnmapViewOfFile( view );
+   }
+   if ( mapping_handle )
+   {
+      CloseHandle( mapping_handle );
+      mapping_handle = nullptr;
+   }
+   if ( file_handle )
+   {
+      CloseHandle( file_handle );
+      file_handle = nullptr;
+   }
+#else
+   if ( view )
+   {
+      ::munmap( const_cast<std::byte*>( view ), size );
+   }
+#endif
+
+   view = nullptr;
+   size = 0;
+   opened = false;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+// Read-only memory mapping of a whole file.
+class mapped_file_t
+{
+public:
+   mapped_file_t() = default;
+
+   explicit mapped_file_t(
+      const std::filesystem::path& path );
+
+   mapped_file_t(
+      mapped_file_t&& other ) noexcept;
+
+   auto operator=(
+      mapped_file_t&& other ) noexcept
+      -> mapped_file_t&;
+
+   mapped_file_t(
+      const mapped_file_t& ) = delete;
+
+   auto operator=(
+      const mapped_file_t& )
+      -> mapped_file_t& = delete;
+
+   ~mapped_file_t();
+
+   auto data() const
+      -> std::span<const std::byte>
+   {
+      return { view, size };
+   }
+
+   auto is_open() const
+      -> bool
+   {
+      return opened;
+   }
+
+   void close();
+
+private:
+   const std::byte* view{ nullptr };
+   size_t size{ 0 };
+   bool opened{ false };
+
+#ifdef _WIN32
+   void* file_handle{ nullptr };
+   void* mapping_handle{ nullptr };
+#endif
+};
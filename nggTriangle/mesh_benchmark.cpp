@@ -0,0 +1,296 @@
+// Benchmarks for the mesh import pipeline.
+//
+//    NggMeshBenchmark [model.obj] [synthetic triangle count]
+//
+// Defaults to the bundled viking_room.obj and a synthetic grid of 4M triangles.
+// Compares the OBJ parser against tinyobj and the vertex dedup table against
+// std::unordered_map, reporting throughput and hash collision rates.
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "obj_parser.h"
+#include "vertex_dedup.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+constexpr int benchmark_runs = 5;
+
+// Best of benchmark_runs, in milliseconds
+auto time_best_of(
+   const std::function<void()>& body )
+   -> double
+{
+   double best = std::numeric_limits<double>::max();
+
+   for ( int run = 0;
+         run < benchmark_runs;
+         ++run )
+   {
+      auto start = std::chrono::steady_clock::now();
+      body();
+      auto stop = std::chrono::steady_clock::now();
+
+      best = std::min( best, std::chrono::duration<double, std::milli>( stop - start ).count() );
+   }
+
+   return best;
+}
+
+auto flatten_indices(
+   const std::vector<tinyobj::shape_t>& shapes )
+   -> std::vector<tinyobj::index_t>
+{
+   std::vector<tinyobj::index_t> indices;
+   for ( const auto& shape : shapes )
+   {
+      indices.insert( indices.end(), shape.mesh.indices.begin(), shape.mesh.indices.end() );
+   }
+   return indices;
+}
+
+auto same_geometry(
+   const tinyobj::attrib_t& a,
+   const std::vector<tinyobj::shape_t>& a_shapes,
+   const tinyobj::attrib_t& b,
+   const std::vector<tinyobj::shape_t>& b_shapes )
+   -> bool
+{
+   if ( a.vertices != b.vertices || a.texcoords != b.texcoords || a.normals != b.normals )
+   {
+      return false;
+   }
+
+   auto a_indices = flatten_indices( a_shapes );
+   auto b_indices = flatten_indices( b_shapes );
+
+   return std::equal(
+      a_indices.begin(),
+      a_indices.end(),
+      b_indices.begin(),
+      b_indices.end(),
+      []( const tinyobj::index_t& x, const tinyobj::index_t& y )
+      {
+         return x.vertex_index == y.vertex_index && x.texcoord_index == y.texcoord_index &&
+                x.normal_index == y.normal_index;
+      } );
+}
+
+// Square grid with per-vertex UVs, written the way Blender exports
+void write_synthetic_obj(
+   const std::filesystem::path& path,
+   size_t triangle_count )
+{
+   auto side = static_cast<size_t>( std::sqrt( static_cast<double>( triangle_count / 2 ) ) ) + 1;
+
+   std::ofstream out( path );
+   if ( !out.is_open() )
+   {
+      throw std::runtime_error( "failed to create synthetic OBJ!" );
+   }
+
+   out << "o synthetic_grid\n";
+   out.setf( std::ios::fixed );
+   out.precision( 6 );
+
+   for ( size_t y = 0;
+         y < side;
+         ++y )
+   {
+      for ( size_t x = 0;
+            x < side;
+            ++x )
+      {
+         float u = static_cast<float>( x ) / static_cast<float>( side - 1 );
+         float v = static_cast<float>( y ) / static_cast<float>( side - 1 );
+         out << "v " << u << ' ' << v << ' ' << std::sin( u * 20.0f ) * 0.05f << '\n';
+         out << "vt " << u << ' ' << v << '\n';
+      }
+   }
+
+   out << "vn 0.0000 0.0000 1.0000\n";
+
+   for ( size_t y = 0;
+         y + 1 < side;
+         ++y )
+   {
+      for ( size_t x = 0;
+            x + 1 < side;
+            ++x )
+      {
+         size_t i0 = y * side + x + 1;
+         size_t i1 = i0 + 1;
+         size_t i2 = i0 + side;
+         size_t i3 = i2 + 1;
+
+         out << "f " << i0 << '/' << i0 << "/1 " << i1 << '/' << i1 << "/1 " << i3 << '/' << i3 << "/1\n";
+         out << "f " << i0 << '/' << i0 << "/1 " << i3 << '/' << i3 << "/1 " << i2 << '/' << i2 << "/1\n";
+      }
+   }
+}
+
+void benchmark_obj_parsers(
+   const std::filesystem::path& path )
+{
+   double megabytes = static_cast<double>( std::filesystem::file_size( path ) ) / ( 1024.0 * 1024.0 );
+
+   tinyobj::attrib_t tiny_attrib;
+   std::vector<tinyobj::shape_t> tiny_shapes;
+   double tiny_ms = time_best_of(
+      [&]()
+      {
+         std::vector<tinyobj::material_t> materials;
+         std::string warn, err;
+         tiny_attrib = {};
+         tiny_shapes.clear();
+
+         if ( !tinyobj::LoadObj( &tiny_attrib, &tiny_shapes, &materials, &warn, &err, path.string().c_str() ) )
+         {
+            throw std::runtime_error( warn + err );
+         }
+      } );
+
+   tinyobj::attrib_t parallel_attrib;
+   std::vector<tinyobj::shape_t> parallel_shapes;
+   double parallel_ms = time_best_of( [&]() { load_obj_parallel( path, parallel_attrib, parallel_shapes ); } );
+
+   std::cout << path.filename().string() << " (" << megabytes << " MB, "
+             << thread_pool_t::shared().size() << " threads)\n"
+             << "   tinyobj::LoadObj   " << tiny_ms << " ms  " << megabytes / ( tiny_ms / 1000.0 ) << " MB/s\n"
+             << "   load_obj_parallel  " << parallel_ms << " ms  " << megabytes / ( parallel_ms / 1000.0 )
+             << " MB/s  (x" << tiny_ms / parallel_ms << ")\n"
+             << "   results " << ( same_geometry( tiny_attrib, tiny_shapes, parallel_attrib, parallel_shapes )
+                                      ? "match"
+                                      : "DIFFER" )
+             << std::endl;
+}
+
+void benchmark_vertex_dedup(
+   const std::filesystem::path& path )
+{
+   tinyobj::attrib_t attrib;
+   std::vector<tinyobj::shape_t> shapes;
+   load_obj_parallel( path, attrib, shapes );
+
+   auto obj_indices = flatten_indices( shapes );
+   double million_indices = static_cast<double>( obj_indices.size() ) / 1'000'000.0;
+
+   std::vector<Vertex> map_vertices;
+   std::vector<uint32_t> map_indices;
+   double map_collision_rate = 0.0;
+   double map_ms = time_best_of(
+      [&]()
+      {
+         map_vertices.clear();
+         map_indices.clear();
+         std::unordered_map<Vertex, uint32_t> unique_vertices{};
+
+         for ( const auto& index : obj_indices )
+         {
+            Vertex vertex = make_vertex( attrib, index );
+            if ( unique_vertices.count( vertex ) == 0 )
+            {
+               unique_vertices[vertex] = static_cast<uint32_t>( map_vertices.size() );
+               map_vertices.push_back( vertex );
+            }
+            map_indices.push_back( unique_vertices[vertex] );
+         }
+
+         // Share of keys that live in a bucket with at least one other key
+         size_t shared = 0;
+         for ( size_t bucket = 0;
+               bucket < unique_vertices.bucket_count();
+               ++bucket )
+         {
+            size_t bucket_size = unique_vertices.bucket_size( bucket );
+            shared += bucket_size > 1 ? bucket_size : 0;
+         }
+         map_collision_rate = static_cast<double>( shared ) / static_cast<double>( unique_vertices.size() );
+      } );
+
+   std::vector<Vertex> flat_vertices;
+   std::vector<uint32_t> flat_indices;
+   double flat_collision_rate = 0.0;
+   double flat_ms = time_best_of(
+      [&]()
+      {
+         flat_vertices.clear();
+         flat_indices.clear();
+         flat_indices.reserve( obj_indices.size() );
+         vertex_dedup_t unique_vertices( flat_vertices, obj_indices.size() );
+
+         for ( const auto& index : obj_indices )
+         {
+            flat_indices.push_back( unique_vertices.insert( make_vertex( attrib, index ) ) );
+         }
+
+         flat_collision_rate =
+            static_cast<double>( unique_vertices.collision_count() ) /
+            static_cast<double>( unique_vertices.lookup_count() );
+      } );
+
+   std::vector<Vertex> sharded_vertices;
+   std::vector<uint32_t> sharded_indices;
+   double sharded_ms =
+      time_best_of( [&]() { deduplicate_vertices( attrib, shapes, sharded_vertices, sharded_indices ); } );
+
+   bool sharded_matches =
+      sharded_indices == flat_indices && sharded_vertices.size() == flat_vertices.size() &&
+      std::memcmp( sharded_vertices.data(), flat_vertices.data(), flat_vertices.size() * sizeof( Vertex ) ) == 0;
+
+   std::cout << path.filename().string() << " vertex dedup (" << obj_indices.size() << " indices, "
+             << flat_vertices.size() << " unique)\n"
+             << "   std::unordered_map  " << map_ms << " ms  " << million_indices / ( map_ms / 1000.0 )
+             << " M indices/s  shared buckets " << map_collision_rate * 100.0 << "%\n"
+             << "   vertex_dedup_t      " << flat_ms << " ms  " << million_indices / ( flat_ms / 1000.0 )
+             << " M indices/s  extra probes per lookup " << flat_collision_rate << "  (x" << map_ms / flat_ms
+             << ")\n"
+             << "   deduplicate_vertices " << sharded_ms << " ms  " << million_indices / ( sharded_ms / 1000.0 )
+             << " M indices/s  (x" << map_ms / sharded_ms << ")\n"
+             << "   results " << ( map_indices == flat_indices && sharded_matches ? "match" : "DIFFER" )
+             << std::endl;
+}
+}   // namespace
+
+int main(
+   int argc,
+   char* argv[] )
+{
+   try
+   {
+      std::filesystem::path model_path = argc > 1 ? argv[1] : "models/viking_room.obj";
+      size_t synthetic_triangles = argc > 2 ? std::strtoull( argv[2], nullptr, 10 ) : 4'000'000;
+
+      auto synthetic_path = std::filesystem::temp_directory_path() / "ngg_synthetic_grid.obj";
+      write_synthetic_obj( synthetic_path, synthetic_triangles );
+
+      benchmark_obj_parsers( model_path );
+      benchmark_obj_parsers( synthetic_path );
+
+      benchmark_vertex_dedup( model_path );
+      benchmark_vertex_dedup( synthetic_path );
+
+      std::filesystem::remove( synthetic_path );
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
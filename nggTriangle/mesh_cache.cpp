@@ -0,0 +1,263 @@
+#include "mesh_cache.h"
+#include "hash_utils.h"
+#include "index_stream.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace
+{
+constexpr std::array<char, 8> cache_magic{ 'N', 'G', 'G', 'M', 'E', 'S', 'H', '\0' };
+constexpr uint64_t payload_alignment = 16;
+
+struct mesh_cache_header_t
+{
+   std::array<char, 8> magic;
+   uint32_t version;
+   uint32_t vertex_stride;
+   uint64_t source_size;
+   int64_t source_mtime;
+   uint64_t source_hash;
+   uint64_t import_key;
+   uint64_t vertex_count;
+   uint64_t index_count;
+   uint64_t vertex_offset;
+   uint64_t index_offset;
+   uint64_t index_stream_size;
+   uint64_t lod_count;
+   uint64_t lod_offset;
+   mesh_bounds_t bounds;
+};
+
+static_assert( std::is_trivially_copyable_v<mesh_cache_header_t> );
+static_assert( std::is_trivially_copyable_v<Vertex> );
+static_assert( std::is_trivially_copyable_v<mesh_lod_t> );
+
+auto align_up(
+   uint64_t value,
+   uint64_t alignment )
+   -> uint64_t
+{
+   return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+auto source_mtime(
+   const std::filesystem::path& source_path )
+   -> int64_t
+{
+   return static_cast<int64_t>( std::filesystem::last_write_time( source_path ).time_since_epoch().count() );
+}
+
+auto hash_source(
+   const std::filesystem::path& source_path )
+   -> uint64_t
+{
+   mapped_file_t source( source_path );
+   return hash_utils::hash_bytes( source.data() );
+}
+
+// Records a touched but unchanged source's new mtime, so later opens take the fast path
+// again instead of hashing it every time. A cache that cannot be written is left as is.
+void refresh_source_mtime(
+   const std::filesystem::path& cache_path,
+   int64_t mtime )
+{
+   std::fstream file( cache_path, std::ios::binary | std::ios::in | std::ios::out );
+   file.seekp( offsetof( mesh_cache_header_t, source_mtime ) );
+   file.write( reinterpret_cast<const char*>( &mtime ), sizeof( mtime ) );
+}
+}   // namespace
+
+auto mesh_cache_t::open(
+   const std::filesystem::path& cache_path,
+   const std::filesystem::path& source_path,
+   uint64_t import_key )
+   -> std::optional<mesh_cache_t>
+{
+   std::error_code error;
+   if ( !std::filesystem::exists( cache_path, error ) || !std::filesystem::exists( source_path, error ) )
+   {
+      return std::nullopt;
+   }
+
+   mesh_cache_header_t header;
+   {
+      std::ifstream in( cache_path, std::ios::binary );
+      if ( !in.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) )
+      {
+         return std::nullopt;
+      }
+   }
+
+   // Another version's stamp may not sit where this one's does
+   if ( header.magic != cache_magic || header.version != version )
+   {
+      return std::nullopt;
+   }
+
+   // Size and mtime are the fast path, the content hash catches touched but unchanged sources
+   auto size = std::filesystem::file_size( source_path );
+   if ( header.source_size != size )
+   {
+      return std::nullopt;
+   }
+
+   auto mtime = source_mtime( source_path );
+   if ( header.source_mtime != mtime )
+   {
+      if ( header.source_hash != hash_source( source_path ) )
+      {
+         return std::nullopt;
+      }
+
+      // Restamp before mapping, the mapping keeps others from writing on Windows
+      refresh_source_mtime( cache_path, mtime );
+   }
+
+   mapped_file_t file( cache_path );
+
+   auto bytes = file.data();
+
+   // Moving the mapping keeps its address, so the views stay valid
+   auto cache = open( bytes, import_key );
+   if ( cache.has_value() )
+   {
+      cache->file = std::move( file );
+   }
+
+   return cache;
+}
+
+auto mesh_cache_t::open(
+   std::span<const std::byte> bytes,
+   uint64_t import_key )
+   -> std::optional<mesh_cache_t>
+{
+   if ( bytes.size() < sizeof( mesh_cache_header_t ) )
+   {
+      return std::nullopt;
+   }
+
+   mesh_cache_header_t header;
+   std::memcpy( &header, bytes.data(), sizeof( header ) );
+
+   if ( header.magic != cache_magic || header.version != version || header.vertex_stride != sizeof( Vertex ) ||
+        header.import_key != import_key )
+   {
+      return std::nullopt;
+   }
+
+   if ( header.vertex_offset + header.vertex_count * sizeof( Vertex ) > bytes.size() ||
+        header.index_offset + header.index_stream_size > bytes.size() ||
+        header.index_count > header.index_stream_size ||
+        header.lod_offset + header.lod_count * sizeof( mesh_lod_t ) > bytes.size() )
+   {
+      return std::nullopt;
+   }
+
+   mesh_cache_t cache;
+
+   cache.vertex_view = {
+      reinterpret_cast<const Vertex*>( bytes.data() + header.vertex_offset ),
+      static_cast<size_t>( header.vertex_count ) };
+
+   auto index_stream =
+      bytes.subspan( static_cast<size_t>( header.index_offset ), static_cast<size_t>( header.index_stream_size ) );
+
+   cache.index_data.resize( static_cast<size_t>( header.index_count ) );
+   if ( !decode_index_stream( index_stream, cache.index_data ) )
+   {
+      return std::nullopt;
+   }
+
+   cache.index_view = cache.index_data;
+
+   cache.lod_view = {
+      reinterpret_cast<const mesh_lod_t*>( bytes.data() + header.lod_offset ),
+      static_cast<size_t>( header.lod_count ) };
+
+   bool lods_valid = std::all_of(
+      cache.lod_view.begin(),
+      cache.lod_view.end(),
+      [&]( const mesh_lod_t& lod )
+      {
+         return uint64_t{ lod.first_index } + lod.index_count <= header.index_count;
+      } );
+
+   if ( cache.lod_view.empty() || !lods_valid )
+   {
+      return std::nullopt;
+   }
+   cache.mesh_bounds = header.bounds;
+
+   return cache;
+}
+
+void mesh_cache_t::write(
+   const std::filesystem::path& cache_path,
+   const std::filesystem::path& source_path,
+   uint64_t import_key,
+   std::span<const Vertex> vertices,
+   std::span<const uint32_t> indices,
+   std::span<const mesh_lod_t> lods,
+   const mesh_bounds_t& bounds )
+{
+   auto index_stream = encode_index_stream( indices );
+
+   mesh_cache_header_t header{};
+   header.magic = cache_magic;
+   header.version = version;
+   header.vertex_stride = sizeof( Vertex );
+   header.source_size = std::filesystem::file_size( source_path );
+   header.source_mtime = source_mtime( source_path );
+   header.source_hash = hash_source( source_path );
+   header.import_key = import_key;
+   header.vertex_count = vertices.size();
+   header.index_count = indices.size();
+   header.vertex_offset = align_up( sizeof( header ), payload_alignment );
+   header.index_offset = align_up( header.vertex_offset + vertices.size_bytes(), payload_alignment );
+   header.index_stream_size = index_stream.size();
+   header.lod_count = lods.size();
+   header.lod_offset = align_up( header.index_offset + index_stream.size(), payload_alignment );
+   header.bounds = bounds;
+
+   // Write to a temporary file first so a crash never leaves a truncated cache behind
+   auto temp_path = cache_path;
+   temp_path += ".tmp";
+
+   {
+      std::ofstream out( temp_path, std::ios::binary | std::ios::trunc );
+      if ( !out.is_open() )
+      {
+         throw std::runtime_error( "failed to create mesh cache!" );
+      }
+
+      std::array<char, payload_alignment> padding{};
+
+      auto write_bytes =
+         [&]( const void* data, uint64_t size )
+         {
+            out.write( static_cast<const char*>( data ), static_cast<std::streamsize>( size ) );
+         };
+
+      write_bytes( &header, sizeof( header ) );
+      write_bytes( padding.data(), header.vertex_offset - sizeof( header ) );
+      write_bytes( vertices.data(), vertices.size_bytes() );
+      write_bytes( padding.data(), header.index_offset - ( header.vertex_offset + vertices.size_bytes() ) );
+      write_bytes( index_stream.data(), index_stream.size() );
+      write_bytes( padding.data(), header.lod_offset - ( header.index_offset + index_stream.size() ) );
+      write_bytes( lods.data(), lods.size_bytes() );
+
+      if ( !out.good() )
+      {
+         throw std::runtime_error( "failed to write mesh cache!" );
+      }
+   }
+
+   std::filesystem::rename( temp_path, cache_path );
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "mesh_types.h"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Binary cache of an imported mesh: the final deduplicated vertex and index arrays plus
+// bounds and the LOD table. A valid cache is memory-mapped and the vertices are read in
+// place; the index stream is delta/varint coded and decoded on open.
+class mesh_cache_t
+{
+public:
+   static constexpr uint32_t version = 4;
+
+   // Returns the cache if it exists and still matches the source file and import settings.
+   static
+   auto open(
+      const std::filesystem::path& cache_path,
+      const std::filesystem::path& source_path,
+      uint64_t import_key )
+      -> std::optional<mesh_cache_t>;
+
+   // Reads a cache held in memory that outlives it, e.g. an asset archive entry. There
+   // is no source to check, only the import settings.
+   static
+   auto open(
+      std::span<const std::byte> bytes,
+      uint64_t import_key )
+      -> std::optional<mesh_cache_t>;
+
+   static
+   void write(
+      const std::filesystem::path& cache_path,
+      const std::filesystem::path& source_path,
+      uint64_t import_key,
+      std::span<const Vertex> vertices,
+      std::span<const uint32_t> indices,
+      std::span<const mesh_lod_t> lods,
+      const mesh_bounds_t& bounds );
+
+   auto vertices() const
+      -> std::span<const Vertex>
+   {
+      return vertex_view;
+   }
+
+   auto indices() const
+      -> std::span<const uint32_t>
+   {
+      return index_view;
+   }
+
+   auto lods() const
+      -> std::span<const mesh_lod_t>
+   {
+      return lod_view;
+   }
+
+   auto bounds() const
+      -> const mesh_bounds_t&
+   {
+      return mesh_bounds;
+   }
+
+private:
+   mesh_cache_t() = default;
+
+   mapped_file_t file;
+   std::span<const Vertex> vertex_view;
+   std::vector<uint32_t> index_data;
+   std::span<const uint32_t> index_view;
+   std::span<const mesh_lod_t> lod_view;
+   mesh_bounds_t mesh_bounds{};
+};
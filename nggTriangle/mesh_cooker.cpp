@@ -0,0 +1,95 @@
+#include "mesh_cooker.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+#include "vertex_dedup.h"
+
+#include <limits>
+
+auto cook_mesh(
+   std::span<const std::byte> obj_text,
+   const mesh_import_options_t& options,
+   std::ostream& log )
+   -> cooked_mesh_t
+{
+   tinyobj::attrib_t attrib;
+   std::vector<tinyobj::shape_t> shapes;
+
+   load_obj_parallel( obj_text, attrib, shapes );
+
+   cooked_mesh_t mesh;
+   auto& vertices = mesh.vertices;
+   auto& indices = mesh.indices;
+
+   deduplicate_vertices( attrib, shapes, vertices, indices );
+
+   auto cache_stats = analyze_vertex_cache( indices, vertices.size() );
+   log << "vertex cache: ACMR " << cache_stats.acmr << ", ATVR " << cache_stats.atvr;
+
+   if ( options.optimize_vertex_cache )
+   {
+      optimize_vertex_cache( indices, vertices.size() );
+
+      cache_stats = analyze_vertex_cache( indices, vertices.size() );
+      log << " -> optimised ACMR " << cache_stats.acmr << ", ATVR " << cache_stats.atvr;
+   }
+   log << "\n";
+
+   auto overdraw_stats = analyze_overdraw( indices, vertices );
+   log << "overdraw: " << overdraw_stats.overdraw;
+
+   if ( options.optimize_overdraw )
+   {
+      optimize_overdraw( indices, vertices, options.overdraw_threshold );
+
+      overdraw_stats = analyze_overdraw( indices, vertices );
+      cache_stats = analyze_vertex_cache( indices, vertices.size() );
+      log << " -> optimised " << overdraw_stats.overdraw << " at ACMR " << cache_stats.acmr;
+   }
+   log << "\n";
+
+   // Index passes above scatter the fetches, so the vertex order is fixed up last
+   auto fetch_stats = analyze_vertex_fetch( indices, vertices.size(), sizeof( Vertex ) );
+   log << "vertex fetch: " << fetch_stats.bytes_per_triangle << " bytes/triangle";
+
+   if ( options.optimize_vertex_fetch )
+   {
+      optimize_vertex_fetch( indices, vertices );
+
+      fetch_stats = analyze_vertex_fetch( indices, vertices.size(), sizeof( Vertex ) );
+      log << " -> optimised " << fetch_stats.bytes_per_triangle << " bytes/triangle";
+   }
+   log << ", overfetch " << fetch_stats.overfetch << "\n";
+
+   // LODs reference the same vertices, so they are built once the vertex order is final
+   if ( options.generate_lods )
+   {
+      mesh.lods = build_lod_chain( indices, vertices );
+   }
+   else
+   {
+      mesh.lods = { {
+         .first_index = 0,
+         .index_count = static_cast<uint32_t>( indices.size() ),
+         .error = 0.0f } };
+   }
+
+   log << "LODs:";
+   for ( const auto& lod : mesh.lods )
+   {
+      log << " " << lod.index_count / 3 << " (error " << lod.error << ")";
+   }
+   log << "\n";
+
+   mesh.bounds = {
+      .min = glm::vec3( std::numeric_limits<float>::max() ),
+      .max = glm::vec3( std::numeric_limits<float>::lowest() ) };
+
+   for ( const auto& vertex : vertices )
+   {
+      mesh.bounds.min = glm::min( mesh.bounds.min, vertex.pos );
+      mesh.bounds.max = glm::max( mesh.bounds.max, vertex.pos );
+   }
+
+   return mesh;
+}
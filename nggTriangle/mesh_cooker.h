@@ -0,0 +1,27 @@
+#pragma once
+
+#include "mesh_import.h"
+#include "mesh_types.h"
+
+#include <cstddef>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// An imported mesh as the mesh cache stores it
+struct cooked_mesh_t
+{
+   std::vector<Vertex> vertices;
+   std::vector<uint32_t> indices;
+   std::vector<mesh_lod_t> lods;
+   mesh_bounds_t bounds{};
+};
+
+// Parses OBJ text and runs the import pipeline the options ask for: vertex
+// deduplication, vertex cache, overdraw and vertex fetch optimisation, then the LOD
+// chain. Before and after figures of every pass are written to log.
+auto cook_mesh(
+   std::span<const std::byte> obj_text,
+   const mesh_import_options_t& options,
+   std::ostream& log )
+   -> cooked_mesh_t;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "hash_utils.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// Settings for the import-time mesh processing in load_model(). Everything that
+// changes the imported arrays must be part of key() so stale caches are rejected.
+struct mesh_import_options_t
+{
+   bool optimize_vertex_cache{ true };
+   bool optimize_overdraw{ true };
+   // Allowed ACMR growth per cluster when reordering for overdraw, see optimize_overdraw()
+   float overdraw_threshold{ 1.05f };
+   bool optimize_vertex_fetch{ true };
+   bool generate_lods{ true };
+   // Upload vertices in the packed layout when the mesh and shaders allow it. Not part
+   // of key(): the cache always holds full vertices and packing happens after loading.
+   bool packed_vertices{ true };
+   // Cull meshlets on the GPU before drawing. Not part of key(), meshlets are built
+   // from the loaded index buffer.
+   bool meshlet_culling{ true };
+   // Start drawing while the model is still loading instead of waiting for it
+   bool async_loading{ true };
+
+   auto key() const
+      -> uint64_t
+   {
+      std::array<uint64_t, 5> fields{
+         optimize_vertex_cache ? 1u : 0u,
+         optimize_overdraw ? 1u : 0u,
+         std::bit_cast<uint32_t>( overdraw_threshold ),
+         optimize_vertex_fetch ? 1u : 0u,
+         generate_lods ? 1u : 0u };
+
+      return hash_utils::hash_bytes( fields.data(), sizeof( fields ) );
+   }
+};
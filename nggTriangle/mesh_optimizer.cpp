@@ -0,0 +1,715 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+// Parameters from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr uint32_t forsyth_cache_size = 32;
+constexpr float cache_decay_power = 1.5f;
+constexpr float last_triangle_score = 0.75f;
+constexpr float valence_boost_scale = 2.0f;
+constexpr float valence_boost_power = 0.5f;
+constexpr uint32_t valence_table_size = 64;
+
+struct forsyth_score_table_t
+{
+   std::array<float, forsyth_cache_size> cache;
+   std::array<float, valence_table_size> valence;
+
+   forsyth_score_table_t()
+   {
+      for ( uint32_t position = 0;
+            position < forsyth_cache_size;
+            ++position )
+      {
+         if ( position < 3 )
+         {
+            // The last triangle's vertices get a fixed score so it isn't picked again straight away
+            cache[position] = last_triangle_score;
+         }
+         else
+         {
+            float scaler = 1.0f / static_cast<float>( forsyth_cache_size - 3 );
+            cache[position] = std::pow( 1.0f - static_cast<float>( position - 3 ) * scaler, cache_decay_power );
+         }
+      }
+
+      valence[0] = 0.0f;
+      for ( uint32_t remaining = 1;
+            remaining < valence_table_size;
+            ++remaining )
+      {
+         valence[remaining] =
+            valence_boost_scale * std::pow( static_cast<float>( remaining ), -valence_boost_power );
+      }
+   }
+
+   auto score(
+      int32_t cache_position,
+      uint32_t remaining ) const
+      -> float
+   {
+      if ( remaining == 0 )
+      {
+         return -1.0f;
+      }
+
+      float result = cache_position >= 0 ? cache[cache_position] : 0.0f;
+
+      result +=
+         remaining < valence_table_size
+            ? valence[remaining]
+            : valence_boost_scale * std::pow( static_cast<float>( remaining ), -valence_boost_power );
+
+      return result;
+   }
+};
+
+// FIFO post-transform cache: a vertex is still cached while fewer than size misses
+// happened since it was loaded
+class fifo_cache_t
+{
+public:
+   fifo_cache_t(
+      size_t vertex_count,
+      uint32_t cache_size )
+      : loaded_at( vertex_count, 0 )
+      , clock( uint64_t{ cache_size } + 1 )
+      , size( cache_size )
+   {
+   }
+
+   auto access(
+      uint32_t vertex )
+      -> uint32_t
+   {
+      if ( clock - loaded_at[vertex] > size )
+      {
+         loaded_at[vertex] = clock++;
+         return 1;
+      }
+
+      return 0;
+   }
+
+   auto access_triangle(
+      const uint32_t* triangle )
+      -> uint32_t
+   {
+      return access( triangle[0] ) + access( triangle[1] ) + access( triangle[2] );
+   }
+
+   void flush()
+   {
+      clock += uint64_t{ size } + 1;
+   }
+
+private:
+   std::vector<uint64_t> loaded_at;
+   uint64_t clock;
+   uint32_t size;
+};
+
+constexpr uint32_t overdraw_cache_size = 16;
+constexpr size_t fetch_cache_line = 64;
+constexpr uint32_t fetch_cache_lines = 16 * 1024 / fetch_cache_line;
+constexpr int overdraw_viewport = 256;
+
+// Triangles where every vertex misses the cache start a new, disconnected patch
+auto find_patch_starts(
+   std::span<const uint32_t> indices,
+   size_t vertex_count )
+   -> std::vector<size_t>
+{
+   fifo_cache_t cache( vertex_count, overdraw_cache_size );
+   std::vector<size_t> starts;
+
+   for ( size_t triangle = 0;
+         triangle < indices.size() / 3;
+         ++triangle )
+   {
+      if ( cache.access_triangle( &indices[triangle * 3] ) == 3 || triangle == 0 )
+      {
+         starts.push_back( triangle );
+      }
+   }
+
+   return starts;
+}
+
+// Cuts each patch into clusters that end as soon as their ACMR is within threshold of the patch
+auto find_cluster_starts(
+   std::span<const uint32_t> indices,
+   size_t vertex_count,
+   const std::vector<size_t>& patch_starts,
+   float threshold )
+   -> std::vector<size_t>
+{
+   size_t triangle_count = indices.size() / 3;
+   fifo_cache_t cache( vertex_count, overdraw_cache_size );
+   std::vector<size_t> starts;
+
+   for ( size_t patch = 0;
+         patch < patch_starts.size();
+         ++patch )
+   {
+      size_t begin = patch_starts[patch];
+      size_t end = patch + 1 < patch_starts.size() ? patch_starts[patch + 1] : triangle_count;
+
+      cache.flush();
+      uint32_t patch_misses = 0;
+      for ( size_t triangle = begin;
+            triangle < end;
+            ++triangle )
+      {
+         patch_misses += cache.access_triangle( &indices[triangle * 3] );
+      }
+
+      float target_acmr = threshold * static_cast<float>( patch_misses ) / static_cast<float>( end - begin );
+
+      size_t patch_first_cluster = starts.size();
+      starts.push_back( begin );
+
+      cache.flush();
+      uint32_t misses = 0;
+      uint32_t triangles = 0;
+      for ( size_t triangle = begin;
+            triangle < end;
+            ++triangle )
+      {
+         misses += cache.access_triangle( &indices[triangle * 3] );
+         ++triangles;
+
+         if ( static_cast<float>( misses ) <= target_acmr * static_cast<float>( triangles ) && triangle + 1 < end )
+         {
+            starts.push_back( triangle + 1 );
+            cache.flush();
+            misses = 0;
+            triangles = 0;
+         }
+      }
+
+      // The tail never reached the target, so it goes back into the previous cluster
+      if ( triangles > 0 && starts.size() > patch_first_cluster + 1 )
+      {
+         starts.pop_back();
+      }
+   }
+
+   return starts;
+}
+
+// Depth-tested software rasteriser used to measure overdraw from one view
+class overdraw_rasterizer_t
+{
+public:
+   overdraw_rasterizer_t()
+      : depth( overdraw_viewport * overdraw_viewport )
+   {
+   }
+
+   void clear()
+   {
+      std::fill( depth.begin(), depth.end(), std::numeric_limits<float>::max() );
+   }
+
+   // Screen positions are in pixels; z is depth with smaller values closer to the viewer
+   void draw(
+      glm::vec3 a,
+      glm::vec3 b,
+      glm::vec3 c )
+   {
+      float area = ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x );
+      if ( area == 0.0f )
+      {
+         return;
+      }
+
+      int min_x = std::max( static_cast<int>( std::floor( std::min( { a.x, b.x, c.x } ) ) ), 0 );
+      int min_y = std::max( static_cast<int>( std::floor( std::min( { a.y, b.y, c.y } ) ) ), 0 );
+      int max_x = std::min( static_cast<int>( std::ceil( std::max( { a.x, b.x, c.x } ) ) ), overdraw_viewport - 1 );
+      int max_y = std::min( static_cast<int>( std::ceil( std::max( { a.y, b.y, c.y } ) ) ), overdraw_viewport - 1 );
+
+      float inv_area = 1.0f / area;
+
+      for ( int y = min_y;
+            y <= max_y;
+            ++y )
+      {
+         for ( int x = min_x;
+               x <= max_x;
+               ++x )
+         {
+            float px = static_cast<float>( x ) + 0.5f;
+            float py = static_cast<float>( y ) + 0.5f;
+
+            // Barycentrics are positive inside either winding once divided by the area
+            float wa = ( ( b.x - px ) * ( c.y - py ) - ( b.y - py ) * ( c.x - px ) ) * inv_area;
+            float wb = ( ( c.x - px ) * ( a.y - py ) - ( c.y - py ) * ( a.x - px ) ) * inv_area;
+            float wc = 1.0f - wa - wb;
+
+            if ( wa < 0.0f || wb < 0.0f || wc < 0.0f )
+            {
+               continue;
+            }
+
+            float z = wa * a.z + wb * b.z + wc * c.z;
+            float& stored = depth[static_cast<size_t>( y ) * overdraw_viewport + static_cast<size_t>( x )];
+
+            if ( z < stored )
+            {
+               stored = z;
+               ++shaded;
+            }
+         }
+      }
+   }
+
+   auto covered() const
+      -> uint64_t
+   {
+      return static_cast<uint64_t>( std::count_if(
+         depth.begin(),
+         depth.end(),
+         []( float z )
+         {
+            return z != std::numeric_limits<float>::max();
+         } ) );
+   }
+
+   uint64_t shaded{ 0 };
+
+private:
+   std::vector<float> depth;
+};
+}   // namespace
+
+auto analyze_vertex_cache(
+   std::span<const uint32_t> indices,
+   size_t vertex_count,
+   uint32_t cache_size )
+   -> vertex_cache_stats_t
+{
+   if ( indices.empty() || vertex_count == 0 )
+   {
+      return {};
+   }
+
+   fifo_cache_t cache( vertex_count, cache_size );
+   uint64_t misses = 0;
+
+   for ( uint32_t index : indices )
+   {
+      misses += cache.access( index );
+   }
+
+   return {
+      .acmr = static_cast<double>( misses ) / static_cast<double>( indices.size() / 3 ),
+      .atvr = static_cast<double>( misses ) / static_cast<double>( vertex_count ) };
+}
+
+void optimize_vertex_cache(
+   std::span<uint32_t> indices,
+   size_t vertex_count )
+{
+   size_t triangle_count = indices.size() / 3;
+   if ( triangle_count == 0 )
+   {
+      return;
+   }
+
+   static const forsyth_score_table_t score_table;
+
+   // Live triangles per vertex; emitted triangles are swapped out of each list
+   std::vector<uint32_t> remaining( vertex_count, 0 );
+   for ( uint32_t index : indices )
+   {
+      ++remaining[index];
+   }
+
+   std::vector<uint32_t> adjacency_offset( vertex_count + 1, 0 );
+   for ( size_t vertex = 0;
+         vertex < vertex_count;
+         ++vertex )
+   {
+      adjacency_offset[vertex + 1] = adjacency_offset[vertex] + remaining[vertex];
+   }
+
+   std::vector<uint32_t> adjacency( indices.size() );
+   {
+      std::vector<uint32_t> fill( adjacency_offset.begin(), adjacency_offset.end() - 1 );
+      for ( size_t corner = 0;
+            corner < indices.size();
+            ++corner )
+      {
+         adjacency[fill[indices[corner]]++] = static_cast<uint32_t>( corner / 3 );
+      }
+   }
+
+   std::vector<int32_t> cache_position( vertex_count, -1 );
+   std::vector<float> vertex_score( vertex_count );
+   for ( size_t vertex = 0;
+         vertex < vertex_count;
+         ++vertex )
+   {
+      vertex_score[vertex] = score_table.score( -1, remaining[vertex] );
+   }
+
+   auto triangle_score =
+      [&]( size_t triangle )
+      {
+         return vertex_score[indices[triangle * 3 + 0]] + vertex_score[indices[triangle * 3 + 1]] +
+                vertex_score[indices[triangle * 3 + 2]];
+      };
+
+   std::vector<uint8_t> emitted( triangle_count, 0 );
+   std::vector<uint32_t> output( indices.size() );
+
+   std::array<uint32_t, forsyth_cache_size + 3> cache{};
+   std::array<uint32_t, forsyth_cache_size + 3> next_cache{};
+   size_t cache_count = 0;
+
+   // With no cached vertices every triangle scores on valence alone
+   size_t best_triangle = 0;
+   float best_score = -1.0f;
+   for ( size_t triangle = 0;
+         triangle < triangle_count;
+         ++triangle )
+   {
+      if ( float score = triangle_score( triangle ); score > best_score )
+      {
+         best_score = score;
+         best_triangle = triangle;
+      }
+   }
+
+   size_t input_cursor = 0;
+
+   for ( size_t output_triangle = 0;
+         output_triangle < triangle_count;
+         ++output_triangle )
+   {
+      if ( best_score < 0.0f )
+      {
+         // Dead end: nothing in the cache has live triangles left, continue in input order
+         while ( emitted[input_cursor] )
+         {
+            ++input_cursor;
+         }
+         best_triangle = input_cursor;
+      }
+
+      size_t triangle = best_triangle;
+      emitted[triangle] = 1;
+
+      std::array<uint32_t, 3> corners{
+         indices[triangle * 3 + 0],
+         indices[triangle * 3 + 1],
+         indices[triangle * 3 + 2] };
+
+      for ( size_t corner = 0;
+            corner < 3;
+            ++corner )
+      {
+         output[output_triangle * 3 + corner] = corners[corner];
+
+         uint32_t vertex = corners[corner];
+         uint32_t* live = adjacency.data() + adjacency_offset[vertex];
+         for ( uint32_t i = 0;
+               i < remaining[vertex];
+               ++i )
+         {
+            if ( live[i] == triangle )
+            {
+               live[i] = live[remaining[vertex] - 1];
+               --remaining[vertex];
+               break;
+            }
+         }
+      }
+
+      // Emitted vertices move to the front of the LRU cache
+      size_t next_count = 0;
+      for ( uint32_t vertex : corners )
+      {
+         if ( next_count == 0 || ( next_cache[0] != vertex && ( next_count < 2 || next_cache[1] != vertex ) ) )
+         {
+            next_cache[next_count++] = vertex;
+         }
+      }
+      for ( size_t i = 0;
+            i < cache_count;
+            ++i )
+      {
+         uint32_t vertex = cache[i];
+         if ( vertex != corners[0] && vertex != corners[1] && vertex != corners[2] )
+         {
+            next_cache[next_count++] = vertex;
+         }
+      }
+
+      for ( size_t i = 0;
+            i < next_count;
+            ++i )
+      {
+         uint32_t vertex = next_cache[i];
+         cache_position[vertex] = i < forsyth_cache_size ? static_cast<int32_t>( i ) : -1;
+         vertex_score[vertex] = score_table.score( cache_position[vertex], remaining[vertex] );
+      }
+
+      cache_count = std::min<size_t>( next_count, forsyth_cache_size );
+      std::copy( next_cache.begin(), next_cache.begin() + cache_count, cache.begin() );
+
+      // Only triangles touching the cache changed score enough to matter
+      best_score = -1.0f;
+      for ( size_t i = 0;
+            i < cache_count;
+            ++i )
+      {
+         uint32_t vertex = cache[i];
+         const uint32_t* live = adjacency.data() + adjacency_offset[vertex];
+
+         for ( uint32_t j = 0;
+               j < remaining[vertex];
+               ++j )
+         {
+            if ( float score = triangle_score( live[j] ); score > best_score )
+            {
+               best_score = score;
+               best_triangle = live[j];
+            }
+         }
+      }
+   }
+
+   std::copy( output.begin(), output.end(), indices.begin() );
+}
+
+auto analyze_overdraw(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices )
+   -> overdraw_stats_t
+{
+   if ( indices.empty() || vertices.empty() )
+   {
+      return {};
+   }
+
+   glm::vec3 min_pos( std::numeric_limits<float>::max() );
+   glm::vec3 max_pos( std::numeric_limits<float>::lowest() );
+   for ( const auto& vertex : vertices )
+   {
+      min_pos = glm::min( min_pos, vertex.pos );
+      max_pos = glm::max( max_pos, vertex.pos );
+   }
+
+   // Uniform scale keeps the aspect ratio, so every view sees the mesh undistorted
+   glm::vec3 extent = max_pos - min_pos;
+   float largest = std::max( { extent.x, extent.y, extent.z } );
+   float scale = largest > 0.0f ? static_cast<float>( overdraw_viewport ) / largest : 0.0f;
+
+   overdraw_rasterizer_t rasterizer;
+   overdraw_stats_t stats{};
+
+   for ( int axis = 0;
+         axis < 3;
+         ++axis )
+   {
+      int u_axis = ( axis + 1 ) % 3;
+      int v_axis = ( axis + 2 ) % 3;
+
+      for ( float direction : { 1.0f, -1.0f } )
+      {
+         rasterizer.clear();
+         rasterizer.shaded = 0;
+
+         for ( size_t triangle = 0;
+               triangle < indices.size() / 3;
+               ++triangle )
+         {
+            const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].pos;
+
+            // The viewer looks along +direction on this axis; back faces are culled
+            glm::vec3 normal = glm::cross( p1 - p0, p2 - p0 );
+            if ( normal[axis] * direction >= 0.0f )
+            {
+               continue;
+            }
+
+            auto project =
+               [&]( const glm::vec3& p )
+               {
+                  glm::vec3 local = ( p - min_pos ) * scale;
+                  return glm::vec3( local[u_axis], local[v_axis], local[axis] * direction );
+               };
+
+            rasterizer.draw( project( p0 ), project( p1 ), project( p2 ) );
+         }
+
+         stats.pixels_covered += rasterizer.covered();
+         stats.pixels_shaded += rasterizer.shaded;
+      }
+   }
+
+   stats.overdraw =
+      stats.pixels_covered > 0
+         ? static_cast<double>( stats.pixels_shaded ) / static_cast<double>( stats.pixels_covered )
+         : 0.0;
+
+   return stats;
+}
+
+void optimize_overdraw(
+   std::span<uint32_t> indices,
+   std::span<const Vertex> vertices,
+   float threshold )
+{
+   size_t triangle_count = indices.size() / 3;
+   if ( triangle_count == 0 )
+   {
+      return;
+   }
+
+   auto patch_starts = find_patch_starts( indices, vertices.size() );
+   auto cluster_starts = find_cluster_starts( indices, vertices.size(), patch_starts, threshold );
+
+   glm::vec3 mesh_centroid( 0.0f );
+   for ( const auto& vertex : vertices )
+   {
+      mesh_centroid += vertex.pos;
+   }
+   mesh_centroid /= static_cast<float>( vertices.size() );
+
+   // Clusters far out along their own normal are likely to be in front of the rest
+   std::vector<float> sort_key( cluster_starts.size() );
+   for ( size_t cluster = 0;
+         cluster < cluster_starts.size();
+         ++cluster )
+   {
+      size_t begin = cluster_starts[cluster];
+      size_t end = cluster + 1 < cluster_starts.size() ? cluster_starts[cluster + 1] : triangle_count;
+
+      glm::vec3 centroid( 0.0f );
+      glm::vec3 normal( 0.0f );
+      float area = 0.0f;
+
+      for ( size_t triangle = begin;
+            triangle < end;
+            ++triangle )
+      {
+         const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].pos;
+         const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].pos;
+         const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].pos;
+
+         glm::vec3 triangle_normal = glm::cross( p1 - p0, p2 - p0 );
+         float triangle_area = glm::length( triangle_normal );
+
+         centroid += ( p0 + p1 + p2 ) * ( triangle_area / 3.0f );
+         normal += triangle_normal;
+         area += triangle_area;
+      }
+
+      centroid = area > 0.0f ? centroid / area : centroid;
+      float normal_length = glm::length( normal );
+      normal = normal_length > 0.0f ? normal / normal_length : normal;
+
+      sort_key[cluster] = glm::dot( centroid - mesh_centroid, normal );
+   }
+
+   std::vector<size_t> order( cluster_starts.size() );
+   for ( size_t cluster = 0;
+         cluster < order.size();
+         ++cluster )
+   {
+      order[cluster] = cluster;
+   }
+
+   std::stable_sort(
+      order.begin(),
+      order.end(),
+      [&]( size_t a, size_t b )
+      {
+         return sort_key[a] > sort_key[b];
+      } );
+
+   std::vector<uint32_t> output;
+   output.reserve( indices.size() );
+
+   for ( size_t cluster : order )
+   {
+      size_t begin = cluster_starts[cluster];
+      size_t end = cluster + 1 < cluster_starts.size() ? cluster_starts[cluster + 1] : triangle_count;
+
+      output.insert( output.end(), indices.begin() + begin * 3, indices.begin() + end * 3 );
+   }
+
+   std::copy( output.begin(), output.end(), indices.begin() );
+}
+
+auto analyze_vertex_fetch(
+   std::span<const uint32_t> indices,
+   size_t vertex_count,
+   size_t vertex_size )
+   -> vertex_fetch_stats_t
+{
+   if ( indices.empty() || vertex_count == 0 || vertex_size == 0 )
+   {
+      return {};
+   }
+
+   size_t line_count = ( vertex_count * vertex_size + fetch_cache_line - 1 ) / fetch_cache_line;
+   fifo_cache_t cache( line_count, fetch_cache_lines );
+   uint64_t lines_fetched = 0;
+
+   for ( uint32_t index : indices )
+   {
+      // A vertex may straddle two cache lines
+      size_t first = index * vertex_size / fetch_cache_line;
+      size_t last = ( ( index + 1 ) * vertex_size - 1 ) / fetch_cache_line;
+
+      for ( size_t line = first;
+            line <= last;
+            ++line )
+      {
+         lines_fetched += cache.access( static_cast<uint32_t>( line ) );
+      }
+   }
+
+   vertex_fetch_stats_t stats{};
+   stats.bytes_fetched = lines_fetched * fetch_cache_line;
+   stats.bytes_per_triangle = static_cast<double>( stats.bytes_fetched ) / static_cast<double>( indices.size() / 3 );
+   stats.overfetch = static_cast<double>( stats.bytes_fetched ) / static_cast<double>( vertex_count * vertex_size );
+
+   return stats;
+}
+
+void optimize_vertex_fetch(
+   std::span<uint32_t> indices,
+   std::vector<Vertex>& vertices )
+{
+   constexpr uint32_t unused = UINT32_MAX;
+
+   std::vector<uint32_t> remap( vertices.size(), unused );
+   std::vector<Vertex> remapped;
+   remapped.reserve( vertices.size() );
+
+   for ( uint32_t& index : indices )
+   {
+      if ( remap[index] == unused )
+      {
+         remap[index] = static_cast<uint32_t>( remapped.size() );
+         remapped.push_back( vertices[index] );
+      }
+
+      index = remap[index];
+   }
+
+   vertices = std::move( remapped );
+}
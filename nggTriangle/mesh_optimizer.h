@@ -0,0 +1,78 @@
+#pragma once
+
+#include "mesh_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Index buffer optimisations run at import time, after vertex deduplication.
+
+struct vertex_cache_stats_t
+{
+   // Average cache miss ratio: transformed vertices per triangle, 0.5 at best, 3 at worst
+   double acmr{ 0.0 };
+   // Average transform to vertex ratio: transformed vertices per unique vertex, 1 at best
+   double atvr{ 0.0 };
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries over the triangle list.
+auto analyze_vertex_cache(
+   std::span<const uint32_t> indices,
+   size_t vertex_count,
+   uint32_t cache_size = 16 )
+   -> vertex_cache_stats_t;
+
+// Reorders the triangles in place for post-transform cache reuse using Tom Forsyth's
+// linear-speed algorithm. Triangles keep their winding.
+void optimize_vertex_cache(
+   std::span<uint32_t> indices,
+   size_t vertex_count );
+
+struct overdraw_stats_t
+{
+   uint64_t pixels_covered{ 0 };
+   uint64_t pixels_shaded{ 0 };
+   // Shaded fragments per covered pixel with a LESS depth test, 1 at best
+   double overdraw{ 0.0 };
+};
+
+// Rasterises the mesh in submission order from the six axis-aligned views with back
+// face culling and counts how many fragments pass the depth test per visible pixel.
+auto analyze_overdraw(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices )
+   -> overdraw_stats_t;
+
+// Splits a cache-optimised triangle list into clusters and draws clusters that face
+// outwards from the mesh centre first, so they tend to occlude the rest. A cluster ends
+// once its running ACMR drops to threshold times the ACMR of the surrounding patch, so
+// larger thresholds give smaller clusters, less overdraw and a higher ACMR.
+void optimize_overdraw(
+   std::span<uint32_t> indices,
+   std::span<const Vertex> vertices,
+   float threshold = 1.05f );
+
+struct vertex_fetch_stats_t
+{
+   uint64_t bytes_fetched{ 0 };
+   double bytes_per_triangle{ 0.0 };
+   // Bytes fetched relative to the size of the vertex buffer, 1 at best
+   double overfetch{ 0.0 };
+};
+
+// Estimates memory traffic for vertex fetch with a 16KB FIFO cache of 64 byte lines
+// over a vertex buffer of vertex_count elements of vertex_size bytes.
+auto analyze_vertex_fetch(
+   std::span<const uint32_t> indices,
+   size_t vertex_count,
+   size_t vertex_size )
+   -> vertex_fetch_stats_t;
+
+// Renumbers the vertices in the order the index buffer first uses them and rewrites the
+// indices to match, so fetches walk the vertex buffer front to back. Run it after every
+// pass that reorders indices. Unreferenced vertices are dropped.
+void optimize_vertex_fetch(
+   std::span<uint32_t> indices,
+   std::vector<Vertex>& vertices );
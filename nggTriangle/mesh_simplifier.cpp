@@ -0,0 +1,671 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+namespace
+{
+// Border edges are held in place by planes through the edge, weighted well above
+// the surface so that collapses never pull an open border inwards
+constexpr double border_weight = 10.0;
+
+// Symmetric 4x4 plane quadric, accumulated with area weights
+struct quadric_t
+{
+   double xx{ 0.0 };
+   double xy{ 0.0 };
+   double xz{ 0.0 };
+   double yy{ 0.0 };
+   double yz{ 0.0 };
+   double zz{ 0.0 };
+   double dx{ 0.0 };
+   double dy{ 0.0 };
+   double dz{ 0.0 };
+   double dd{ 0.0 };
+   double weight{ 0.0 };
+
+   void add_plane(
+      const glm::vec3& normal,
+      float distance,
+      double plane_weight )
+   {
+      double a = normal.x;
+      double b = normal.y;
+      double c = normal.z;
+      double d = distance;
+
+      xx += a * a * plane_weight;
+      xy += a * b * plane_weight;
+      xz += a * c * plane_weight;
+      yy += b * b * plane_weight;
+      yz += b * c * plane_weight;
+      zz += c * c * plane_weight;
+      dx += a * d * plane_weight;
+      dy += b * d * plane_weight;
+      dz += c * d * plane_weight;
+      dd += d * d * plane_weight;
+      weight += plane_weight;
+   }
+
+   void add(
+      const quadric_t& other )
+   {
+      xx += other.xx;
+      xy += other.xy;
+      xz += other.xz;
+      yy += other.yy;
+      yz += other.yz;
+      zz += other.zz;
+      dx += other.dx;
+      dy += other.dy;
+      dz += other.dz;
+      dd += other.dd;
+      weight += other.weight;
+   }
+
+   // Weighted mean squared distance of p to the accumulated planes
+   auto error(
+      const glm::vec3& p ) const
+      -> double
+   {
+      double x = p.x;
+      double y = p.y;
+      double z = p.z;
+
+      double sum = xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + yy * y * y + 2.0 * yz * y * z + zz * z * z +
+                   2.0 * ( dx * x + dy * y + dz * z ) + dd;
+
+      return weight > 0.0 ? std::max( sum, 0.0 ) / weight : 0.0;
+   }
+};
+
+struct collapse_t
+{
+   uint32_t source;
+   uint32_t target;
+   double error;
+};
+
+auto edge_key(
+   uint32_t a,
+   uint32_t b )
+   -> uint64_t
+{
+   return a < b ? ( uint64_t{ a } << 32 ) | b : ( uint64_t{ b } << 32 ) | a;
+}
+
+class simplifier_t
+{
+public:
+   simplifier_t(
+      std::span<const uint32_t> indices,
+      std::span<const Vertex> vertices )
+      : vertices( vertices )
+      , result( indices.begin(), indices.end() )
+      , position_of( vertices.size() )
+      , collapse_remap( vertices.size() )
+      , quadrics( vertices.size() )
+      , position_locked( vertices.size(), 0 )
+   {
+      build_positions();
+      update_topology();
+      build_quadrics();
+   }
+
+   auto run(
+      size_t target_index_count,
+      float target_error )
+      -> std::vector<uint32_t>
+   {
+      double error_limit = static_cast<double>( target_error ) * static_cast<double>( target_error );
+
+      while ( result.size() > target_index_count )
+      {
+         if ( !collapse_pass( target_index_count, error_limit ) )
+         {
+            break;
+         }
+
+         update_topology();
+      }
+
+      return std::move( result );
+   }
+
+   auto max_error() const
+      -> float
+   {
+      return static_cast<float>( std::sqrt( max_collapse_error ) );
+   }
+
+private:
+   std::span<const Vertex> vertices;
+   std::vector<uint32_t> result;
+
+   // Vertices that only differ in attributes (wedges) map to the first vertex at their position
+   std::vector<uint32_t> position_of;
+   std::vector<uint32_t> collapse_remap;
+   std::vector<quadric_t> quadrics;
+
+   // Per pass topology at position level
+   std::vector<uint32_t> triangle_offset;
+   std::vector<uint32_t> triangles;
+   std::vector<uint64_t> edges;
+   std::vector<uint32_t> edge_uses;
+   std::vector<uint8_t> position_border;
+   std::vector<uint8_t> position_locked;
+
+   double max_collapse_error{ 0.0 };
+
+   auto pos(
+      uint32_t vertex ) const
+      -> const glm::vec3&
+   {
+      return vertices[vertex].pos;
+   }
+
+   void build_positions()
+   {
+      std::vector<uint32_t> order( vertices.size() );
+      std::iota( order.begin(), order.end(), 0u );
+
+      std::sort(
+         order.begin(),
+         order.end(),
+         [&]( uint32_t a, uint32_t b )
+         {
+            return std::tie( pos( a ).x, pos( a ).y, pos( a ).z, a ) <
+                   std::tie( pos( b ).x, pos( b ).y, pos( b ).z, b );
+         } );
+
+      for ( size_t begin = 0, end = 0;
+            begin < order.size();
+            begin = end )
+      {
+         end = begin + 1;
+         while ( end < order.size() && pos( order[end] ) == pos( order[begin] ) )
+         {
+            ++end;
+         }
+
+         for ( size_t i = begin;
+               i < end;
+               ++i )
+         {
+            position_of[order[i]] = order[begin];
+         }
+      }
+   }
+
+   void update_topology()
+   {
+      size_t vertex_count = vertices.size();
+
+      triangle_offset.assign( vertex_count + 1, 0 );
+      for ( uint32_t index : result )
+      {
+         ++triangle_offset[position_of[index] + 1];
+      }
+      std::partial_sum( triangle_offset.begin(), triangle_offset.end(), triangle_offset.begin() );
+
+      triangles.resize( result.size() );
+      std::vector<uint32_t> fill( triangle_offset.begin(), triangle_offset.end() - 1 );
+      for ( size_t corner = 0;
+            corner < result.size();
+            ++corner )
+      {
+         triangles[fill[position_of[result[corner]]]++] = static_cast<uint32_t>( corner / 3 );
+      }
+
+      // Edges used by one triangle are open borders, more than two is non-manifold
+      std::vector<uint64_t> all_edges;
+      all_edges.reserve( result.size() );
+      for ( size_t triangle = 0;
+            triangle < result.size() / 3;
+            ++triangle )
+      {
+         for ( size_t corner = 0;
+               corner < 3;
+               ++corner )
+         {
+            all_edges.push_back(
+               edge_key(
+                  position_of[result[triangle * 3 + corner]],
+                  position_of[result[triangle * 3 + ( corner + 1 ) % 3]] ) );
+         }
+      }
+      std::sort( all_edges.begin(), all_edges.end() );
+
+      edges.clear();
+      edge_uses.clear();
+      for ( uint64_t edge : all_edges )
+      {
+         if ( edges.empty() || edges.back() != edge )
+         {
+            edges.push_back( edge );
+            edge_uses.push_back( 0 );
+         }
+         ++edge_uses.back();
+      }
+
+      position_border.assign( vertex_count, 0 );
+      for ( size_t i = 0;
+            i < edges.size();
+            ++i )
+      {
+         if ( edge_uses[i] == 2 )
+         {
+            continue;
+         }
+
+         auto a = static_cast<uint32_t>( edges[i] >> 32 );
+         auto b = static_cast<uint32_t>( edges[i] );
+
+         if ( edge_uses[i] == 1 )
+         {
+            position_border[a] = 1;
+            position_border[b] = 1;
+         }
+         else
+         {
+            position_locked[a] = 1;
+            position_locked[b] = 1;
+         }
+      }
+   }
+
+   auto edge_use_count(
+      uint32_t a,
+      uint32_t b ) const
+      -> uint32_t
+   {
+      auto key = edge_key( a, b );
+      auto it = std::lower_bound( edges.begin(), edges.end(), key );
+
+      return it != edges.end() && *it == key ? edge_uses[static_cast<size_t>( it - edges.begin() )] : 0;
+   }
+
+   void build_quadrics()
+   {
+      for ( size_t triangle = 0;
+            triangle < result.size() / 3;
+            ++triangle )
+      {
+         std::array<uint32_t, 3> corner_position{
+            position_of[result[triangle * 3 + 0]],
+            position_of[result[triangle * 3 + 1]],
+            position_of[result[triangle * 3 + 2]] };
+
+         const glm::vec3& p0 = pos( corner_position[0] );
+         const glm::vec3& p1 = pos( corner_position[1] );
+         const glm::vec3& p2 = pos( corner_position[2] );
+
+         glm::vec3 normal = glm::cross( p1 - p0, p2 - p0 );
+         float length = glm::length( normal );
+         if ( length == 0.0f )
+         {
+            continue;
+         }
+
+         normal /= length;
+         double area = 0.5 * static_cast<double>( length );
+
+         for ( uint32_t position : corner_position )
+         {
+            quadrics[position].add_plane( normal, -glm::dot( normal, p0 ), area );
+         }
+
+         for ( size_t corner = 0;
+               corner < 3;
+               ++corner )
+         {
+            uint32_t a = corner_position[corner];
+            uint32_t b = corner_position[( corner + 1 ) % 3];
+
+            if ( edge_use_count( a, b ) != 1 )
+            {
+               continue;
+            }
+
+            glm::vec3 edge = pos( b ) - pos( a );
+            glm::vec3 border_normal = glm::cross( edge, normal );
+            float border_length = glm::length( border_normal );
+            if ( border_length == 0.0f )
+            {
+               continue;
+            }
+
+            border_normal /= border_length;
+            double weight = static_cast<double>( glm::dot( edge, edge ) ) * border_weight;
+
+            quadrics[a].add_plane( border_normal, -glm::dot( border_normal, pos( a ) ), weight );
+            quadrics[b].add_plane( border_normal, -glm::dot( border_normal, pos( a ) ), weight );
+         }
+      }
+   }
+
+   // Maps every live wedge of source onto the wedge of target it shares a triangle with.
+   // Fails if a wedge has no such partner or more than one, i.e. the edge leaves a seam.
+   auto map_wedges(
+      uint32_t source,
+      uint32_t target,
+      std::vector<std::pair<uint32_t, uint32_t>>& mapping ) const
+      -> bool
+   {
+      mapping.clear();
+
+      for ( uint32_t i = triangle_offset[source];
+            i < triangle_offset[source + 1];
+            ++i )
+      {
+         const uint32_t* triangle = &result[triangles[i] * 3];
+
+         uint32_t source_wedge = UINT32_MAX;
+         uint32_t target_wedge = UINT32_MAX;
+         for ( size_t corner = 0;
+               corner < 3;
+               ++corner )
+         {
+            if ( position_of[triangle[corner]] == source )
+            {
+               source_wedge = triangle[corner];
+            }
+            else if ( position_of[triangle[corner]] == target )
+            {
+               target_wedge = triangle[corner];
+            }
+         }
+
+         auto it = std::find_if(
+            mapping.begin(),
+            mapping.end(),
+            [&]( const auto& entry )
+            {
+               return entry.first == source_wedge;
+            } );
+
+         if ( it == mapping.end() )
+         {
+            mapping.emplace_back( source_wedge, target_wedge );
+         }
+         else if ( it->second == UINT32_MAX )
+         {
+            it->second = target_wedge;
+         }
+         else if ( target_wedge != UINT32_MAX && it->second != target_wedge )
+         {
+            return false;
+         }
+      }
+
+      return std::all_of(
+         mapping.begin(),
+         mapping.end(),
+         []( const auto& entry )
+         {
+            return entry.second != UINT32_MAX;
+         } );
+   }
+
+   // Moving source onto target must not turn any remaining triangle around
+   auto flips_triangles(
+      uint32_t source,
+      uint32_t target ) const
+      -> bool
+   {
+      for ( uint32_t i = triangle_offset[source];
+            i < triangle_offset[source + 1];
+            ++i )
+      {
+         const uint32_t* triangle = &result[triangles[i] * 3];
+
+         std::array<glm::vec3, 3> before;
+         std::array<glm::vec3, 3> after;
+         bool has_target = false;
+
+         for ( size_t corner = 0;
+               corner < 3;
+               ++corner )
+         {
+            uint32_t position = position_of[triangle[corner]];
+            has_target = has_target || position == target;
+
+            before[corner] = pos( position );
+            after[corner] = position == source ? pos( target ) : before[corner];
+         }
+
+         if ( has_target )
+         {
+            continue;
+         }
+
+         glm::vec3 normal_before = glm::cross( before[1] - before[0], before[2] - before[0] );
+         glm::vec3 normal_after = glm::cross( after[1] - after[0], after[2] - after[0] );
+
+         if ( glm::dot( normal_before, normal_after ) <= 0.0f )
+         {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   auto can_collapse(
+      uint32_t source,
+      uint32_t target,
+      std::vector<std::pair<uint32_t, uint32_t>>& mapping ) const
+      -> bool
+   {
+      if ( position_locked[source] )
+      {
+         return false;
+      }
+
+      // Border vertices may only slide along their border
+      if ( position_border[source] && edge_use_count( source, target ) != 1 )
+      {
+         return false;
+      }
+
+      return map_wedges( source, target, mapping ) && !flips_triangles( source, target );
+   }
+
+   auto collapse_pass(
+      size_t target_index_count,
+      double error_limit )
+      -> bool
+   {
+      std::vector<std::pair<uint32_t, uint32_t>> mapping;
+      std::vector<collapse_t> collapses;
+      collapses.reserve( edges.size() );
+
+      for ( uint64_t edge : edges )
+      {
+         auto a = static_cast<uint32_t>( edge >> 32 );
+         auto b = static_cast<uint32_t>( edge );
+
+         quadric_t combined = quadrics[a];
+         combined.add( quadrics[b] );
+
+         double error_ab = can_collapse( a, b, mapping ) ? combined.error( pos( b ) ) : -1.0;
+         double error_ba = can_collapse( b, a, mapping ) ? combined.error( pos( a ) ) : -1.0;
+
+         if ( error_ab >= 0.0 && ( error_ba < 0.0 || error_ab <= error_ba ) )
+         {
+            collapses.push_back( { a, b, error_ab } );
+         }
+         else if ( error_ba >= 0.0 )
+         {
+            collapses.push_back( { b, a, error_ba } );
+         }
+      }
+
+      std::sort(
+         collapses.begin(),
+         collapses.end(),
+         []( const collapse_t& a, const collapse_t& b )
+         {
+            return a.error < b.error;
+         } );
+
+      std::iota( collapse_remap.begin(), collapse_remap.end(), 0u );
+
+      size_t triangles_left = result.size() / 3;
+      size_t target_triangles = target_index_count / 3;
+
+      // Only the cheapest collapses needed to reach the target are considered; the ones
+      // skipped for overlapping an earlier collapse are usually taken in the next pass
+      // and are cheaper than what lies further down the list
+      size_t collapses_needed = std::max<size_t>( ( triangles_left - target_triangles ) / 2, 1 );
+      if ( collapses_needed < collapses.size() )
+      {
+         error_limit = std::min( error_limit, collapses[collapses_needed - 1].error * 1.5 );
+      }
+
+      // Collapses in one pass must not touch each other's neighbourhood, the checks above
+      // were made against the topology at the start of the pass
+      std::vector<uint8_t> touched( vertices.size(), 0 );
+      size_t applied = 0;
+
+      for ( const auto& collapse : collapses )
+      {
+         if ( collapse.error > error_limit || triangles_left <= target_triangles )
+         {
+            break;
+         }
+
+         if ( touched[collapse.source] || touched[collapse.target] )
+         {
+            continue;
+         }
+
+         if ( !map_wedges( collapse.source, collapse.target, mapping ) )
+         {
+            continue;
+         }
+
+         for ( const auto& [source_wedge, target_wedge] : mapping )
+         {
+            collapse_remap[source_wedge] = target_wedge;
+         }
+
+         for ( uint32_t i = triangle_offset[collapse.source];
+               i < triangle_offset[collapse.source + 1];
+               ++i )
+         {
+            const uint32_t* triangle = &result[triangles[i] * 3];
+            bool removed = false;
+
+            for ( size_t corner = 0;
+                  corner < 3;
+                  ++corner )
+            {
+               touched[position_of[triangle[corner]]] = 1;
+               removed = removed || position_of[triangle[corner]] == collapse.target;
+            }
+
+            triangles_left -= removed ? 1 : 0;
+         }
+
+         quadrics[collapse.target].add( quadrics[collapse.source] );
+         max_collapse_error = std::max( max_collapse_error, collapse.error );
+         ++applied;
+      }
+
+      if ( applied == 0 )
+      {
+         return false;
+      }
+
+      // Collapsed wedges now point at their targets; drop triangles that became degenerate
+      size_t write = 0;
+      for ( size_t triangle = 0;
+            triangle < result.size() / 3;
+            ++triangle )
+      {
+         uint32_t a = collapse_remap[result[triangle * 3 + 0]];
+         uint32_t b = collapse_remap[result[triangle * 3 + 1]];
+         uint32_t c = collapse_remap[result[triangle * 3 + 2]];
+
+         if ( position_of[a] == position_of[b] || position_of[b] == position_of[c] || position_of[a] == position_of[c] )
+         {
+            continue;
+         }
+
+         result[write++] = a;
+         result[write++] = b;
+         result[write++] = c;
+      }
+      result.resize( write );
+
+      return true;
+   }
+};
+}   // namespace
+
+auto simplify_mesh(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices,
+   size_t target_index_count,
+   float target_error,
+   float& result_error )
+   -> std::vector<uint32_t>
+{
+   simplifier_t simplifier( indices, vertices );
+
+   auto simplified = simplifier.run( target_index_count, target_error );
+   result_error = simplifier.max_error();
+
+   return simplified;
+}
+
+auto build_lod_chain(
+   std::vector<uint32_t>& indices,
+   std::span<const Vertex> vertices,
+   size_t max_lods )
+   -> std::vector<mesh_lod_t>
+{
+   constexpr size_t min_lod_triangles = 64;
+
+   std::vector<mesh_lod_t> lods{ {
+      .first_index = 0,
+      .index_count = static_cast<uint32_t>( indices.size() ),
+      .error = 0.0f } };
+
+   std::vector<uint32_t> previous( indices.begin(), indices.end() );
+   float previous_error = 0.0f;
+
+   while ( lods.size() < max_lods && previous.size() / 3 > min_lod_triangles )
+   {
+      size_t target = previous.size() / 6 * 3;
+
+      float error = 0.0f;
+      auto lod = simplify_mesh( previous, vertices, target, std::numeric_limits<float>::max(), error );
+
+      // Not worth a level if the borders and seams hold most of the triangles in place
+      if ( lod.empty() || lod.size() > previous.size() * 9 / 10 )
+      {
+         break;
+      }
+
+      optimize_vertex_cache( lod, vertices.size() );
+
+      // Errors of successive levels add up as each one is built from the previous
+      previous_error += error;
+
+      lods.push_back( {
+         .first_index = static_cast<uint32_t>( indices.size() ),
+         .index_count = static_cast<uint32_t>( lod.size() ),
+         .error = previous_error } );
+
+      indices.insert( indices.end(), lod.begin(), lod.end() );
+      previous = std::move( lod );
+   }
+
+   return lods;
+}
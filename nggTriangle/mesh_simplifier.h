@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mesh_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Quadric error edge collapse simplification. Vertices are only ever collapsed onto
+// other existing vertices, so every level of detail shares the original vertex array.
+// Open borders stay in place and texture seams are collapsed along the seam only.
+//
+// Stops at target_index_count or once the next collapse would move the surface by
+// more than target_error. result_error receives the largest deviation introduced,
+// in the same units as the vertex positions.
+auto simplify_mesh(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices,
+   size_t target_index_count,
+   float target_error,
+   float& result_error )
+   -> std::vector<uint32_t>;
+
+// Appends successively coarser levels of detail to indices, each about half the
+// triangles of the previous one, and returns the index range of every level with
+// LOD 0 being the original list. Stops early once a level no longer simplifies well.
+auto build_lod_chain(
+   std::vector<uint32_t>& indices,
+   std::span<const Vertex> vertices,
+   size_t max_lods = 6 )
+   -> std::vector<mesh_lod_t>;
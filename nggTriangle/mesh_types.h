@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#pragma warning( disable : 4201 )
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+// Mesh data shared by the renderer and the asset cooker. Nothing here depends on Vulkan.
+
+struct Vertex
+{
+   glm::vec3 pos;
+   glm::vec3 color;
+   glm::vec2 texCoord;
+
+   bool operator==(
+      const Vertex& other ) const
+   {
+      return pos == other.pos && color == other.color && texCoord == other.texCoord;
+   }
+};
+
+namespace std
+{
+template <>
+struct hash<Vertex>
+{
+   size_t operator()( const Vertex& vertex ) const
+   {
+      return ( ( hash<glm::vec3>()( vertex.pos ) ^ ( hash<glm::vec3>()( vertex.color ) << 1 ) ) >> 1 ) ^
+             ( hash<glm::vec2>()( vertex.texCoord ) << 1 );
+   }
+};
+};   // namespace std
+
+struct mesh_bounds_t
+{
+   glm::vec3 min{};
+   glm::vec3 max{};
+};
+
+// One level of detail as a range of the shared index buffer. error bounds how far the
+// level deviates from LOD 0, in model space units.
+struct mesh_lod_t
+{
+   uint32_t first_index;
+   uint32_t index_count;
+   float error;
+};
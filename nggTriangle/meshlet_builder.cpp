@@ -0,0 +1,148 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+void compute_meshlet_bounds(
+   meshlet_t& meshlet,
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices )
+{
+   auto triangles = indices.subspan( meshlet.first_index, meshlet.index_count );
+
+   glm::vec3 min_pos( std::numeric_limits<float>::max() );
+   glm::vec3 max_pos( std::numeric_limits<float>::lowest() );
+   for ( uint32_t index : triangles )
+   {
+      min_pos = glm::min( min_pos, vertices[index].pos );
+      max_pos = glm::max( max_pos, vertices[index].pos );
+   }
+
+   meshlet.center = ( min_pos + max_pos ) * 0.5f;
+   meshlet.radius = 0.0f;
+   for ( uint32_t index : triangles )
+   {
+      meshlet.radius = std::max( meshlet.radius, glm::length( vertices[index].pos - meshlet.center ) );
+   }
+
+   // Cone of triangle normals around the area weighted average normal
+   std::vector<glm::vec3> normals;
+   normals.reserve( triangles.size() / 3 );
+
+   glm::vec3 axis( 0.0f );
+   for ( size_t corner = 0;
+         corner + 2 < triangles.size();
+         corner += 3 )
+   {
+      const glm::vec3& p0 = vertices[triangles[corner + 0]].pos;
+      const glm::vec3& p1 = vertices[triangles[corner + 1]].pos;
+      const glm::vec3& p2 = vertices[triangles[corner + 2]].pos;
+
+      glm::vec3 normal = glm::cross( p1 - p0, p2 - p0 );
+      float length = glm::length( normal );
+      if ( length == 0.0f )
+      {
+         continue;
+      }
+
+      axis += normal;
+      normals.push_back( normal / length );
+   }
+
+   float axis_length = glm::length( axis );
+   float min_dot = 1.0f;
+
+   if ( axis_length > 0.0f )
+   {
+      axis /= axis_length;
+      for ( const auto& normal : normals )
+      {
+         min_dot = std::min( min_dot, glm::dot( axis, normal ) );
+      }
+   }
+
+   meshlet.cone_axis = axis;
+
+   // A cone of half angle 90 degrees or more always has a triangle facing the viewer;
+   // a cutoff of 1 with a positive radius never passes the test
+   meshlet.cone_cutoff =
+      axis_length > 0.0f && min_dot > 0.0f ? std::sqrt( 1.0f - min_dot * min_dot ) : 1.0f;
+}
+}   // namespace
+
+auto build_meshlets(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices,
+   size_t max_vertices,
+   size_t max_triangles )
+   -> std::vector<meshlet_t>
+{
+   std::vector<meshlet_t> meshlets;
+
+   // Vertices seen in the current meshlet are marked with its number plus one
+   std::vector<uint32_t> vertex_meshlet( vertices.size(), 0 );
+
+   meshlet_t current{};
+   size_t unique_vertices = 0;
+
+   auto finish_meshlet =
+      [&]()
+      {
+         compute_meshlet_bounds( current, indices, vertices );
+         meshlets.push_back( current );
+      };
+
+   for ( size_t triangle = 0;
+         triangle < indices.size() / 3;
+         ++triangle )
+   {
+      auto stamp = static_cast<uint32_t>( meshlets.size() + 1 );
+
+      size_t new_vertices = 0;
+      for ( size_t corner = 0;
+            corner < 3;
+            ++corner )
+      {
+         uint32_t index = indices[triangle * 3 + corner];
+         bool repeated = corner > 0 && indices[triangle * 3] == index;
+         repeated = repeated || ( corner > 1 && indices[triangle * 3 + 1] == index );
+
+         new_vertices += vertex_meshlet[index] != stamp && !repeated ? 1 : 0;
+      }
+
+      if ( current.index_count > 0 &&
+           ( unique_vertices + new_vertices > max_vertices || current.index_count / 3 + 1 > max_triangles ) )
+      {
+         finish_meshlet();
+
+         current = {};
+         current.first_index = static_cast<uint32_t>( triangle * 3 );
+         unique_vertices = 0;
+         stamp = static_cast<uint32_t>( meshlets.size() + 1 );
+      }
+
+      for ( size_t corner = 0;
+            corner < 3;
+            ++corner )
+      {
+         uint32_t index = indices[triangle * 3 + corner];
+         if ( vertex_meshlet[index] != stamp )
+         {
+            vertex_meshlet[index] = stamp;
+            ++unique_vertices;
+         }
+      }
+
+      current.index_count += 3;
+   }
+
+   if ( current.index_count > 0 )
+   {
+      finish_meshlet();
+   }
+
+   return meshlets;
+}
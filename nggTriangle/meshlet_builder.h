@@ -0,0 +1,46 @@
+#pragma once
+
+#include "mesh_types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+constexpr size_t max_meshlet_vertices = 64;
+constexpr size_t max_meshlet_triangles = 124;
+
+// A run of consecutive triangles in the index buffer with bounds for culling. The
+// layout matches the std430 Meshlet struct in meshlet_cull.comp.
+struct meshlet_t
+{
+   // Bounding sphere in model space
+   glm::vec3 center;
+   float radius;
+   // All triangles face away from a viewer at p if
+   // dot( center - p, cone_axis ) >= cone_cutoff * length( center - p ) + radius
+   glm::vec3 cone_axis;
+   float cone_cutoff;
+   uint32_t first_index;
+   uint32_t index_count;
+   uint32_t padding[2];
+};
+
+static_assert( sizeof( meshlet_t ) == 48 );
+
+// The meshlets of one LOD in the meshlet table
+struct meshlet_range_t
+{
+   uint32_t first_meshlet;
+   uint32_t meshlet_count;
+};
+
+// Cuts the triangle list, in its current order, into meshlets of at most max_vertices
+// unique vertices and max_triangles triangles. The list should already be vertex cache
+// optimised so that meshlets come out spatially compact.
+auto build_meshlets(
+   std::span<const uint32_t> indices,
+   std::span<const Vertex> vertices,
+   size_t max_vertices = max_meshlet_vertices,
+   size_t max_triangles = max_meshlet_triangles )
+   -> std::vector<meshlet_t>;
@@ -0,0 +1,415 @@
+#include "mip_generator.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( _M_ARM64 )
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+// Kaiser windowed sinc: half width in target texels and window shape
+constexpr float kaiser_radius = 3.0f;
+constexpr float kaiser_alpha = 4.0f;
+
+// Target rows per task. Source rows under the kernel overlap between bands and are
+// filtered twice, so bands are kept well above the kernel height.
+constexpr uint32_t rows_per_band = 32;
+
+struct conversion_tables_t
+{
+   std::array<float, 256> srgb_to_linear;
+   std::array<float, 256> unorm_to_float;
+   // Indexed by a linear value in [0, 1] scaled to 16 bits, fine enough for the dark end
+   std::vector<uint8_t> linear_to_srgb;
+
+   conversion_tables_t()
+      : linear_to_srgb( 65536 )
+   {
+      for ( size_t value = 0;
+            value < 256;
+            ++value )
+      {
+         float c = static_cast<float>( value ) / 255.0f;
+         srgb_to_linear[value] = c <= 0.04045f ? c / 12.92f : std::pow( ( c + 0.055f ) / 1.055f, 2.4f );
+         unorm_to_float[value] = c;
+      }
+
+      for ( size_t index = 0;
+            index < linear_to_srgb.size();
+            ++index )
+      {
+         float l = static_cast<float>( index ) / 65535.0f;
+         float c = l <= 0.0031308f ? 12.92f * l : 1.055f * std::pow( l, 1.0f / 2.4f ) - 0.055f;
+         linear_to_srgb[index] = static_cast<uint8_t>( std::clamp( c, 0.0f, 1.0f ) * 255.0f + 0.5f );
+      }
+   }
+};
+
+auto conversion_tables()
+   -> const conversion_tables_t&
+{
+   static const conversion_tables_t tables;
+   return tables;
+}
+
+// Every target texel reads tap_count consecutive source texels from first, with
+// clamp to edge already folded into the weights
+struct filter_taps_t
+{
+   size_t tap_count{ 0 };
+   std::vector<uint32_t> first;
+   std::vector<float> weights;
+};
+
+auto bessel_i0(
+   float x )
+   -> float
+{
+   float sum = 1.0f;
+   float term = 1.0f;
+   for ( int k = 1;
+         term > sum * 1e-7f;
+         ++k )
+   {
+      float factor = x / ( 2.0f * k );
+      term *= factor * factor;
+      sum += term;
+   }
+
+   return sum;
+}
+
+auto kaiser_sinc(
+   float x )
+   -> float
+{
+   if ( std::abs( x ) >= kaiser_radius )
+   {
+      return 0.0f;
+   }
+
+   float t = x / kaiser_radius;
+   float window = bessel_i0( kaiser_alpha * std::sqrt( 1.0f - t * t ) ) / bessel_i0( kaiser_alpha );
+   float sinc = x == 0.0f ? 1.0f : std::sin( std::numbers::pi_v<float> * x ) / ( std::numbers::pi_v<float> * x );
+
+   return sinc * window;
+}
+
+auto build_filter_taps(
+   uint32_t source_size,
+   uint32_t target_size,
+   mip_filter_t filter )
+   -> filter_taps_t
+{
+   // Odd sizes give a scale above 2, so a target texel covers part of a third source texel
+   float scale = static_cast<float>( source_size ) / target_size;
+   float support = filter == mip_filter_t::box ? 0.5f * scale : kaiser_radius * scale;
+
+   std::vector<std::vector<float>> target_weights( target_size );
+   std::vector<uint32_t> first( target_size );
+   size_t tap_count = 0;
+
+   for ( uint32_t target = 0;
+         target < target_size;
+         ++target )
+   {
+      float center = ( target + 0.5f ) * scale;
+      auto begin = static_cast<int64_t>( std::floor( center - support ) );
+      auto end = static_cast<int64_t>( std::ceil( center + support ) );
+
+      auto clamped_begin = static_cast<uint32_t>( std::max<int64_t>( begin, 0 ) );
+      auto clamped_end = static_cast<uint32_t>( std::min<int64_t>( end, source_size ) );
+
+      auto& weights = target_weights[target];
+      weights.assign( clamped_end - clamped_begin, 0.0f );
+
+      float total = 0.0f;
+      for ( int64_t source = begin;
+            source < end;
+            ++source )
+      {
+         float weight;
+         if ( filter == mip_filter_t::box )
+         {
+            float overlap_begin = std::max( static_cast<float>( source ), center - 0.5f * scale );
+            float overlap_end = std::min( static_cast<float>( source + 1 ), center + 0.5f * scale );
+            weight = std::max( overlap_end - overlap_begin, 0.0f );
+         }
+         else
+         {
+            weight = kaiser_sinc( ( static_cast<float>( source ) + 0.5f - center ) / scale );
+         }
+
+         auto clamped = std::clamp<int64_t>( source, clamped_begin, clamped_end - 1 );
+         weights[static_cast<size_t>( clamped - clamped_begin )] += weight;
+         total += weight;
+      }
+
+      for ( auto& weight : weights )
+      {
+         weight /= total;
+      }
+
+      first[target] = clamped_begin;
+      tap_count = std::max( tap_count, weights.size() );
+   }
+
+   // Pad every texel to tap_count taps, moving first back where the padding would
+   // run off the end of the source
+   filter_taps_t taps;
+   taps.tap_count = tap_count;
+   taps.first.resize( target_size );
+   taps.weights.assign( target_size * tap_count, 0.0f );
+
+   for ( uint32_t target = 0;
+         target < target_size;
+         ++target )
+   {
+      uint32_t shifted = std::min( first[target], static_cast<uint32_t>( source_size - tap_count ) );
+      taps.first[target] = shifted;
+
+      std::copy(
+         target_weights[target].begin(),
+         target_weights[target].end(),
+         taps.weights.begin() + target * tap_count + ( first[target] - shifted ) );
+   }
+
+   return taps;
+}
+
+// out = sum of weights[k] * texel k, for RGBA float texels
+void accumulate_texels(
+   float* out,
+   const float* texels,
+   const float* weights,
+   size_t count )
+{
+#if defined( __AVX2__ ) || defined( __SSE2__ ) || defined( _M_X64 )
+   __m128 sum = _mm_setzero_ps();
+   for ( size_t k = 0;
+         k < count;
+         ++k )
+   {
+      sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[k] ), _mm_loadu_ps( texels + 4 * k ) ) );
+   }
+   _mm_storeu_ps( out, sum );
+#elif defined( __ARM_NEON ) || defined( _M_ARM64 )
+   float32x4_t sum = vdupq_n_f32( 0.0f );
+   for ( size_t k = 0;
+         k < count;
+         ++k )
+   {
+      sum = vmlaq_n_f32( sum, vld1q_f32( texels + 4 * k ), weights[k] );
+   }
+   vst1q_f32( out, sum );
+#else
+   std::array<float, 4> sum{};
+   for ( size_t k = 0;
+         k < count;
+         ++k )
+   {
+      for ( size_t channel = 0;
+            channel < 4;
+            ++channel )
+      {
+         sum[channel] += weights[k] * texels[4 * k + channel];
+      }
+   }
+   std::copy( sum.begin(), sum.end(), out );
+#endif
+}
+
+// out += weight * in over count floats
+void accumulate_row(
+   float* out,
+   const float* in,
+   float weight,
+   size_t count )
+{
+   size_t i = 0;
+
+#if defined( __AVX2__ )
+   __m256 weight8 = _mm256_set1_ps( weight );
+   for ( ; i + 8 <= count; i += 8 )
+   {
+      _mm256_storeu_ps( out + i, _mm256_add_ps( _mm256_loadu_ps( out + i ), _mm256_mul_ps( weight8, _mm256_loadu_ps( in + i ) ) ) );
+   }
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+   __m128 weight4 = _mm_set1_ps( weight );
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      _mm_storeu_ps( out + i, _mm_add_ps( _mm_loadu_ps( out + i ), _mm_mul_ps( weight4, _mm_loadu_ps( in + i ) ) ) );
+   }
+#elif defined( __ARM_NEON ) || defined( _M_ARM64 )
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      vst1q_f32( out + i, vmlaq_n_f32( vld1q_f32( out + i ), vld1q_f32( in + i ), weight ) );
+   }
+#endif
+
+   for ( ; i < count; ++i )
+   {
+      out[i] += weight * in[i];
+   }
+}
+
+void load_row(
+   const std::byte* row,
+   size_t width,
+   bool srgb,
+   float* out )
+{
+   const auto& tables = conversion_tables();
+   const auto& color_table = srgb ? tables.srgb_to_linear : tables.unorm_to_float;
+
+   for ( size_t x = 0;
+         x < width;
+         ++x )
+   {
+      for ( size_t channel = 0;
+            channel < 3;
+            ++channel )
+      {
+         out[4 * x + channel] = color_table[std::to_integer<uint8_t>( row[4 * x + channel] )];
+      }
+      out[4 * x + 3] = tables.unorm_to_float[std::to_integer<uint8_t>( row[4 * x + 3] )];
+   }
+}
+
+void store_row(
+   const float* row,
+   size_t width,
+   bool srgb,
+   std::byte* out )
+{
+   const auto& tables = conversion_tables();
+
+   for ( size_t x = 0;
+         x < width;
+         ++x )
+   {
+      for ( size_t channel = 0;
+            channel < 4;
+            ++channel )
+      {
+         float value = std::clamp( row[4 * x + channel], 0.0f, 1.0f );
+
+         out[4 * x + channel] =
+            srgb && channel < 3 ? static_cast<std::byte>( tables.linear_to_srgb[static_cast<size_t>( value * 65535.0f + 0.5f )] )
+                                : static_cast<std::byte>( value * 255.0f + 0.5f );
+      }
+   }
+}
+
+void generate_level(
+   const std::byte* source,
+   uint32_t source_width,
+   uint32_t source_height,
+   std::byte* target,
+   uint32_t target_width,
+   uint32_t target_height,
+   mip_filter_t filter,
+   bool srgb )
+{
+   auto horizontal = build_filter_taps( source_width, target_width, filter );
+   auto vertical = build_filter_taps( source_height, target_height, filter );
+
+   size_t target_row_floats = size_t{ target_width } * 4;
+   size_t band_count = ( target_height + rows_per_band - 1 ) / rows_per_band;
+
+   thread_pool_t::shared().parallel_for(
+      band_count,
+      [&]( size_t band )
+      {
+         auto row_begin = static_cast<uint32_t>( band * rows_per_band );
+         uint32_t row_end = std::min( target_height, row_begin + rows_per_band );
+
+         // Source rows read by this band, filtered horizontally once each
+         uint32_t source_begin = vertical.first[row_begin];
+         auto source_end = static_cast<uint32_t>( vertical.first[row_end - 1] + vertical.tap_count );
+
+         std::vector<float> source_row( size_t{ source_width } * 4 );
+         std::vector<float> filtered( ( source_end - source_begin ) * target_row_floats );
+         std::vector<float> target_row( target_row_floats );
+
+         for ( uint32_t y = source_begin;
+               y < source_end;
+               ++y )
+         {
+            load_row( source + size_t{ y } * source_width * 4, source_width, srgb, source_row.data() );
+
+            float* out = filtered.data() + ( y - source_begin ) * target_row_floats;
+            for ( uint32_t x = 0;
+                  x < target_width;
+                  ++x )
+            {
+               accumulate_texels(
+                  out + 4 * x,
+                  source_row.data() + 4 * size_t{ horizontal.first[x] },
+                  horizontal.weights.data() + x * horizontal.tap_count,
+                  horizontal.tap_count );
+            }
+         }
+
+         for ( uint32_t y = row_begin;
+               y < row_end;
+               ++y )
+         {
+            std::fill( target_row.begin(), target_row.end(), 0.0f );
+
+            for ( size_t k = 0;
+                  k < vertical.tap_count;
+                  ++k )
+            {
+               float weight = vertical.weights[y * vertical.tap_count + k];
+               if ( weight != 0.0f )
+               {
+                  accumulate_row(
+                     target_row.data(),
+                     filtered.data() + ( vertical.first[y] + k - source_begin ) * target_row_floats,
+                     weight,
+                     target_row_floats );
+               }
+            }
+
+            store_row( target_row.data(), target_width, srgb, target + size_t{ y } * target_width * 4 );
+         }
+      } );
+}
+}   // namespace
+
+void generate_mip_chain(
+   std::span<std::byte> data,
+   std::span<const texture_level_t> levels,
+   mip_filter_t filter,
+   bool srgb )
+{
+   for ( size_t level = 1;
+         level < levels.size();
+         ++level )
+   {
+      const auto& source = levels[level - 1];
+      const auto& target = levels[level];
+
+      generate_level(
+         data.data() + source.offset,
+         source.width,
+         source.height,
+         data.data() + target.offset,
+         target.width,
+         target.height,
+         filter,
+         srgb );
+   }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "texture_cache.h"
+
+#include <cstddef>
+#include <span>
+
+enum class mip_filter_t
+{
+   // Exact area average, also over the 3 texel footprint of odd sizes
+   box,
+   // Kaiser windowed sinc, sharper than box without visible ringing
+   kaiser
+};
+
+// Fills levels 1 and up of an RGBA8 mip chain from level 0, in place in the layout of
+// layout_texture_levels(), so data can be the mapped staging buffer itself. With srgb
+// set colour is filtered in linear space; alpha is always linear. Each level is
+// filtered from the one above with clamp to edge addressing.
+void generate_mip_chain(
+   std::span<std::byte> data,
+   std::span<const texture_level_t> levels,
+   mip_filter_t filter,
+   bool srgb );
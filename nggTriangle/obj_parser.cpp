@@ -0,0 +1,445 @@
+#include "obj_parser.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+// Below this each thread would spend more time starting up than parsing
+constexpr size_t min_chunk_size = 256 * 1024;
+
+constexpr uint8_t relative_position = 1;
+constexpr uint8_t relative_texcoord = 2;
+constexpr uint8_t relative_normal = 4;
+
+struct obj_shape_start_t
+{
+   std::string name;
+   size_t first_index;
+};
+
+struct obj_relative_index_t
+{
+   size_t index;
+   uint8_t components;
+};
+
+struct obj_chunk_t
+{
+   std::string_view text;
+
+   std::vector<float> positions;
+   std::vector<float> texcoords;
+   std::vector<float> normals;
+   std::vector<tinyobj::index_t> indices;
+
+   // Negative OBJ indices are stored relative to the start of the chunk until the
+   // attribute counts of the preceding chunks are known
+   std::vector<obj_relative_index_t> relative_indices;
+   std::vector<obj_shape_start_t> shape_starts;
+};
+
+void skip_spaces(
+   std::string_view& text )
+{
+   size_t i = 0;
+   while ( i < text.size() && ( text[i] == ' ' || text[i] == '\t' ) )
+   {
+      ++i;
+   }
+   text.remove_prefix( i );
+}
+
+auto parse_float(
+   std::string_view& text,
+   float& value )
+   -> bool
+{
+   skip_spaces( text );
+   if ( !text.empty() && text.front() == '+' )
+   {
+      text.remove_prefix( 1 );
+   }
+
+   auto [end, error] = std::from_chars( text.data(), text.data() + text.size(), value );
+   if ( error != std::errc() )
+   {
+      return false;
+   }
+
+   text.remove_prefix( static_cast<size_t>( end - text.data() ) );
+   return true;
+}
+
+auto parse_int(
+   std::string_view& text,
+   int& value )
+   -> bool
+{
+   if ( !text.empty() && text.front() == '+' )
+   {
+      text.remove_prefix( 1 );
+   }
+
+   auto [end, error] = std::from_chars( text.data(), text.data() + text.size(), value );
+   if ( error != std::errc() )
+   {
+      return false;
+   }
+
+   text.remove_prefix( static_cast<size_t>( end - text.data() ) );
+   return true;
+}
+
+// Converts a 1-based or negative OBJ index, returns true when the result is chunk relative
+auto resolve_index(
+   int value,
+   size_t local_count,
+   int& resolved )
+   -> bool
+{
+   if ( value > 0 )
+   {
+      resolved = value - 1;
+      return false;
+   }
+
+   if ( value == 0 )
+   {
+      throw std::runtime_error( "OBJ index 0 is not valid!" );
+   }
+
+   resolved = static_cast<int>( local_count ) + value;
+   return true;
+}
+
+void parse_face(
+   std::string_view text,
+   obj_chunk_t& chunk,
+   std::vector<tinyobj::index_t>& face,
+   std::vector<uint8_t>& face_relative )
+{
+   face.clear();
+   face_relative.clear();
+
+   size_t position_count = chunk.positions.size() / 3;
+   size_t texcoord_count = chunk.texcoords.size() / 2;
+   size_t normal_count = chunk.normals.size() / 3;
+
+   for ( ;; )
+   {
+      skip_spaces( text );
+      if ( text.empty() )
+      {
+         break;
+      }
+
+      tinyobj::index_t index{ -1, -1, -1 };
+      uint8_t relative{ 0 };
+      int value{ 0 };
+
+      if ( !parse_int( text, value ) )
+      {
+         throw std::runtime_error( "malformed OBJ face record!" );
+      }
+      if ( resolve_index( value, position_count, index.vertex_index ) )
+      {
+         relative |= relative_position;
+      }
+
+      if ( !text.empty() && text.front() == '/' )
+      {
+         text.remove_prefix( 1 );
+
+         if ( !text.empty() && text.front() != '/' )
+         {
+            if ( !parse_int( text, value ) )
+            {
+               throw std::runtime_error( "malformed OBJ face record!" );
+            }
+            if ( resolve_index( value, texcoord_count, index.texcoord_index ) )
+            {
+               relative |= relative_texcoord;
+            }
+         }
+
+         if ( !text.empty() && text.front() == '/' )
+         {
+            text.remove_prefix( 1 );
+
+            if ( !parse_int( text, value ) )
+            {
+               throw std::runtime_error( "malformed OBJ face record!" );
+            }
+            if ( resolve_index( value, normal_count, index.normal_index ) )
+            {
+               relative |= relative_normal;
+            }
+         }
+      }
+
+      face.push_back( index );
+      face_relative.push_back( relative );
+   }
+
+   if ( face.size() < 3 )
+   {
+      throw std::runtime_error( "OBJ face with fewer than 3 vertices!" );
+   }
+
+   // Fan triangulation, same as tinyobj for convex polygons
+   for ( size_t k = 1;
+         k + 1 < face.size();
+         ++k )
+   {
+      for ( size_t corner : { size_t{ 0 }, k, k + 1 } )
+      {
+         if ( face_relative[corner] )
+         {
+            chunk.relative_indices.push_back( { chunk.indices.size(), face_relative[corner] } );
+         }
+         chunk.indices.push_back( face[corner] );
+      }
+   }
+}
+
+void parse_chunk(
+   obj_chunk_t& chunk )
+{
+   std::vector<tinyobj::index_t> face;
+   std::vector<uint8_t> face_relative;
+
+   std::string_view text = chunk.text;
+
+   while ( !text.empty() )
+   {
+      size_t line_end = text.find( '\n' );
+      std::string_view line = text.substr( 0, line_end );
+      text.remove_prefix( line_end == std::string_view::npos ? text.size() : line_end + 1 );
+
+      if ( !line.empty() && line.back() == '\r' )
+      {
+         line.remove_suffix( 1 );
+      }
+
+      skip_spaces( line );
+      if ( line.empty() || line.front() == '#' )
+      {
+         continue;
+      }
+
+      size_t keyword_end = line.find_first_of( " \t" );
+      std::string_view keyword = line.substr( 0, keyword_end );
+      line.remove_prefix( keyword.size() );
+
+      if ( keyword == "v" )
+      {
+         float x, y, z;
+         if ( !parse_float( line, x ) || !parse_float( line, y ) || !parse_float( line, z ) )
+         {
+            throw std::runtime_error( "malformed OBJ vertex record!" );
+         }
+         chunk.positions.insert( chunk.positions.end(), { x, y, z } );
+      }
+      else if ( keyword == "vt" )
+      {
+         float u, v{ 0.0f };
+         if ( !parse_float( line, u ) )
+         {
+            throw std::runtime_error( "malformed OBJ texcoord record!" );
+         }
+         parse_float( line, v );
+         chunk.texcoords.insert( chunk.texcoords.end(), { u, v } );
+      }
+      else if ( keyword == "vn" )
+      {
+         float x, y, z;
+         if ( !parse_float( line, x ) || !parse_float( line, y ) || !parse_float( line, z ) )
+         {
+            throw std::runtime_error( "malformed OBJ normal record!" );
+         }
+         chunk.normals.insert( chunk.normals.end(), { x, y, z } );
+      }
+      else if ( keyword == "f" )
+      {
+         parse_face( line, chunk, face, face_relative );
+      }
+      else if ( keyword == "o" || keyword == "g" )
+      {
+         skip_spaces( line );
+         while ( !line.empty() && ( line.back() == ' ' || line.back() == '\t' ) )
+         {
+            line.remove_suffix( 1 );
+         }
+         chunk.shape_starts.push_back( { std::string( line ), chunk.indices.size() } );
+      }
+      // Materials, smoothing groups, lines and points are not used by the renderer
+   }
+}
+
+// Splits the text into about chunk_count pieces, each ending just after a newline
+auto split_chunks(
+   std::string_view text,
+   size_t chunk_count )
+   -> std::vector<obj_chunk_t>
+{
+   std::vector<obj_chunk_t> chunks;
+   chunks.reserve( chunk_count );
+
+   size_t begin = 0;
+   for ( size_t i = 1;
+         i <= chunk_count && begin < text.size();
+         ++i )
+   {
+      size_t end = text.size();
+      if ( i < chunk_count )
+      {
+         end = text.find( '\n', std::max( begin, text.size() * i / chunk_count ) );
+         end = end == std::string_view::npos ? text.size() : end + 1;
+      }
+
+      chunks.emplace_back().text = text.substr( begin, end - begin );
+      begin = end;
+   }
+
+   return chunks;
+}
+
+void append_shape_range(
+   tinyobj::shape_t& shape,
+   const std::vector<tinyobj::index_t>& indices,
+   size_t begin,
+   size_t end )
+{
+   shape.mesh.indices.insert(
+      shape.mesh.indices.end(),
+      indices.begin() + static_cast<ptrdiff_t>( begin ),
+      indices.begin() + static_cast<ptrdiff_t>( end ) );
+
+   size_t triangle_count = ( end - begin ) / 3;
+   shape.mesh.num_face_vertices.insert( shape.mesh.num_face_vertices.end(), triangle_count, 3 );
+   shape.mesh.material_ids.insert( shape.mesh.material_ids.end(), triangle_count, -1 );
+   shape.mesh.smoothing_group_ids.insert( shape.mesh.smoothing_group_ids.end(), triangle_count, 0 );
+}
+}   // namespace
+
+void load_obj_parallel(
+   const std::filesystem::path& path,
+   tinyobj::attrib_t& attrib,
+   std::vector<tinyobj::shape_t>& shapes,
+   thread_pool_t& pool )
+{
+   mapped_file_t file( path );
+   load_obj_parallel( file.data(), attrib, shapes, pool );
+}
+
+void load_obj_parallel(
+   std::span<const std::byte> bytes,
+   tinyobj::attrib_t& attrib,
+   std::vector<tinyobj::shape_t>& shapes,
+   thread_pool_t& pool )
+{
+   std::string_view text( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+
+   size_t chunk_count = std::clamp( text.size() / min_chunk_size, size_t{ 1 }, pool.size() * 4 );
+   auto chunks = split_chunks( text, chunk_count );
+
+   pool.parallel_for( chunks.size(), [&]( size_t i ) { parse_chunk( chunks[i] ); } );
+
+   // Attribute bases of every chunk, in elements
+   struct chunk_base_t
+   {
+      size_t position;
+      size_t texcoord;
+      size_t normal;
+   };
+
+   std::vector<chunk_base_t> bases( chunks.size() );
+   chunk_base_t total{ 0, 0, 0 };
+
+   for ( size_t i = 0;
+         i < chunks.size();
+         ++i )
+   {
+      bases[i] = total;
+      total.position += chunks[i].positions.size() / 3;
+      total.texcoord += chunks[i].texcoords.size() / 2;
+      total.normal += chunks[i].normals.size() / 3;
+   }
+
+   attrib = {};
+   attrib.vertices.resize( total.position * 3 );
+   attrib.texcoords.resize( total.texcoord * 2 );
+   attrib.normals.resize( total.normal * 3 );
+
+   pool.parallel_for(
+      chunks.size(),
+      [&]( size_t i )
+      {
+         auto& chunk = chunks[i];
+         const auto& base = bases[i];
+
+         std::copy( chunk.positions.begin(), chunk.positions.end(), attrib.vertices.begin() + base.position * 3 );
+         std::copy( chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + base.texcoord * 2 );
+         std::copy( chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + base.normal * 3 );
+
+         for ( const auto& relative : chunk.relative_indices )
+         {
+            auto& index = chunk.indices[relative.index];
+            if ( relative.components & relative_position )
+            {
+               index.vertex_index += static_cast<int>( base.position );
+            }
+            if ( relative.components & relative_texcoord )
+            {
+               index.texcoord_index += static_cast<int>( base.texcoord );
+            }
+            if ( relative.components & relative_normal )
+            {
+               index.normal_index += static_cast<int>( base.normal );
+            }
+         }
+
+         for ( const auto& index : chunk.indices )
+         {
+            if ( index.vertex_index < 0 || static_cast<size_t>( index.vertex_index ) >= total.position ||
+                 index.texcoord_index >= static_cast<int>( total.texcoord ) ||
+                 index.normal_index >= static_cast<int>( total.normal ) ||
+                 index.texcoord_index < -1 || index.normal_index < -1 )
+            {
+               throw std::runtime_error( "OBJ face index out of range!" );
+            }
+         }
+      } );
+
+   // Shapes can span chunks: faces before a chunk's first o/g belong to the previous shape
+   shapes.clear();
+   shapes.emplace_back();
+
+   for ( auto& chunk : chunks )
+   {
+      size_t begin = 0;
+      for ( auto& shape_start : chunk.shape_starts )
+      {
+         append_shape_range( shapes.back(), chunk.indices, begin, shape_start.first_index );
+         begin = shape_start.first_index;
+
+         if ( shapes.back().mesh.indices.empty() )
+         {
+            shapes.back().name = std::move( shape_start.name );
+         }
+         else
+         {
+            shapes.emplace_back().name = std::move( shape_start.name );
+         }
+      }
+
+      append_shape_range( shapes.back(), chunk.indices, begin, chunk.indices.size() );
+   }
+
+   std::erase_if( shapes, []( const tinyobj::shape_t& shape ) { return shape.mesh.indices.empty(); } );
+}
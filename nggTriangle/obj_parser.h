@@ -0,0 +1,27 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Parallel replacement for tinyobj::LoadObj. The file is memory-mapped, split at
+// line boundaries and the chunks are parsed on the pool. Only geometry is read:
+// v/vt/vn records, f records (fan triangulated like tinyobj) and o/g shape names.
+// Throws std::runtime_error on malformed input.
+void load_obj_parallel(
+   const std::filesystem::path& path,
+   tinyobj::attrib_t& attrib,
+   std::vector<tinyobj::shape_t>& shapes,
+   thread_pool_t& pool = thread_pool_t::shared() );
+
+// Parses OBJ text already in memory, e.g. an asset archive entry
+void load_obj_parallel(
+   std::span<const std::byte> bytes,
+   tinyobj::attrib_t& attrib,
+   std::vector<tinyobj::shape_t>& shapes,
+   thread_pool_t& pool = thread_pool_t::shared() );
@@ -0,0 +1,77 @@
+#include "packed_vertex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+auto quantize_snorm16(
+   float value )
+   -> int16_t
+{
+   return static_cast<int16_t>( std::lround( std::clamp( value, -1.0f, 1.0f ) * 32767.0f ) );
+}
+
+auto quantize_unorm16(
+   float value )
+   -> uint16_t
+{
+   return static_cast<uint16_t>( std::lround( std::clamp( value, 0.0f, 1.0f ) * 65535.0f ) );
+}
+}   // namespace
+
+auto make_vertex_quantization(
+   const mesh_bounds_t& bounds )
+   -> vertex_quantization_t
+{
+   vertex_quantization_t quantization{};
+   quantization.offset = ( bounds.min + bounds.max ) * 0.5f;
+   quantization.scale = ( bounds.max - bounds.min ) * 0.5f;
+
+   return quantization;
+}
+
+auto can_pack_vertices(
+   std::span<const Vertex> vertices )
+   -> bool
+{
+   return std::all_of(
+      vertices.begin(),
+      vertices.end(),
+      []( const Vertex& vertex )
+      {
+         return vertex.color == glm::vec3( 1.0f ) && vertex.texCoord.x >= 0.0f && vertex.texCoord.x <= 1.0f &&
+                vertex.texCoord.y >= 0.0f && vertex.texCoord.y <= 1.0f;
+      } );
+}
+
+void pack_vertices(
+   std::span<const Vertex> vertices,
+   const vertex_quantization_t& quantization,
+   std::vector<packed_vertex_t>& packed )
+{
+   // A flat axis has zero scale; any value dequantises to the offset there
+   glm::vec3 inverse_scale{
+      quantization.scale.x > 0.0f ? 1.0f / quantization.scale.x : 0.0f,
+      quantization.scale.y > 0.0f ? 1.0f / quantization.scale.y : 0.0f,
+      quantization.scale.z > 0.0f ? 1.0f / quantization.scale.z : 0.0f };
+
+   packed.resize( vertices.size() );
+
+   for ( size_t i = 0;
+         i < vertices.size();
+         ++i )
+   {
+      glm::vec3 normalized = ( vertices[i].pos - quantization.offset ) * inverse_scale;
+
+      packed[i].pos = {
+         quantize_snorm16( normalized.x ),
+         quantize_snorm16( normalized.y ),
+         quantize_snorm16( normalized.z ),
+         0 };
+
+      packed[i].texCoord = {
+         quantize_unorm16( vertices[i].texCoord.x ),
+         quantize_unorm16( vertices[i].texCoord.y ) };
+   }
+}
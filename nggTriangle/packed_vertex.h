@@ -0,0 +1,77 @@
+#pragma once
+
+#include "mesh_types.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Compact vertex layout for meshes whose colour is constant white. The position is
+// snorm16 relative to the mesh bounds and the texture coordinate unorm16, 12 bytes in
+// total against 32 for Vertex. shader.vert built with PACKED_VERTEX dequantises it.
+struct packed_vertex_t
+{
+   std::array<int16_t, 4> pos;        // w is padding so the attribute stays 8 byte aligned
+   std::array<uint16_t, 2> texCoord;
+
+   static
+   auto getBindingDescription()
+      -> VkVertexInputBindingDescription
+   {
+      VkVertexInputBindingDescription binding_description{};
+      binding_description.binding = 0;
+      binding_description.stride = sizeof( packed_vertex_t );
+      binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+      return binding_description;
+   }
+
+   // Locations match Vertex; there is no colour attribute at location 1
+   static
+   auto getAttributeDescriptions()
+      -> std::array<
+         VkVertexInputAttributeDescription,
+         2>
+   {
+      std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions{};
+
+      attribute_descriptions[0].binding = 0;
+      attribute_descriptions[0].location = 0;
+      attribute_descriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+      attribute_descriptions[0].offset = offsetof( packed_vertex_t, pos );
+
+      attribute_descriptions[1].binding = 0;
+      attribute_descriptions[1].location = 2;
+      attribute_descriptions[1].format = VK_FORMAT_R16G16_UNORM;
+      attribute_descriptions[1].offset = offsetof( packed_vertex_t, texCoord );
+
+      return attribute_descriptions;
+   }
+};
+
+static_assert( sizeof( packed_vertex_t ) == 12 );
+
+// Maps a normalised snorm position back to model space: pos = snorm * scale + offset
+struct vertex_quantization_t
+{
+   glm::vec3 scale{ 1.0f };
+   glm::vec3 offset{ 0.0f };
+};
+
+auto make_vertex_quantization(
+   const mesh_bounds_t& bounds )
+   -> vertex_quantization_t;
+
+// The packed layout drops the colour and clamps texture coordinates to [0, 1]
+auto can_pack_vertices(
+   std::span<const Vertex> vertices )
+   -> bool;
+
+void pack_vertices(
+   std::span<const Vertex> vertices,
+   const vertex_quantization_t& quantization,
+   std::vector<packed_vertex_t>& packed );
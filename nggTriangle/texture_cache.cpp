@@ -0,0 +1,476 @@
+#include "texture_cache.h"
+#include "hash_utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+namespace
+{
+constexpr std::array<uint8_t, 12> ktx2_identifier{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+constexpr std::string_view writer_key = "KTXwriter";
+constexpr std::string_view writer_name = "nggTriangle texture cooker";
+constexpr std::string_view source_key = "NGGsource";
+constexpr std::string_view version_key = "NGGversion";
+
+struct ktx2_header_t
+{
+   std::array<uint8_t, 12> identifier;
+   uint32_t vk_format;
+   uint32_t type_size;
+   uint32_t pixel_width;
+   uint32_t pixel_height;
+   uint32_t pixel_depth;
+   uint32_t layer_count;
+   uint32_t face_count;
+   uint32_t level_count;
+   uint32_t supercompression_scheme;
+   uint32_t dfd_byte_offset;
+   uint32_t dfd_byte_length;
+   uint32_t kvd_byte_offset;
+   uint32_t kvd_byte_length;
+   uint64_t sgd_byte_offset;
+   uint64_t sgd_byte_length;
+};
+
+struct ktx2_level_t
+{
+   uint64_t byte_offset;
+   uint64_t byte_length;
+   uint64_t uncompressed_byte_length;
+};
+
+// Value of the source_key entry
+struct source_stamp_t
+{
+   uint64_t size;
+   int64_t mtime;
+   uint64_t hash;
+};
+
+static_assert( sizeof( ktx2_header_t ) == 80 );
+static_assert( sizeof( ktx2_level_t ) == 24 );
+static_assert( std::is_trivially_copyable_v<source_stamp_t> );
+
+auto align_up(
+   uint64_t value,
+   uint64_t alignment )
+   -> uint64_t
+{
+   return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+// Levels start at multiples of the block size and of 4, as KTX2 and vkCmdCopyBufferToImage require
+auto level_alignment(
+   VkFormat format )
+   -> uint64_t
+{
+   return std::lcm( uint64_t{ texture_block_bytes( format ) }, uint64_t{ 4 } );
+}
+
+auto stamp_source(
+   const std::filesystem::path& source_path )
+   -> source_stamp_t
+{
+   mapped_file_t source( source_path );
+
+   return {
+      .size = std::filesystem::file_size( source_path ),
+      .mtime = static_cast<int64_t>( std::filesystem::last_write_time( source_path ).time_since_epoch().count() ),
+      .hash = hash_utils::hash_bytes( source.data() ) };
+}
+
+// Basic data format descriptor, see the Khronos Data Format Specification 1.3
+auto build_dfd(
+   VkFormat format )
+   -> std::vector<uint32_t>
+{
+   constexpr uint32_t model_rgbsda = 1;
+   constexpr uint32_t model_bc1a = 128;
+   constexpr uint32_t model_bc7 = 134;
+   constexpr uint32_t primaries_bt709 = 1;
+   constexpr uint32_t transfer_srgb = 2;
+   constexpr uint32_t channel_alpha_linear = 15 | 0x10;
+
+   uint32_t color_model = model_rgbsda;
+   std::vector<std::array<uint32_t, 4>> samples;
+
+   switch ( format )
+   {
+   case VK_FORMAT_R8G8B8A8_SRGB:
+      for ( uint32_t channel = 0;
+            channel < 3;
+            ++channel )
+      {
+         samples.push_back( { channel * 8 | 7u << 16 | channel << 24, 0, 0, 255 } );
+      }
+      samples.push_back( { 24 | 7u << 16 | channel_alpha_linear << 24, 0, 0, 255 } );
+      break;
+   case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      color_model = model_bc1a;
+      samples.push_back( { 63u << 16, 0, 0, 0xffffffffu } );
+      break;
+   case VK_FORMAT_BC7_SRGB_BLOCK:
+      color_model = model_bc7;
+      samples.push_back( { 127u << 16, 0, 0, 0xffffffffu } );
+      break;
+   default:
+      throw std::runtime_error( "unsupported texture cache format!" );
+   }
+
+   uint32_t block_extent = texture_block_extent( format ) - 1;
+   auto block_size = static_cast<uint32_t>( 24 + 16 * samples.size() );
+
+   std::vector<uint32_t> dfd{
+      4 + block_size,
+      0,
+      2 | block_size << 16,
+      color_model | primaries_bt709 << 8 | transfer_srgb << 16,
+      block_extent | block_extent << 8,
+      texture_block_bytes( format ),
+      0 };
+
+   for ( const auto& sample : samples )
+   {
+      dfd.insert( dfd.end(), sample.begin(), sample.end() );
+   }
+
+   return dfd;
+}
+
+void append_key_value(
+   std::vector<std::byte>& kvd,
+   std::string_view key,
+   std::span<const std::byte> value )
+{
+   auto length = static_cast<uint32_t>( key.size() + 1 + value.size() );
+
+   auto length_bytes = std::as_bytes( std::span( &length, 1 ) );
+   kvd.insert( kvd.end(), length_bytes.begin(), length_bytes.end() );
+
+   auto key_bytes = std::as_bytes( std::span( key ) );
+   kvd.insert( kvd.end(), key_bytes.begin(), key_bytes.end() );
+   kvd.push_back( std::byte{ 0 } );
+   kvd.insert( kvd.end(), value.begin(), value.end() );
+
+   kvd.resize( align_up( kvd.size(), 4 ) );
+}
+
+auto find_key_value(
+   std::span<const std::byte> kvd,
+   std::string_view key )
+   -> std::span<const std::byte>
+{
+   size_t offset = 0;
+   while ( offset + sizeof( uint32_t ) <= kvd.size() )
+   {
+      uint32_t length;
+      std::memcpy( &length, kvd.data() + offset, sizeof( length ) );
+      offset += sizeof( length );
+
+      if ( length > kvd.size() - offset )
+      {
+         break;
+      }
+
+      auto entry = kvd.subspan( offset, length );
+      if ( entry.size() > key.size() && std::memcmp( entry.data(), key.data(), key.size() ) == 0 &&
+           entry[key.size()] == std::byte{ 0 } )
+      {
+         return entry.subspan( key.size() + 1 );
+      }
+
+      offset = static_cast<size_t>( align_up( offset + length, 4 ) );
+   }
+
+   return {};
+}
+}   // namespace
+
+auto is_cacheable_texture_format(
+   VkFormat format )
+   -> bool
+{
+   return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+          format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+auto texture_block_bytes(
+   VkFormat format )
+   -> uint32_t
+{
+   switch ( format )
+   {
+   case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      return 8;
+   case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+   default:
+      return 4;
+   }
+}
+
+auto texture_block_extent(
+   VkFormat format )
+   -> uint32_t
+{
+   return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK ? 4 : 1;
+}
+
+auto layout_texture_levels(
+   VkFormat format,
+   uint32_t width,
+   uint32_t height,
+   uint32_t level_count )
+   -> std::vector<texture_level_t>
+{
+   std::vector<texture_level_t> levels( level_count );
+
+   uint32_t extent = texture_block_extent( format );
+   uint64_t offset = 0;
+
+   for ( uint32_t level = level_count;
+         level-- > 0; )
+   {
+      uint32_t level_width = std::max( 1u, width >> level );
+      uint32_t level_height = std::max( 1u, height >> level );
+      uint64_t blocks = uint64_t{ ( level_width + extent - 1 ) / extent } * ( ( level_height + extent - 1 ) / extent );
+
+      offset = align_up( offset, level_alignment( format ) );
+      levels[level] = {
+         .offset = offset,
+         .size = blocks * texture_block_bytes( format ),
+         .width = level_width,
+         .height = level_height };
+
+      offset += levels[level].size;
+   }
+
+   return levels;
+}
+
+auto texture_cache_t::open(
+   const std::filesystem::path& cache_path,
+   const std::filesystem::path& source_path )
+   -> std::optional<texture_cache_t>
+{
+   std::error_code error;
+   if ( !std::filesystem::exists( cache_path, error ) || !std::filesystem::exists( source_path, error ) )
+   {
+      return std::nullopt;
+   }
+
+   mapped_file_t file( cache_path );
+
+   // Moving the mapping keeps its address, so the views stay valid
+   auto cache = open( file.data() );
+   if ( !cache.has_value() )
+   {
+      return std::nullopt;
+   }
+
+   auto bytes = file.data();
+   cache->file = std::move( file );
+
+   ktx2_header_t header;
+   std::memcpy( &header, bytes.data(), sizeof( header ) );
+
+   // A cache without the source stamp cannot be checked, so it is treated as stale
+   auto stamp_bytes =
+      find_key_value( bytes.subspan( header.kvd_byte_offset, header.kvd_byte_length ), source_key );
+
+   if ( stamp_bytes.size() != sizeof( source_stamp_t ) )
+   {
+      return std::nullopt;
+   }
+
+   source_stamp_t stamp;
+   std::memcpy( &stamp, stamp_bytes.data(), sizeof( stamp ) );
+
+   // Size and mtime are the fast path, the content hash catches touched but unchanged sources
+   if ( stamp.size != std::filesystem::file_size( source_path ) )
+   {
+      return std::nullopt;
+   }
+
+   if ( stamp.mtime !=
+           static_cast<int64_t>( std::filesystem::last_write_time( source_path ).time_since_epoch().count() ) &&
+        stamp.hash != stamp_source( source_path ).hash )
+   {
+      return std::nullopt;
+   }
+
+   return cache;
+}
+
+auto texture_cache_t::open(
+   std::span<const std::byte> bytes )
+   -> std::optional<texture_cache_t>
+{
+   if ( bytes.size() < sizeof( ktx2_header_t ) )
+   {
+      return std::nullopt;
+   }
+
+   ktx2_header_t header;
+   std::memcpy( &header, bytes.data(), sizeof( header ) );
+
+   auto format = static_cast<VkFormat>( header.vk_format );
+
+   // Only plain 2D textures in the formats the cooker writes
+   if ( header.identifier != ktx2_identifier || !is_cacheable_texture_format( format ) ||
+        header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth != 0 || header.layer_count != 0 ||
+        header.face_count != 1 || header.supercompression_scheme != 0 || header.level_count == 0 ||
+        header.level_count > 32 )
+   {
+      return std::nullopt;
+   }
+
+   uint64_t level_index_end = sizeof( ktx2_header_t ) + uint64_t{ header.level_count } * sizeof( ktx2_level_t );
+   if ( level_index_end > bytes.size() || uint64_t{ header.kvd_byte_offset } + header.kvd_byte_length > bytes.size() )
+   {
+      return std::nullopt;
+   }
+
+   // Caches cooked by an older version are stale, wherever they are read from
+   auto version_bytes =
+      find_key_value( bytes.subspan( header.kvd_byte_offset, header.kvd_byte_length ), version_key );
+
+   if ( version_bytes.size() != sizeof( uint32_t ) )
+   {
+      return std::nullopt;
+   }
+
+   uint32_t cache_version;
+   std::memcpy( &cache_version, version_bytes.data(), sizeof( cache_version ) );
+
+   if ( cache_version != version )
+   {
+      return std::nullopt;
+   }
+
+   texture_cache_t cache;
+
+   std::vector<ktx2_level_t> level_index( header.level_count );
+   std::memcpy( level_index.data(), bytes.data() + sizeof( ktx2_header_t ), level_index.size() * sizeof( ktx2_level_t ) );
+
+   auto expected = layout_texture_levels( format, header.pixel_width, header.pixel_height, header.level_count );
+
+   uint64_t data_begin = bytes.size();
+   uint64_t data_end = 0;
+   for ( const auto& level : level_index )
+   {
+      data_begin = std::min( data_begin, level.byte_offset );
+      data_end = std::max( data_end, level.byte_offset + level.byte_length );
+   }
+
+   if ( data_end > bytes.size() || data_begin < level_index_end || data_begin % level_alignment( format ) != 0 )
+   {
+      return std::nullopt;
+   }
+
+   cache.levels = std::move( expected );
+   for ( size_t level = 0;
+         level < level_index.size();
+         ++level )
+   {
+      if ( level_index[level].byte_length != cache.levels[level].size ||
+           level_index[level].byte_offset % level_alignment( format ) != 0 )
+      {
+         return std::nullopt;
+      }
+
+      cache.levels[level].offset = level_index[level].byte_offset - data_begin;
+   }
+
+   cache.format = format;
+   cache.width = header.pixel_width;
+   cache.height = header.pixel_height;
+   cache.level_data = bytes.subspan( static_cast<size_t>( data_begin ), static_cast<size_t>( data_end - data_begin ) );
+
+   return cache;
+}
+
+void texture_cache_t::write(
+   const std::filesystem::path& cache_path,
+   const std::filesystem::path& source_path,
+   const texture_view_t& texture )
+{
+   if ( !is_cacheable_texture_format( texture.format ) || texture.levels.empty() )
+   {
+      throw std::runtime_error( "unsupported texture cache format!" );
+   }
+
+   auto dfd = build_dfd( texture.format );
+   auto stamp = stamp_source( source_path );
+
+   // Keys are sorted as KTX2 requires
+   std::vector<std::byte> kvd;
+   append_key_value( kvd, writer_key, std::as_bytes( std::span( writer_name.data(), writer_name.size() + 1 ) ) );
+   append_key_value( kvd, source_key, std::as_bytes( std::span( &stamp, 1 ) ) );
+   append_key_value( kvd, version_key, std::as_bytes( std::span( &version, 1 ) ) );
+
+   ktx2_header_t header{};
+   header.identifier = ktx2_identifier;
+   header.vk_format = static_cast<uint32_t>( texture.format );
+   header.type_size = 1;
+   header.pixel_width = texture.width;
+   header.pixel_height = texture.height;
+   header.face_count = 1;
+   header.level_count = static_cast<uint32_t>( texture.levels.size() );
+   header.dfd_byte_offset = static_cast<uint32_t>( sizeof( header ) + texture.levels.size() * sizeof( ktx2_level_t ) );
+   header.dfd_byte_length = static_cast<uint32_t>( dfd.size() * sizeof( uint32_t ) );
+   header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+   header.kvd_byte_length = static_cast<uint32_t>( kvd.size() );
+
+   uint64_t data_offset = align_up( header.kvd_byte_offset + header.kvd_byte_length, level_alignment( texture.format ) );
+
+   std::vector<ktx2_level_t> level_index;
+   for ( const auto& level : texture.levels )
+   {
+      level_index.push_back( {
+         .byte_offset = data_offset + level.offset,
+         .byte_length = level.size,
+         .uncompressed_byte_length = level.size } );
+   }
+
+   // Write to a temporary file first so a crash never leaves a truncated cache behind
+   auto temp_path = cache_path;
+   temp_path += ".tmp";
+
+   {
+      std::ofstream out( temp_path, std::ios::binary | std::ios::trunc );
+      if ( !out.is_open() )
+      {
+         throw std::runtime_error( "failed to create texture cache!" );
+      }
+
+      std::array<char, 16> padding{};
+
+      auto write_bytes =
+         [&]( const void* data, uint64_t size )
+         {
+            out.write( static_cast<const char*>( data ), static_cast<std::streamsize>( size ) );
+         };
+
+      write_bytes( &header, sizeof( header ) );
+      write_bytes( level_index.data(), level_index.size() * sizeof( ktx2_level_t ) );
+      write_bytes( dfd.data(), header.dfd_byte_length );
+      write_bytes( kvd.data(), kvd.size() );
+      write_bytes( padding.data(), data_offset - ( header.kvd_byte_offset + header.kvd_byte_length ) );
+      write_bytes( texture.data.data(), texture.data.size() );
+
+      if ( !out.good() )
+      {
+         throw std::runtime_error( "failed to write texture cache!" );
+      }
+   }
+
+   std::filesystem::rename( temp_path, cache_path );
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// One mip level of a texture. offset is relative to the start of the level data, so
+// the whole chain is copied to a staging buffer in one go and offset is the
+// bufferOffset of the level's copy region.
+struct texture_level_t
+{
+   uint64_t offset;
+   uint64_t size;
+   uint32_t width;
+   uint32_t height;
+};
+
+// A texture ready for upload: every mip level in its final GPU format
+struct texture_view_t
+{
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   std::span<const texture_level_t> levels;
+   std::span<const std::byte> data;
+};
+
+// R8G8B8A8_SRGB, BC1_RGB_SRGB_BLOCK and BC7_SRGB_BLOCK
+auto is_cacheable_texture_format(
+   VkFormat format )
+   -> bool;
+
+// Bytes of a texel block and its width and height in texels
+auto texture_block_bytes(
+   VkFormat format )
+   -> uint32_t;
+auto texture_block_extent(
+   VkFormat format )
+   -> uint32_t;
+
+// Level sizes and offsets for a full chain as laid out in the cache: smallest level
+// first, each aligned for vkCmdCopyBufferToImage.
+auto layout_texture_levels(
+   VkFormat format,
+   uint32_t width,
+   uint32_t height,
+   uint32_t level_count )
+   -> std::vector<texture_level_t>;
+
+// KTX2 file holding a cooked texture with its full mip chain. A key/value entry
+// records the source image, so a cache is rejected once the source changes. The
+// file is memory-mapped and the level data read in place.
+class texture_cache_t
+{
+public:
+   // Raised whenever the mip filter, the block encoders or the file layout change what
+   // is cooked, so older caches are cooked again
+   static constexpr uint32_t version = 1;
+
+   // Returns the cache if it exists, is well formed and still matches the source image.
+   static
+   auto open(
+      const std::filesystem::path& cache_path,
+      const std::filesystem::path& source_path )
+      -> std::optional<texture_cache_t>;
+
+   // Reads a cache held in memory that outlives it, e.g. an asset archive entry,
+   // without checking its source
+   static
+   auto open(
+      std::span<const std::byte> bytes )
+      -> std::optional<texture_cache_t>;
+
+   static
+   void write(
+      const std::filesystem::path& cache_path,
+      const std::filesystem::path& source_path,
+      const texture_view_t& texture );
+
+   auto view() const
+      -> texture_view_t
+   {
+      return { format, width, height, levels, level_data };
+   }
+
+private:
+   texture_cache_t() = default;
+
+   mapped_file_t file;
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   std::vector<texture_level_t> levels;
+   std::span<const std::byte> level_data;
+};
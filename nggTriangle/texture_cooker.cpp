@@ -0,0 +1,200 @@
+#include "texture_cooker.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+// A source image mapped for stb_image, which then reads the file without a heap copy
+struct encoded_image_t
+{
+   mapped_file_t file;
+   const stbi_uc* bytes;
+   int size;
+};
+
+auto open_encoded_image(
+   const std::filesystem::path& source_path )
+   -> encoded_image_t
+{
+   mapped_file_t file( source_path );
+   auto encoded = file.data();
+
+   if ( encoded.size() > static_cast<size_t>( std::numeric_limits<int>::max() ) )
+   {
+      throw std::runtime_error( "texture image too large!" );
+   }
+
+   const auto* bytes = reinterpret_cast<const stbi_uc*>( encoded.data() );
+   return { std::move( file ), bytes, static_cast<int>( encoded.size() ) };
+}
+
+auto read_layout(
+   const encoded_image_t& image,
+   VkFormat format )
+   -> texture_layout_t
+{
+   if ( format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_BC1_RGB_SRGB_BLOCK && format != VK_FORMAT_BC7_SRGB_BLOCK )
+   {
+      throw std::runtime_error( "texture format not supported by the cooker!" );
+   }
+
+   int width, height, channels;
+   if ( !stbi_info_from_memory( image.bytes, image.size, &width, &height, &channels ) )
+   {
+      throw std::runtime_error( "failed to read texture image header!" );
+   }
+
+   texture_layout_t layout;
+   layout.format = format;
+   layout.width = static_cast<uint32_t>( width );
+   layout.height = static_cast<uint32_t>( height );
+
+   auto level_count = static_cast<uint32_t>( std::bit_width( std::max( layout.width, layout.height ) ) );
+   layout.levels = layout_texture_levels( format, layout.width, layout.height, level_count );
+
+   return layout;
+}
+}   // namespace
+
+auto cook_texture(
+   const std::filesystem::path& source_path,
+   VkFormat format,
+   mip_filter_t filter,
+   bc_quality_t quality )
+   -> cooked_texture_t
+{
+   cooked_texture_t texture;
+
+   auto layout =
+      cook_texture_into(
+         source_path,
+         format,
+         [&]( size_t size )
+         {
+            texture.data.resize( size );
+            return std::span( texture.data );
+         },
+         filter,
+         quality );
+
+   texture.format = layout.format;
+   texture.width = layout.width;
+   texture.height = layout.height;
+   texture.levels = std::move( layout.levels );
+
+   return texture;
+}
+
+auto read_texture_layout(
+   const std::filesystem::path& source_path,
+   VkFormat format )
+   -> texture_layout_t
+{
+   return read_layout( open_encoded_image( source_path ), format );
+}
+
+auto cook_texture_into(
+   const std::filesystem::path& source_path,
+   VkFormat format,
+   const texture_allocator_t& allocate,
+   mip_filter_t filter,
+   bc_quality_t quality )
+   -> texture_layout_t
+{
+   auto source = open_encoded_image( source_path );
+   auto layout = read_layout( source, format );
+
+   bool block_compressed = format != VK_FORMAT_R8G8B8A8_SRGB;
+   auto level_count = static_cast<uint32_t>( layout.levels.size() );
+
+   auto data_size = layout.data_size();
+   auto target = allocate( data_size );
+
+   if ( target.size() < data_size )
+   {
+      throw std::runtime_error( "texture allocation too small!" );
+   }
+
+   // Mips are always filtered in RGBA8: in place in target, or for BC formats in a
+   // scratch chain that is block compressed level by level afterwards
+   std::vector<std::byte> scratch;
+   std::vector<texture_level_t> rgba_levels;
+   std::span<std::byte> rgba;
+
+   if ( block_compressed )
+   {
+      rgba_levels = layout_texture_levels( VK_FORMAT_R8G8B8A8_SRGB, layout.width, layout.height, level_count );
+      scratch.resize( static_cast<size_t>( rgba_levels[0].offset + rgba_levels[0].size ) );
+      rgba = scratch;
+   }
+   else
+   {
+      rgba_levels = layout.levels;
+      rgba = target;
+   }
+
+   // stb_image only decodes into its own allocation; it is freed before the mips are built
+   int width, height, channels;
+   stbi_uc* pixels = stbi_load_from_memory( source.bytes, source.size, &width, &height, &channels, STBI_rgb_alpha );
+
+   if ( !pixels )
+   {
+      throw std::runtime_error( "failed to load texture image!" );
+   }
+
+   std::memcpy( rgba.data() + rgba_levels[0].offset, pixels, static_cast<size_t>( rgba_levels[0].size ) );
+   stbi_image_free( pixels );
+   source.file.close();
+
+   generate_mip_chain( rgba, rgba_levels, filter, true );
+
+   if ( block_compressed )
+   {
+      for ( size_t level = 0;
+            level < rgba_levels.size();
+            ++level )
+      {
+         const auto& source_level = rgba_levels[level];
+         const auto& target_level = layout.levels[level];
+
+         encode_bc_level(
+            format,
+            rgba.subspan( static_cast<size_t>( source_level.offset ), static_cast<size_t>( source_level.size ) ),
+            source_level.width,
+            source_level.height,
+            quality,
+            target.subspan( static_cast<size_t>( target_level.offset ), static_cast<size_t>( target_level.size ) ) );
+      }
+   }
+
+   return layout;
+}
+
+auto benchmark_texture_encoder(
+   const std::filesystem::path& source_path )
+   -> std::vector<bc_benchmark_t>
+{
+   int width, height, channels;
+   std::unique_ptr<stbi_uc, decltype( &stbi_image_free )> pixels(
+      stbi_load( source_path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha ),
+      &stbi_image_free );
+
+   if ( !pixels )
+   {
+      throw std::runtime_error( "failed to load texture image!" );
+   }
+
+   size_t size = static_cast<size_t>( width ) * static_cast<size_t>( height ) * 4;
+
+   return benchmark_bc_encoder(
+      std::as_bytes( std::span( pixels.get(), size ) ),
+      static_cast<uint32_t>( width ),
+      static_cast<uint32_t>( height ) );
+}
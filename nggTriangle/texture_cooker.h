@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bc_encoder.h"
+#include "mip_generator.h"
+#include "texture_cache.h"
+
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+// Format, size and levels of a cooked texture whose level data lives in memory the
+// caller handed out
+struct texture_layout_t
+{
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   std::vector<texture_level_t> levels;
+
+   // Level 0 sits at the end of the data, see layout_texture_levels()
+   auto data_size() const
+      -> size_t
+   {
+      return levels.empty() ? 0 : static_cast<size_t>( levels[0].offset + levels[0].size );
+   }
+
+   auto view(
+      std::span<const std::byte> data ) const
+      -> texture_view_t
+   {
+      return { format, width, height, levels, data };
+   }
+};
+
+// Returns memory for size bytes of level data
+using texture_allocator_t = std::function<std::span<std::byte>( size_t size )>;
+
+// A texture cooked in memory, laid out like the level data of a texture cache
+struct cooked_texture_t
+{
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   std::vector<texture_level_t> levels;
+   std::vector<std::byte> data;
+
+   auto view() const
+      -> texture_view_t
+   {
+      return { format, width, height, levels, data };
+   }
+};
+
+// Decodes the source image and builds its full mip chain in format, which has to be
+// one of the texture cache formats. Levels are filtered on the CPU in linear space;
+// for BC formats every level is then block compressed at the given quality.
+auto cook_texture(
+   const std::filesystem::path& source_path,
+   VkFormat format,
+   mip_filter_t filter = mip_filter_t::kaiser,
+   bc_quality_t quality = bc_quality_t::normal )
+   -> cooked_texture_t;
+
+// Format, size and levels cook_texture_into() produces, from the image header alone
+auto read_texture_layout(
+   const std::filesystem::path& source_path,
+   VkFormat format )
+   -> texture_layout_t;
+
+// Cooks like cook_texture(), but reads only the image header before calling allocate
+// and writes the level data straight into the memory it returns, e.g. a mapped
+// staging buffer. RGBA8 mips are filtered in place there, so that memory is read
+// back and should be host cached.
+auto cook_texture_into(
+   const std::filesystem::path& source_path,
+   VkFormat format,
+   const texture_allocator_t& allocate,
+   mip_filter_t filter = mip_filter_t::kaiser,
+   bc_quality_t quality = bc_quality_t::normal )
+   -> texture_layout_t;
+
+// Runs benchmark_bc_encoder() on the decoded source image
+auto benchmark_texture_encoder(
+   const std::filesystem::path& source_path )
+   -> std::vector<bc_benchmark_t>;
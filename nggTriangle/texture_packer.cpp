@@ -0,0 +1,284 @@
+#include "texture_packer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+namespace
+{
+auto align_up(
+   uint32_t value,
+   uint32_t alignment )
+   -> uint32_t
+{
+   return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+struct atlas_cell_t
+{
+   size_t texture;
+   uint32_t width;
+   uint32_t height;
+   uint32_t page{ 0 };
+   uint32_t x{ 0 };
+   uint32_t y{ 0 };
+};
+
+// Fills pages of extent x extent texels shelf by shelf with cells sorted tallest first,
+// returns the number of pages used
+auto shelf_pack(
+   std::span<atlas_cell_t> cells,
+   uint32_t extent )
+   -> uint32_t
+{
+   uint32_t page = 0;
+   uint32_t x = 0;
+   uint32_t y = 0;
+   uint32_t shelf_height = 0;
+
+   for ( auto& cell : cells )
+   {
+      if ( x + cell.width > extent )
+      {
+         y += shelf_height;
+         x = 0;
+         shelf_height = 0;
+      }
+
+      if ( y + cell.height > extent )
+      {
+         ++page;
+         x = 0;
+         y = 0;
+         shelf_height = 0;
+      }
+
+      cell.page = page;
+      cell.x = x;
+      cell.y = y;
+
+      x += cell.width;
+      shelf_height = std::max( shelf_height, cell.height );
+   }
+
+   return cells.empty() ? 0 : page + 1;
+}
+}   // namespace
+
+auto texture_pack_t::remap(
+   size_t texture ) const
+   -> texture_remap_t
+{
+   const auto& placement = placements.at( texture );
+   const auto& array = arrays.at( placement.array );
+
+   texture_remap_t remap;
+   remap.layer = placement.layer;
+
+   if ( !array.atlas )
+   {
+      return remap;
+   }
+
+   auto width = static_cast<float>( array.width );
+   auto height = static_cast<float>( array.height );
+   auto x = static_cast<float>( placement.x );
+   auto y = static_cast<float>( placement.y );
+   auto w = static_cast<float>( placement.width );
+   auto h = static_cast<float>( placement.height );
+
+   remap.transform = { w / width, h / height, x / width, y / height };
+   remap.bounds = { ( x + 0.5f ) / width, ( y + 0.5f ) / height, ( x + w - 0.5f ) / width, ( y + h - 0.5f ) / height };
+
+   return remap;
+}
+
+auto texture_pack_t::regions(
+   size_t texture,
+   std::span<const texture_level_t> levels ) const
+   -> std::vector<texture_region_t>
+{
+   const auto& placement = placements.at( texture );
+   const auto& array = arrays.at( placement.array );
+
+   if ( levels.size() < placement.mip_levels )
+   {
+      throw std::runtime_error( "packed texture is missing levels!" );
+   }
+
+   uint32_t block = texture_block_extent( array.format );
+
+   std::vector<texture_region_t> regions;
+   regions.reserve( placement.mip_levels );
+
+   for ( uint32_t level = 0;
+         level < placement.mip_levels;
+         ++level )
+   {
+      texture_region_t region{};
+      region.buffer_offset = levels[level].offset;
+      region.level = level;
+      region.layer = placement.layer;
+      region.x = placement.x >> level;
+      region.y = placement.y >> level;
+
+      // A partial block may only be copied where it ends at the image edge
+      uint32_t level_width = std::max( array.width >> level, 1u );
+      uint32_t level_height = std::max( array.height >> level, 1u );
+      region.width = std::min( align_up( levels[level].width, block ), level_width - region.x );
+      region.height = std::min( align_up( levels[level].height, block ), level_height - region.y );
+
+      regions.push_back( region );
+   }
+
+   return regions;
+}
+
+auto plan_texture_packing(
+   std::span<const packable_texture_t> textures,
+   const texture_pack_options_t& options )
+   -> texture_pack_t
+{
+   texture_pack_t pack;
+   pack.placements.resize( textures.size() );
+
+   std::map<VkFormat, std::vector<size_t>> atlas_groups;
+   std::map<std::tuple<VkFormat, uint32_t, uint32_t, uint32_t>, std::vector<size_t>> layer_groups;
+
+   for ( size_t i = 0;
+         i < textures.size();
+         ++i )
+   {
+      const auto& texture = textures[i];
+
+      bool small = texture.width <= options.atlas_max_extent && texture.height <= options.atlas_max_extent;
+      if ( small && options.atlas_mip_levels > 0 && texture.mip_levels >= options.atlas_mip_levels )
+      {
+         atlas_groups[texture.format].push_back( i );
+      }
+      else
+      {
+         layer_groups[{ texture.format, texture.width, texture.height, texture.mip_levels }].push_back( i );
+      }
+   }
+
+   for ( auto group = atlas_groups.begin();
+         group != atlas_groups.end(); )
+   {
+      if ( group->second.size() == 1 )
+      {
+         const auto& texture = textures[group->second.front()];
+         layer_groups[{ texture.format, texture.width, texture.height, texture.mip_levels }].push_back(
+            group->second.front() );
+         group = atlas_groups.erase( group );
+      }
+      else
+      {
+         ++group;
+      }
+   }
+
+   for ( const auto& [key, members] : layer_groups )
+   {
+      const auto& [format, width, height, mip_levels] = key;
+
+      for ( size_t first = 0;
+            first < members.size();
+            first += options.max_layers )
+      {
+         size_t count = std::min<size_t>( members.size() - first, options.max_layers );
+         auto array = static_cast<uint32_t>( pack.arrays.size() );
+
+         pack.arrays.push_back( { format, width, height, mip_levels, static_cast<uint32_t>( count ), false } );
+
+         for ( size_t layer = 0;
+               layer < count;
+               ++layer )
+         {
+            pack.placements[members[first + layer]] =
+               { array, static_cast<uint32_t>( layer ), 0, 0, width, height, mip_levels };
+         }
+      }
+   }
+
+   for ( const auto& [format, members] : atlas_groups )
+   {
+      // Cell corners are block aligned in every kept level
+      uint32_t alignment = texture_block_extent( format ) << ( options.atlas_mip_levels - 1 );
+
+      std::vector<atlas_cell_t> cells;
+      uint64_t area = 0;
+      uint32_t largest = 0;
+
+      for ( size_t i : members )
+      {
+         uint32_t width = align_up( textures[i].width, alignment );
+         uint32_t height = align_up( textures[i].height, alignment );
+
+         cells.push_back( { i, width, height } );
+         area += uint64_t{ width } * height;
+         largest = std::max( { largest, width, height } );
+      }
+
+      if ( largest > options.atlas_extent )
+      {
+         throw std::runtime_error( "atlas texture larger than an atlas page!" );
+      }
+
+      std::stable_sort(
+         cells.begin(),
+         cells.end(),
+         []( const atlas_cell_t& a, const atlas_cell_t& b )
+         {
+            return a.height != b.height ? a.height > b.height : a.width > b.width;
+         } );
+
+      // Smallest power of two page that takes everything, else as many full pages as needed
+      auto side = static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>( area ) ) ) );
+      uint32_t extent = std::min( std::bit_ceil( std::max( side, largest ) ), options.atlas_extent );
+      uint32_t pages = shelf_pack( cells, extent );
+
+      while ( pages > 1 && extent < options.atlas_extent )
+      {
+         extent = std::min( extent * 2, options.atlas_extent );
+         pages = shelf_pack( cells, extent );
+      }
+
+      // Pages are trimmed to the space actually used
+      uint32_t used_width = 0;
+      uint32_t used_height = 0;
+      for ( const auto& cell : cells )
+      {
+         used_width = std::max( used_width, cell.x + cell.width );
+         used_height = std::max( used_height, cell.y + cell.height );
+      }
+
+      auto first_array = static_cast<uint32_t>( pack.arrays.size() );
+
+      for ( uint32_t first = 0;
+            first < pages;
+            first += options.max_layers )
+      {
+         pack.arrays.push_back(
+            { format, used_width, used_height, options.atlas_mip_levels, std::min( pages - first, options.max_layers ), true } );
+      }
+
+      for ( const auto& cell : cells )
+      {
+         const auto& texture = textures[cell.texture];
+         pack.placements[cell.texture] = {
+            first_array + cell.page / options.max_layers,
+            cell.page % options.max_layers,
+            cell.x,
+            cell.y,
+            texture.width,
+            texture.height,
+            options.atlas_mip_levels };
+      }
+   }
+
+   return pack;
+}
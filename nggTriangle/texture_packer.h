@@ -0,0 +1,105 @@
+#pragma once
+
+#include "texture_cache.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// What the packer needs to know of a texture
+struct packable_texture_t
+{
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   uint32_t mip_levels{ 0 };
+};
+
+struct texture_pack_options_t
+{
+   // Textures at most this wide and high share atlas pages instead of taking a layer each
+   uint32_t atlas_max_extent{ 256 };
+   uint32_t atlas_extent{ 2048 };
+   // Levels kept in an atlas. Cells are aligned so every level stays block aligned,
+   // and textures with fewer levels get a layer of their own.
+   uint32_t atlas_mip_levels{ 4 };
+   // maxImageArrayLayers is at least 256 on every device
+   uint32_t max_layers{ 256 };
+};
+
+// A 2D array image to create: either one texture per layer, all of the same format,
+// size and level count, or atlas pages each holding several small textures
+struct texture_array_desc_t
+{
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   uint32_t mip_levels{ 0 };
+   uint32_t layer_count{ 0 };
+   bool atlas{ false };
+};
+
+// Where a texture landed: a layer of an array and its texel rectangle in level 0.
+// Its first mip_levels levels are copied, at offsets shifted down with the level.
+struct texture_placement_t
+{
+   uint32_t array{ 0 };
+   uint32_t layer{ 0 };
+   uint32_t x{ 0 };
+   uint32_t y{ 0 };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   uint32_t mip_levels{ 0 };
+};
+
+// Maps a texture's own coordinates into its array layer, as the fragment shader applies
+// it: fract( uv ) * transform.xy + transform.zw, clamped to bounds.xy .. bounds.zw.
+// Atlas bounds stay half a texel inside the rectangle so neighbours do not bleed in
+// at level 0.
+struct texture_remap_t
+{
+   std::array<float, 4> transform{ 1.0f, 1.0f, 0.0f, 0.0f };
+   std::array<float, 4> bounds{ 0.0f, 0.0f, 1.0f, 1.0f };
+   uint32_t layer{ 0 };
+};
+
+// One level of a packed texture copied into its array
+struct texture_region_t
+{
+   uint64_t buffer_offset;
+   uint32_t level;
+   uint32_t layer;
+   uint32_t x;
+   uint32_t y;
+   uint32_t width;
+   uint32_t height;
+};
+
+struct texture_pack_t
+{
+   std::vector<texture_array_desc_t> arrays;
+   // Indexed like the textures handed to plan_texture_packing()
+   std::vector<texture_placement_t> placements;
+
+   auto remap(
+      size_t texture ) const
+      -> texture_remap_t;
+
+   // Copy regions for the texture's levels, level offsets relative to its level data.
+   // Extents are rounded up to whole blocks, which the level data holds anyway.
+   auto regions(
+      size_t texture,
+      std::span<const texture_level_t> levels ) const
+      -> std::vector<texture_region_t>;
+};
+
+// Groups textures of the same format, size and level count into array layers and
+// shelf packs small ones into atlas pages, so one descriptor per array covers them.
+// A format with a single small texture gets a plain layer rather than an atlas.
+auto plan_texture_packing(
+   std::span<const packable_texture_t> textures,
+   const texture_pack_options_t& options = {} )
+   -> texture_pack_t;
@@ -0,0 +1,150 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+thread_pool_t::thread_pool_t(
+   size_t thread_count )
+{
+   workers.reserve( thread_count );
+
+   for ( size_t i = 0;
+         i < thread_count;
+         ++i )
+   {
+      workers.emplace_back( [this]() { worker_loop(); } );
+   }
+}
+
+thread_pool_t::~thread_pool_t()
+{
+   {
+      std::lock_guard lock( tasks_mutex );
+      stopping = true;
+   }
+
+   tasks_available.notify_all();
+
+   for ( auto& worker : workers )
+   {
+      worker.join();
+   }
+}
+
+auto thread_pool_t::shared()
+   -> thread_pool_t&
+{
+   static thread_pool_t pool;
+   return pool;
+}
+
+void thread_pool_t::enqueue(
+   std::function<void()> task )
+{
+   {
+      std::lock_guard lock( tasks_mutex );
+      tasks.push_back( std::move( task ) );
+   }
+
+   tasks_available.notify_one();
+}
+
+void thread_pool_t::worker_loop()
+{
+   for ( ;; )
+   {
+      std::function<void()> task;
+
+      {
+         std::unique_lock lock( tasks_mutex );
+         tasks_available.wait( lock, [this]() { return stopping || !tasks.empty(); } );
+
+         if ( stopping && tasks.empty() )
+         {
+            return;
+         }
+
+         task = std::move( tasks.front() );
+         tasks.pop_front();
+      }
+
+      task();
+   }
+}
+
+void thread_pool_t::parallel_for(
+   size_t count,
+   const std::function<void( size_t )>& body )
+{
+   if ( count == 0 )
+   {
+      return;
+   }
+
+   // Shared so helpers that only start after the loop finished still see valid state
+   struct loop_state_t
+   {
+      std::function<void( size_t )> body;
+      size_t count;
+      std::atomic<size_t> next{ 0 };
+      std::atomic<size_t> done{ 0 };
+      std::mutex mutex;
+      std::condition_variable finished;
+      std::exception_ptr error;
+   };
+
+   auto state = std::make_shared<loop_state_t>();
+   state->body = body;
+   state->count = count;
+
+   auto run =
+      [state]()
+      {
+         for ( ;; )
+         {
+            size_t i = state->next.fetch_add( 1 );
+            if ( i >= state->count )
+            {
+               return;
+            }
+
+            try
+            {
+               state->body( i );
+            }
+            catch ( ... )
+            {
+               std::lock_guard lock( state->mutex );
+               if ( !state->error )
+               {
+                  state->error = std::current_exception();
+               }
+            }
+
+            if ( state->done.fetch_add( 1 ) + 1 == state->count )
+            {
+               std::lock_guard lock( state->mutex );
+               state->finished.notify_all();
+            }
+         }
+      };
+
+   size_t helpers = std::min( count - 1, size() );
+   for ( size_t i = 0;
+         i < helpers;
+         ++i )
+   {
+      enqueue( run );
+   }
+
+   run();
+
+   std::unique_lock lock( state->mutex );
+   state->finished.wait( lock, [&]() { return state->done.load() == state->count; } );
+
+   if ( state->error )
+   {
+      std::rethrow_exception( state->error );
+   }
+}
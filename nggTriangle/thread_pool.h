@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size worker pool used by the asset import code.
+class thread_pool_t
+{
+public:
+   explicit thread_pool_t(
+      size_t thread_count = std::max( 1u, std::thread::hardware_concurrency() ) );
+
+   thread_pool_t(
+      const thread_pool_t& ) = delete;
+
+   auto operator=(
+      const thread_pool_t& )
+      -> thread_pool_t& = delete;
+
+   ~thread_pool_t();
+
+   // Process wide pool shared by the importers
+   static
+   auto shared()
+      -> thread_pool_t&;
+
+   auto size() const
+      -> size_t
+   {
+      return workers.size();
+   }
+
+   template <typename Task>
+   auto submit(
+      Task&& task )
+      -> std::future<std::invoke_result_t<Task>>
+   {
+      using result_t = std::invoke_result_t<Task>;
+
+      auto packaged = std::make_shared<std::packaged_task<result_t()>>( std::forward<Task>( task ) );
+      auto future = packaged->get_future();
+
+      enqueue( [packaged]() { ( *packaged )(); } );
+
+      return future;
+   }
+
+   // Runs body( i ) for every i in [0, count) and waits for all of them. The calling
+   // thread takes part, so this is safe to call from inside a pool task. The first
+   // exception thrown by body is rethrown here.
+   void parallel_for(
+      size_t count,
+      const std::function<void( size_t )>& body );
+
+private:
+   void enqueue(
+      std::function<void()> task );
+
+   void worker_loop();
+
+   std::vector<std::thread> workers;
+   std::deque<std::function<void()>> tasks;
+   std::mutex tasks_mutex;
+   std::condition_variable tasks_available;
+   bool stopping{ false };
+};
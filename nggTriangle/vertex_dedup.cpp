@@ -0,0 +1,206 @@
+#include "vertex_dedup.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+vertex_dedup_t::vertex_dedup_t(
+   std::vector<Vertex>& vertices,
+   size_t index_count )
+   : vertices( vertices )
+{
+   // Keeps the load factor at or below 2/3 even if no vertex is shared
+   size_t capacity = std::bit_ceil( std::max<size_t>( 16, index_count + index_count / 2 ) );
+
+   slots.assign( capacity, slot_t{ 0, empty_slot } );
+   mask = capacity - 1;
+}
+
+namespace
+{
+// Below this the serial table is faster than distributing the work
+constexpr size_t parallel_threshold = size_t{ 1 } << 16;
+
+constexpr unsigned shard_bits = 6;
+constexpr size_t shard_count = size_t{ 1 } << shard_bits;
+
+void deduplicate_vertices_serial(
+   const tinyobj::attrib_t& attrib,
+   const std::vector<tinyobj::shape_t>& shapes,
+   size_t index_count,
+   std::vector<Vertex>& vertices,
+   std::vector<uint32_t>& indices )
+{
+   indices.reserve( index_count );
+   vertex_dedup_t unique_vertices( vertices, index_count );
+
+   for ( const auto& shape : shapes )
+   {
+      for ( const auto& index : shape.mesh.indices )
+      {
+         indices.push_back( unique_vertices.insert( make_vertex( attrib, index ) ) );
+      }
+   }
+}
+}   // namespace
+
+void deduplicate_vertices(
+   const tinyobj::attrib_t& attrib,
+   const std::vector<tinyobj::shape_t>& shapes,
+   std::vector<Vertex>& vertices,
+   std::vector<uint32_t>& indices,
+   thread_pool_t& pool )
+{
+   vertices.clear();
+   indices.clear();
+
+   size_t index_count = 0;
+   for ( const auto& shape : shapes )
+   {
+      index_count += shape.mesh.indices.size();
+   }
+
+   if ( index_count >= UINT32_MAX )
+   {
+      throw std::runtime_error( "mesh has too many indices!" );
+   }
+
+   if ( index_count < parallel_threshold || pool.size() < 2 )
+   {
+      deduplicate_vertices_serial( attrib, shapes, index_count, vertices, indices );
+      return;
+   }
+
+   std::vector<tinyobj::index_t> obj_indices;
+   obj_indices.reserve( index_count );
+   for ( const auto& shape : shapes )
+   {
+      obj_indices.insert( obj_indices.end(), shape.mesh.indices.begin(), shape.mesh.indices.end() );
+   }
+
+   size_t range_count = pool.size() * 4;
+   size_t range_size = ( index_count + range_count - 1 ) / range_count;
+
+   auto range_begin = [&]( size_t range ) { return std::min( range * range_size, index_count ); };
+   auto range_end = [&]( size_t range ) { return std::min( ( range + 1 ) * range_size, index_count ); };
+
+   // Expand and hash every index, bucketing positions by the top hash bits
+   std::vector<Vertex> expanded( index_count );
+   std::vector<uint64_t> hashes( index_count );
+   std::vector<std::array<std::vector<uint32_t>, shard_count>> shard_positions( range_count );
+
+   pool.parallel_for(
+      range_count,
+      [&]( size_t range )
+      {
+         auto& buckets = shard_positions[range];
+         for ( auto& bucket : buckets )
+         {
+            bucket.reserve( range_size / shard_count * 2 );
+         }
+
+         for ( size_t position = range_begin( range );
+               position < range_end( range );
+               ++position )
+         {
+            expanded[position] = make_vertex( attrib, obj_indices[position] );
+            hashes[position] = hash_vertex( expanded[position] );
+            buckets[hashes[position] >> ( 64 - shard_bits )].push_back( static_cast<uint32_t>( position ) );
+         }
+      } );
+
+   // Identical vertices always land in the same shard. Walking the ranges in order
+   // visits each shard's positions in ascending order, so the first position seen
+   // for a vertex is its first use in the whole mesh.
+   std::vector<uint32_t> first_use( index_count );
+
+   pool.parallel_for(
+      shard_count,
+      [&]( size_t shard )
+      {
+         size_t shard_size = 0;
+         for ( const auto& buckets : shard_positions )
+         {
+            shard_size += buckets[shard].size();
+         }
+
+         std::vector<Vertex> shard_vertices;
+         std::vector<uint32_t> shard_first_use;
+         vertex_dedup_t unique_vertices( shard_vertices, shard_size );
+
+         for ( const auto& buckets : shard_positions )
+         {
+            for ( uint32_t position : buckets[shard] )
+            {
+               uint32_t local = unique_vertices.insert( expanded[position], hashes[position] );
+               if ( local == shard_first_use.size() )
+               {
+                  shard_first_use.push_back( position );
+               }
+               first_use[position] = shard_first_use[local];
+            }
+         }
+      } );
+
+   // Number the unique vertices in first use order with a prefix sum over the ranges
+   std::vector<uint32_t> range_base( range_count );
+
+   pool.parallel_for(
+      range_count,
+      [&]( size_t range )
+      {
+         uint32_t unique_count = 0;
+         for ( size_t position = range_begin( range );
+               position < range_end( range );
+               ++position )
+         {
+            unique_count += first_use[position] == position ? 1 : 0;
+         }
+         range_base[range] = unique_count;
+      } );
+
+   uint32_t unique_total = 0;
+   for ( auto& base : range_base )
+   {
+      uint32_t unique_count = base;
+      base = unique_total;
+      unique_total += unique_count;
+   }
+
+   vertices.resize( unique_total );
+   indices.resize( index_count );
+
+   pool.parallel_for(
+      range_count,
+      [&]( size_t range )
+      {
+         uint32_t next = range_base[range];
+         for ( size_t position = range_begin( range );
+               position < range_end( range );
+               ++position )
+         {
+            if ( first_use[position] == position )
+            {
+               vertices[next] = expanded[position];
+               indices[position] = next++;
+            }
+         }
+      } );
+
+   // Every other position copies the index given to its first use, which was written above
+   pool.parallel_for(
+      range_count,
+      [&]( size_t range )
+      {
+         for ( size_t position = range_begin( range );
+               position < range_end( range );
+               ++position )
+         {
+            if ( first_use[position] != position )
+            {
+               indices[position] = indices[first_use[position]];
+            }
+         }
+      } );
+}
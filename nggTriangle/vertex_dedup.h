@@ -0,0 +1,137 @@
+#pragma once
+
+#include "hash_utils.h"
+#include "mesh_types.h"
+#include "thread_pool.h"
+
+#include <cstring>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+static_assert( sizeof( Vertex ) == 32, "Vertex is hashed as raw bytes and must not contain padding" );
+
+inline auto make_vertex(
+   const tinyobj::attrib_t& attrib,
+   const tinyobj::index_t& index )
+   -> Vertex
+{
+   Vertex vertex{};
+
+   vertex.pos = {
+      attrib.vertices[3 * index.vertex_index + 0],
+      attrib.vertices[3 * index.vertex_index + 1],
+      attrib.vertices[3 * index.vertex_index + 2] };
+
+   vertex.texCoord = {
+      attrib.texcoords[2 * index.texcoord_index + 0],
+      1.0f - attrib.texcoords[2 * index.texcoord_index + 1] };
+
+   vertex.color = { 1.0f, 1.0f, 1.0f };
+
+   return vertex;
+}
+
+inline auto hash_vertex(
+   const Vertex& vertex )
+   -> uint64_t
+{
+   return hash_utils::hash_bytes( &vertex, sizeof( vertex ) );
+}
+
+// Flat open-addressing table that deduplicates vertices by their raw bytes.
+// Slots hold an index into the output vertex array plus the high hash bits,
+// so most mismatches are rejected without touching the vertex itself.
+class vertex_dedup_t
+{
+public:
+   // Sized for the worst case of every index referencing a new vertex
+   vertex_dedup_t(
+      std::vector<Vertex>& vertices,
+      size_t index_count );
+
+   // Returns the index of vertex, appending it to the vertex array if it is new
+   auto insert(
+      const Vertex& vertex )
+      -> uint32_t
+   {
+      return insert( vertex, hash_vertex( vertex ) );
+   }
+
+   auto insert(
+      const Vertex& vertex,
+      uint64_t hash )
+      -> uint32_t
+   {
+      auto tag = static_cast<uint32_t>( hash >> 32 );
+      size_t slot = static_cast<size_t>( hash ) & mask;
+
+      ++lookups;
+
+      for ( ;; )
+      {
+         auto& entry = slots[slot];
+
+         if ( entry.index == empty_slot )
+         {
+            entry.tag = tag;
+            entry.index = static_cast<uint32_t>( vertices.size() );
+            vertices.push_back( vertex );
+            return entry.index;
+         }
+
+         if ( entry.tag == tag && std::memcmp( &vertices[entry.index], &vertex, sizeof( Vertex ) ) == 0 )
+         {
+            return entry.index;
+         }
+
+         ++collisions;
+         slot = ( slot + 1 ) & mask;
+      }
+   }
+
+   auto capacity() const
+      -> size_t
+   {
+      return slots.size();
+   }
+
+   // Number of extra slots visited because of hash collisions
+   auto collision_count() const
+      -> size_t
+   {
+      return collisions;
+   }
+
+   auto lookup_count() const
+      -> size_t
+   {
+      return lookups;
+   }
+
+private:
+   static constexpr uint32_t empty_slot = UINT32_MAX;
+
+   struct slot_t
+   {
+      uint32_t tag;
+      uint32_t index;
+   };
+
+   std::vector<Vertex>& vertices;
+   std::vector<slot_t> slots;
+   size_t mask{ 0 };
+   size_t lookups{ 0 };
+   size_t collisions{ 0 };
+};
+
+// Builds the deduplicated vertex and index arrays for all shapes, in shape order.
+// Large meshes are hashed into shards on the pool and each shard is deduplicated
+// independently. Unique vertices are numbered by their first use, so the result is
+// identical to inserting every index into a vertex_dedup_t one after the other.
+void deduplicate_vertices(
+   const tinyobj::attrib_t& attrib,
+   const std::vector<tinyobj::shape_t>& shapes,
+   std::vector<Vertex>& vertices,
+   std::vector<uint32_t>& indices,
+   thread_pool_t& pool = thread_pool_t::shared() );
@@ -0,0 +1,585 @@
+#include "virtual_texture.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::array<char, 4> virtual_texture_magic{ 'N', 'G', 'V', 'T' };
+constexpr uint32_t virtual_texture_version = 1;
+
+struct virtual_texture_header_t
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+   uint32_t vk_format;
+   uint32_t width;
+   uint32_t height;
+   uint32_t level_count;
+   uint32_t page_size;
+   uint32_t page_border;
+   uint64_t page_bytes;
+   uint64_t data_offset;
+};
+
+struct virtual_texture_level_t
+{
+   uint32_t pages_x;
+   uint32_t pages_y;
+   uint64_t first_page;
+};
+
+static_assert( sizeof( virtual_texture_header_t ) == 48 );
+static_assert( sizeof( virtual_texture_level_t ) == 16 );
+
+// Pages start at multiples of this, as vkCmdCopyBufferToImage wants for every format
+constexpr uint64_t page_alignment = 16;
+
+auto pages_for(
+   uint32_t extent,
+   uint32_t level )
+   -> uint32_t
+{
+   uint64_t level_page = uint64_t{ virtual_page_size } << level;
+   return static_cast<uint32_t>( ( extent + level_page - 1 ) / level_page );
+}
+
+auto page_bytes_of(
+   VkFormat format )
+   -> uint64_t
+{
+   uint64_t blocks = virtual_page_slot_size / texture_block_extent( format );
+   return blocks * blocks * texture_block_bytes( format );
+}
+}   // namespace
+
+virtual_texture_file_t::virtual_texture_file_t(
+   const std::filesystem::path& path )
+   : file( path )
+{
+   auto bytes = file.data();
+
+   virtual_texture_header_t header;
+   if ( bytes.size() < sizeof( header ) )
+   {
+      throw std::runtime_error( "virtual texture file truncated!" );
+   }
+
+   std::memcpy( &header, bytes.data(), sizeof( header ) );
+
+   texture_format = static_cast<VkFormat>( header.vk_format );
+
+   if ( header.magic != virtual_texture_magic || header.version != virtual_texture_version ||
+        !is_cacheable_texture_format( texture_format ) || header.page_size != virtual_page_size ||
+        header.page_border != virtual_page_border || header.page_bytes != page_bytes_of( texture_format ) ||
+        header.level_count == 0 || header.level_count > 32 )
+   {
+      throw std::runtime_error( "not a virtual texture file!" );
+   }
+
+   texture_width = header.width;
+   texture_height = header.height;
+   page_size = static_cast<size_t>( header.page_bytes );
+
+   uint64_t level_table_end = sizeof( header ) + uint64_t{ header.level_count } * sizeof( virtual_texture_level_t );
+   if ( level_table_end > bytes.size() || header.data_offset > bytes.size() )
+   {
+      throw std::runtime_error( "virtual texture file truncated!" );
+   }
+
+   uint64_t page_count = 0;
+   for ( uint32_t level = 0;
+         level < header.level_count;
+         ++level )
+   {
+      virtual_texture_level_t entry;
+      std::memcpy(
+         &entry,
+         bytes.data() + sizeof( header ) + level * sizeof( virtual_texture_level_t ),
+         sizeof( entry ) );
+
+      if ( entry.pages_x != pages_for( texture_width, level ) || entry.pages_y != pages_for( texture_height, level ) ||
+           entry.first_page != page_count )
+      {
+         throw std::runtime_error( "virtual texture level table corrupt!" );
+      }
+
+      levels.push_back( { entry.pages_x, entry.pages_y, entry.first_page } );
+      page_count += uint64_t{ entry.pages_x } * entry.pages_y;
+   }
+
+   if ( header.data_offset + page_count * page_size > bytes.size() )
+   {
+      throw std::runtime_error( "virtual texture file truncated!" );
+   }
+
+   page_data = bytes.subspan( static_cast<size_t>( header.data_offset ), static_cast<size_t>( page_count * page_size ) );
+}
+
+auto virtual_texture_file_t::page(
+   const virtual_page_t& page ) const
+   -> std::span<const std::byte>
+{
+   const auto& level = levels.at( page.level );
+   uint64_t index = level.first_page + uint64_t{ page.y } * level.pages_x + page.x;
+
+   return page_data.subspan( static_cast<size_t>( index * page_size ), page_size );
+}
+
+void virtual_texture_file_t::cook(
+   const std::filesystem::path& source_path,
+   const std::filesystem::path& output_path,
+   VkFormat format,
+   mip_filter_t filter,
+   bc_quality_t quality )
+{
+   if ( !is_cacheable_texture_format( format ) )
+   {
+      throw std::runtime_error( "texture format not supported by the cooker!" );
+   }
+
+   int source_width, source_height, channels;
+   std::unique_ptr<stbi_uc, decltype( &stbi_image_free )> pixels(
+      stbi_load( source_path.string().c_str(), &source_width, &source_height, &channels, STBI_rgb_alpha ),
+      &stbi_image_free );
+
+   if ( !pixels )
+   {
+      throw std::runtime_error( "failed to load texture image!" );
+   }
+
+   auto width = static_cast<uint32_t>( source_width );
+   auto height = static_cast<uint32_t>( source_height );
+
+   uint32_t level_count = 1;
+   while ( pages_for( width, level_count - 1 ) > 1 || pages_for( height, level_count - 1 ) > 1 )
+   {
+      ++level_count;
+   }
+
+   // The whole chain is filtered in RGBA8 first, pages are cut from it level by level
+   auto rgba_levels = layout_texture_levels( VK_FORMAT_R8G8B8A8_SRGB, width, height, level_count );
+   std::vector<std::byte> rgba( static_cast<size_t>( rgba_levels[0].offset + rgba_levels[0].size ) );
+
+   std::memcpy( rgba.data() + rgba_levels[0].offset, pixels.get(), static_cast<size_t>( rgba_levels[0].size ) );
+   pixels.reset();
+
+   generate_mip_chain( rgba, rgba_levels, filter, true );
+
+   virtual_texture_header_t header{};
+   header.magic = virtual_texture_magic;
+   header.version = virtual_texture_version;
+   header.vk_format = static_cast<uint32_t>( format );
+   header.width = width;
+   header.height = height;
+   header.level_count = level_count;
+   header.page_size = virtual_page_size;
+   header.page_border = virtual_page_border;
+   header.page_bytes = page_bytes_of( format );
+
+   std::vector<virtual_texture_level_t> level_table;
+   uint64_t page_count = 0;
+
+   for ( uint32_t level = 0;
+         level < level_count;
+         ++level )
+   {
+      level_table.push_back( { pages_for( width, level ), pages_for( height, level ), page_count } );
+      page_count += uint64_t{ level_table.back().pages_x } * level_table.back().pages_y;
+   }
+
+   uint64_t table_end = sizeof( header ) + level_table.size() * sizeof( virtual_texture_level_t );
+   header.data_offset = ( table_end + page_alignment - 1 ) / page_alignment * page_alignment;
+
+   auto temp_path = output_path;
+   temp_path += ".tmp";
+
+   {
+      std::ofstream out( temp_path, std::ios::binary | std::ios::trunc );
+      if ( !out.is_open() )
+      {
+         throw std::runtime_error( "failed to create virtual texture file!" );
+      }
+
+      std::array<char, page_alignment> padding{};
+
+      auto write_bytes =
+         [&]( const void* data, uint64_t size )
+         {
+            out.write( static_cast<const char*>( data ), static_cast<std::streamsize>( size ) );
+         };
+
+      write_bytes( &header, sizeof( header ) );
+      write_bytes( level_table.data(), level_table.size() * sizeof( virtual_texture_level_t ) );
+      write_bytes( padding.data(), header.data_offset - table_end );
+
+      std::vector<std::byte> pages;
+
+      for ( uint32_t level = 0;
+            level < level_count;
+            ++level )
+      {
+         const auto& source_level = rgba_levels[level];
+         const auto& entry = level_table[level];
+         const auto* source = rgba.data() + source_level.offset;
+
+         // Virtual texel t of this level covers the same uv range as texel t << level of
+         // level 0; odd sizes make the stored level slightly smaller, so it is rescaled
+         double scale_x = static_cast<double>( source_level.width ) * std::exp2( level ) / width;
+         double scale_y = static_cast<double>( source_level.height ) * std::exp2( level ) / height;
+
+         auto source_texel =
+            []( int64_t virtual_texel, double scale, uint32_t extent )
+            {
+               auto texel = static_cast<int64_t>( std::floor( ( static_cast<double>( virtual_texel ) + 0.5 ) * scale ) );
+               return static_cast<uint32_t>( std::clamp<int64_t>( texel, 0, int64_t{ extent } - 1 ) );
+            };
+
+         size_t level_pages = size_t{ entry.pages_x } * entry.pages_y;
+         pages.assign( level_pages * header.page_bytes, std::byte{ 0 } );
+
+         thread_pool_t::shared().parallel_for(
+            level_pages,
+            [&]( size_t index )
+            {
+               auto page_x = static_cast<int64_t>( index % entry.pages_x );
+               auto page_y = static_cast<int64_t>( index / entry.pages_x );
+
+               std::vector<std::byte> tile( size_t{ virtual_page_slot_size } * virtual_page_slot_size * 4 );
+
+               for ( uint32_t y = 0;
+                     y < virtual_page_slot_size;
+                     ++y )
+               {
+                  int64_t virtual_y = page_y * virtual_page_size + y - virtual_page_border;
+                  uint32_t row = source_texel( virtual_y, scale_y, source_level.height );
+
+                  for ( uint32_t x = 0;
+                        x < virtual_page_slot_size;
+                        ++x )
+                  {
+                     int64_t virtual_x = page_x * virtual_page_size + x - virtual_page_border;
+                     uint32_t column = source_texel( virtual_x, scale_x, source_level.width );
+
+                     std::memcpy(
+                        tile.data() + ( size_t{ y } * virtual_page_slot_size + x ) * 4,
+                        source + ( size_t{ row } * source_level.width + column ) * 4,
+                        4 );
+                  }
+               }
+
+               auto target = std::span( pages ).subspan( index * header.page_bytes, header.page_bytes );
+
+               if ( format == VK_FORMAT_R8G8B8A8_SRGB )
+               {
+                  std::memcpy( target.data(), tile.data(), target.size() );
+               }
+               else
+               {
+                  encode_bc_level( format, tile, virtual_page_slot_size, virtual_page_slot_size, quality, target );
+               }
+            } );
+
+         write_bytes( pages.data(), pages.size() );
+      }
+
+      if ( !out.good() )
+      {
+         throw std::runtime_error( "failed to write virtual texture file!" );
+      }
+   }
+
+   std::filesystem::rename( temp_path, output_path );
+}
+
+virtual_texture_cache_t::virtual_texture_cache_t(
+   const virtual_texture_file_t& file,
+   uint32_t slots_x,
+   uint32_t slots_y )
+   : file( file ),
+     slots_x( slots_x ),
+     slots_y( slots_y )
+{
+   // Slot coordinates are stored in 8 bits of a page table texel
+   if ( slots_x == 0 || slots_y == 0 || slots_x > 256 || slots_y > 256 )
+   {
+      throw std::runtime_error( "invalid virtual texture cache size!" );
+   }
+
+   uint32_t page_count = 0;
+   for ( uint32_t level = 0;
+         level < file.level_count();
+         ++level )
+   {
+      level_offsets.push_back( page_count );
+      page_count += file.pages_x( level ) * file.pages_y( level );
+   }
+
+   page_slots.assign( page_count, no_slot );
+
+   slots.resize( size_t{ slots_x } * slots_y );
+   for ( uint32_t slot = 0;
+         slot < slots.size();
+         ++slot )
+   {
+      slots[slot].lru_position = lru.insert( lru.end(), slot );
+   }
+
+   layer_size = size_t{ file.pages_x( 0 ) } * file.pages_y( 0 );
+   table.assign( layer_size * file.level_count(), 0 );
+   dirty_levels.assign( file.level_count(), true );
+}
+
+auto virtual_texture_cache_t::page_index(
+   const virtual_page_t& page ) const
+   -> uint32_t
+{
+   return level_offsets[page.level] + page.y * file.pages_x( page.level ) + page.x;
+}
+
+auto virtual_texture_cache_t::page_of(
+   uint32_t index ) const
+   -> virtual_page_t
+{
+   auto level = static_cast<uint32_t>( std::upper_bound( level_offsets.begin(), level_offsets.end(), index ) - level_offsets.begin() - 1 );
+   uint32_t offset = index - level_offsets[level];
+
+   return { level, offset % file.pages_x( level ), offset / file.pages_x( level ) };
+}
+
+void virtual_texture_cache_t::touch(
+   uint32_t slot )
+{
+   slots[slot].last_used = frame;
+
+   // The pinned page's slot is not in the list
+   if ( slots[slot].lru_position != lru.end() )
+   {
+      lru.splice( lru.begin(), lru, slots[slot].lru_position );
+   }
+}
+
+auto virtual_texture_cache_t::allocate_slot()
+   -> uint32_t
+{
+   if ( lru.empty() )
+   {
+      return no_slot;
+   }
+
+   uint32_t slot = lru.back();
+   auto& victim = slots[slot];
+
+   // Every slot holds a page needed this frame; the rest waits for the next one
+   if ( victim.page != no_page && victim.last_used == frame )
+   {
+      return no_slot;
+   }
+
+   if ( victim.page != no_page )
+   {
+      page_slots[victim.page] = no_slot;
+      ++stats.evictions;
+   }
+
+   return slot;
+}
+
+auto virtual_texture_cache_t::update(
+   std::span<const uint32_t> feedback,
+   uint32_t max_uploads )
+   -> std::vector<virtual_page_upload_t>
+{
+   ++frame;
+   auto now = clock_t::now();
+
+   // Feedback repeats pages many times over; each counts once per frame
+   std::vector<uint32_t> requested;
+   for ( uint32_t id : feedback )
+   {
+      if ( id == invalid_virtual_page )
+      {
+         continue;
+      }
+
+      auto page = virtual_page_t::unpack( id );
+      if ( page.level < file.level_count() && page.x < file.pages_x( page.level ) && page.y < file.pages_y( page.level ) )
+      {
+         requested.push_back( page_index( page ) );
+      }
+   }
+
+   std::sort( requested.begin(), requested.end() );
+   requested.erase( std::unique( requested.begin(), requested.end() ), requested.end() );
+
+   std::unordered_map<uint32_t, clock_t::time_point> still_waiting;
+   std::vector<uint32_t> missing;
+
+   uint32_t top_level = file.level_count() - 1;
+   uint32_t top_page = level_offsets[top_level];
+
+   if ( page_slots[top_page] == no_slot )
+   {
+      missing.push_back( top_page );
+   }
+
+   for ( uint32_t index : requested )
+   {
+      ++stats.requests;
+
+      if ( page_slots[index] != no_slot )
+      {
+         ++stats.hits;
+         touch( page_slots[index] );
+         continue;
+      }
+
+      auto waiting_since = waiting.find( index );
+      still_waiting[index] = waiting_since != waiting.end() ? waiting_since->second : now;
+
+      // Coarser pages on the way up are loaded too, so the fallback sharpens step by step
+      auto page = page_of( index );
+      for ( ;; )
+      {
+         uint32_t page_index_at_level = page_index( page );
+         if ( page_slots[page_index_at_level] != no_slot )
+         {
+            touch( page_slots[page_index_at_level] );
+            break;
+         }
+
+         missing.push_back( page_index_at_level );
+
+         if ( page.level == top_level )
+         {
+            break;
+         }
+
+         page = { page.level + 1, page.x / 2, page.y / 2 };
+      }
+   }
+
+   // Higher indices are coarser levels, which are loaded first
+   std::sort( missing.begin(), missing.end(), std::greater<>() );
+   missing.erase( std::unique( missing.begin(), missing.end() ), missing.end() );
+
+   std::vector<virtual_page_upload_t> uploads;
+
+   for ( uint32_t index : missing )
+   {
+      if ( uploads.size() >= max_uploads )
+      {
+         break;
+      }
+
+      uint32_t slot = allocate_slot();
+      if ( slot == no_slot )
+      {
+         break;
+      }
+
+      slots[slot].page = index;
+      page_slots[index] = slot;
+      touch( slot );
+
+      if ( index == top_page )
+      {
+         lru.erase( slots[slot].lru_position );
+         slots[slot].lru_position = lru.end();
+      }
+
+      uploads.push_back( { page_of( index ), slot % slots_x, slot / slots_x } );
+
+      ++stats.uploads;
+      stats.uploaded_bytes += file.page_bytes();
+
+      auto waited = still_waiting.find( index );
+      if ( waited != still_waiting.end() )
+      {
+         double latency_ms = std::chrono::duration<double, std::milli>( now - waited->second ).count();
+         stats.latency_total_ms += latency_ms;
+         stats.latency_max_ms = std::max( stats.latency_max_ms, latency_ms );
+         ++stats.latency_count;
+
+         still_waiting.erase( waited );
+      }
+   }
+
+   waiting = std::move( still_waiting );
+
+   if ( !uploads.empty() )
+   {
+      rebuild_page_table();
+   }
+
+   return uploads;
+}
+
+void virtual_texture_cache_t::rebuild_page_table()
+{
+   // Coarse to fine, so a missing page takes the entry its parent already has
+   for ( uint32_t level = file.level_count();
+         level-- > 0; )
+   {
+      uint32_t* layer = table.data() + level * layer_size;
+      bool changed = false;
+
+      for ( uint32_t y = 0;
+            y < file.pages_y( level );
+            ++y )
+      {
+         for ( uint32_t x = 0;
+               x < file.pages_x( level );
+               ++x )
+         {
+            uint32_t slot = page_slots[page_index( { level, x, y } )];
+            uint32_t entry = 0;
+
+            if ( slot != no_slot )
+            {
+               entry = ( slot % slots_x ) | ( ( slot / slots_x ) << 8 ) | ( level << 16 ) | 0xFF000000u;
+            }
+            else if ( level + 1 < file.level_count() )
+            {
+               entry = table[( level + 1 ) * layer_size + ( y / 2 ) * file.pages_x( 0 ) + x / 2];
+            }
+
+            uint32_t& texel = layer[y * file.pages_x( 0 ) + x];
+            changed = changed || texel != entry;
+            texel = entry;
+         }
+      }
+
+      if ( changed )
+      {
+         dirty_levels[level] = true;
+      }
+   }
+}
+
+auto virtual_texture_cache_t::take_dirty_levels()
+   -> std::vector<uint32_t>
+{
+   std::vector<uint32_t> levels;
+   for ( uint32_t level = 0;
+         level < dirty_levels.size();
+         ++level )
+   {
+      if ( dirty_levels[level] )
+      {
+         levels.push_back( level );
+         dirty_levels[level] = false;
+      }
+   }
+
+   return levels;
+}
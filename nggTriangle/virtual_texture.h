@@ -0,0 +1,260 @@
+#pragma once
+
+#include "bc_encoder.h"
+#include "mapped_file.h"
+#include "mip_generator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Pages cover virtual_page_size texels square and carry a border copied from their
+// neighbours, so bilinear filtering inside a cache slot never reads another page
+constexpr uint32_t virtual_page_size = 128;
+constexpr uint32_t virtual_page_border = 4;
+constexpr uint32_t virtual_page_slot_size = virtual_page_size + 2 * virtual_page_border;
+
+// Feedback texels nothing was drawn to
+constexpr uint32_t invalid_virtual_page = 0xFFFFFFFF;
+
+// A page of one level. packed() is the id the feedback pass writes.
+struct virtual_page_t
+{
+   uint32_t level;
+   uint32_t x;
+   uint32_t y;
+
+   auto packed() const
+      -> uint32_t
+   {
+      return ( level << 24 ) | ( y << 12 ) | x;
+   }
+
+   static
+   auto unpack(
+      uint32_t id )
+      -> virtual_page_t
+   {
+      return { id >> 24, ( id >> 12 ) & 0xFFF, id & 0xFFF };
+   }
+};
+
+// Tiled texture file: every level cut into pages, each stored with its border in the
+// final GPU format, so a page is uploaded straight from the memory mapping. Levels go
+// down to the first one that fits in a single page.
+class virtual_texture_file_t
+{
+public:
+   explicit virtual_texture_file_t(
+      const std::filesystem::path& path );
+
+   // Decodes the source, filters its mip chain like cook_texture() and writes every page,
+   // block compressed for BC formats
+   static
+   void cook(
+      const std::filesystem::path& source_path,
+      const std::filesystem::path& output_path,
+      VkFormat format,
+      mip_filter_t filter = mip_filter_t::kaiser,
+      bc_quality_t quality = bc_quality_t::normal );
+
+   auto format() const
+      -> VkFormat
+   {
+      return texture_format;
+   }
+
+   auto width() const
+      -> uint32_t
+   {
+      return texture_width;
+   }
+
+   auto height() const
+      -> uint32_t
+   {
+      return texture_height;
+   }
+
+   auto level_count() const
+      -> uint32_t
+   {
+      return static_cast<uint32_t>( levels.size() );
+   }
+
+   auto pages_x(
+      uint32_t level ) const
+      -> uint32_t
+   {
+      return levels[level].pages_x;
+   }
+
+   auto pages_y(
+      uint32_t level ) const
+      -> uint32_t
+   {
+      return levels[level].pages_y;
+   }
+
+   // Bytes of one page with its border
+   auto page_bytes() const
+      -> size_t
+   {
+      return page_size;
+   }
+
+   auto page(
+      const virtual_page_t& page ) const
+      -> std::span<const std::byte>;
+
+private:
+   struct level_t
+   {
+      uint32_t pages_x;
+      uint32_t pages_y;
+      uint64_t first_page;
+   };
+
+   mapped_file_t file;
+   VkFormat texture_format{ VK_FORMAT_UNDEFINED };
+   uint32_t texture_width{ 0 };
+   uint32_t texture_height{ 0 };
+   size_t page_size{ 0 };
+   std::vector<level_t> levels;
+   std::span<const std::byte> page_data;
+};
+
+// A page to copy into its cache slot this frame
+struct virtual_page_upload_t
+{
+   virtual_page_t page;
+   uint32_t slot_x;
+   uint32_t slot_y;
+};
+
+struct virtual_texture_stats_t
+{
+   // Distinct pages requested per frame, summed, and how many of them were resident
+   uint64_t requests{ 0 };
+   uint64_t hits{ 0 };
+   uint64_t uploads{ 0 };
+   uint64_t evictions{ 0 };
+   uint64_t uploaded_bytes{ 0 };
+   // Popping latency: from the first frame a visible page was missing until its upload
+   double latency_total_ms{ 0.0 };
+   double latency_max_ms{ 0.0 };
+   uint64_t latency_count{ 0 };
+
+   auto hit_rate() const
+      -> double
+   {
+      return requests ? static_cast<double>( hits ) / static_cast<double>( requests ) : 1.0;
+   }
+
+   auto average_latency_ms() const
+      -> double
+   {
+      return latency_count ? latency_total_ms / static_cast<double>( latency_count ) : 0.0;
+   }
+};
+
+// Residency of a virtual texture in a cache of slots_x x slots_y page slots. Feedback
+// decides which pages are loaded, least recently used pages are evicted for them and
+// the page table maps every page to the finest resident page covering it. The single
+// page of the coarsest level is never evicted, so every lookup finds something.
+class virtual_texture_cache_t
+{
+public:
+   virtual_texture_cache_t(
+      const virtual_texture_file_t& file,
+      uint32_t slots_x,
+      uint32_t slots_y );
+
+   // Takes one frame of feedback and returns at most max_uploads pages to copy, coarse
+   // levels first. The page table already points at their slots, so the copies have to
+   // land before the next draw that reads it.
+   auto update(
+      std::span<const uint32_t> feedback,
+      uint32_t max_uploads )
+      -> std::vector<virtual_page_upload_t>;
+
+   // One layer of pages_x( 0 ) x pages_y( 0 ) texels per level, each texel packing slot
+   // column, slot row and level of the resident page as R8G8B8A8_UINT
+   auto page_table() const
+      -> std::span<const uint32_t>
+   {
+      return table;
+   }
+
+   auto page_table_layer_size() const
+      -> size_t
+   {
+      return layer_size;
+   }
+
+   // Levels whose page table layer changed since the last call
+   auto take_dirty_levels()
+      -> std::vector<uint32_t>;
+
+   auto statistics() const
+      -> const virtual_texture_stats_t&
+   {
+      return stats;
+   }
+
+   void reset_statistics()
+   {
+      stats = {};
+   }
+
+private:
+   using clock_t = std::chrono::steady_clock;
+
+   static constexpr uint32_t no_page = 0xFFFFFFFF;
+   static constexpr uint32_t no_slot = 0xFFFFFFFF;
+
+   struct slot_t
+   {
+      uint32_t page{ no_page };
+      uint64_t last_used{ 0 };
+      std::list<uint32_t>::iterator lru_position;
+   };
+
+   auto page_index(
+      const virtual_page_t& page ) const
+      -> uint32_t;
+   auto page_of(
+      uint32_t index ) const
+      -> virtual_page_t;
+   void touch(
+      uint32_t slot );
+   auto allocate_slot()
+      -> uint32_t;
+   void rebuild_page_table();
+
+   const virtual_texture_file_t& file;
+   uint32_t slots_x;
+   uint32_t slots_y;
+   uint64_t frame{ 0 };
+
+   std::vector<uint32_t> level_offsets;
+   std::vector<uint32_t> page_slots;
+   std::vector<slot_t> slots;
+   // Slots that may be evicted, most recently used first
+   std::list<uint32_t> lru;
+   // Missing pages still requested, with the time they were first requested
+   std::unordered_map<uint32_t, clock_t::time_point> waiting;
+
+   size_t layer_size{ 0 };
+   std::vector<uint32_t> table;
+   std::vector<bool> dirty_levels;
+
+   virtual_texture_stats_t stats;
+};
@@ -1,4 +1,17 @@
 #include "vulkan_glfw_wrapper.h"
+#include "frag_spv.h"
+#include "frag_virtual_spv.h"
+#include "index_ranges.h"
+#include "mesh_cache.h"
+#include "mesh_cooker.h"
+#include "mesh_optimizer.h"
+#include "meshlet_builder.h"
+#include "meshlet_cull_spv.h"
+#include "packed_vertex.h"
+#include "texture_cooker.h"
+#include "thread_pool.h"
+#include "vert_packed_spv.h"
+#include "vert_spv.h"
 
 using namespace datapath;
 
@@ -6,7 +19,8 @@ using namespace datapath;
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
-#include <fstream>
+#include <exception>
+#include <filesystem>
 #include <iostream>
 #include <limits>
 #include <set>
@@ -23,7 +37,16 @@ const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 const std::string MODEL_PATH = "models/viking_room.obj";
-const std::string TEXTURE_PATH = "textures/viking_room.png";
+const std::string MODEL_CACHE_PATH = "models/viking_room.obj.meshcache";
+// The model samples the first texture. Each is cached next to its source as <source>.ktx2.
+const std::vector<std::filesystem::path> TEXTURE_PATHS = { "textures/viking_room.png" };
+// The shaders are embedded, see create_shader_modules(). These loose files are only
+// watched with --hot-reload and replace the embedded modules when they change.
+const std::string VERTEX_SHADER_PATH = "shaders/vert.spv";
+const std::string PACKED_VERTEX_SHADER_PATH = "shaders/vert_packed.spv";
+const std::string FRAGMENT_SHADER_PATH = "shaders/frag.spv";
+const std::string VIRTUAL_TEXTURE_FRAGMENT_SHADER_PATH = "shaders/frag_virtual.spv";
+const std::string MESHLET_CULL_SHADER_PATH = "shaders/meshlet_cull.spv";
 
 //______________________________________________________________________________
 
@@ -34,6 +57,59 @@ const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_N
 std::vector<Vertex> vertices;
 std::vector<uint32_t> g_indices;
 
+// Geometry handed to the GPU: either views of vertices/g_indices or of the mapped mesh cache
+std::optional<mesh_cache_t> g_mesh_cache;
+std::span<const Vertex> g_mesh_vertices;
+std::span<const uint32_t> g_mesh_indices;
+std::vector<mesh_lod_t> g_lods;
+std::span<const mesh_lod_t> g_mesh_lods;
+mesh_bounds_t g_mesh_bounds{};
+
+// Vertex buffer contents in the layout chosen by choose_vertex_layout()
+std::vector<packed_vertex_t> g_packed_vertices;
+std::span<const std::byte> g_vertex_data;
+vertex_quantization_t g_vertex_quantization{};
+
+// Index buffer contents and per LOD draw ranges chosen by choose_index_layout()
+std::vector<uint16_t> g_indices16;
+std::vector<std::vector<index_range_t>> g_lod_ranges;
+std::span<const std::byte> g_index_data;
+VkIndexType g_index_type = VK_INDEX_TYPE_UINT32;
+
+// Meshlet table built by build_meshlet_table(), uploaded next to the vertex and index buffers
+std::vector<meshlet_t> g_meshlets;
+std::vector<meshlet_range_t> g_lod_meshlets;
+
+// More ranges than this cost more in draw calls than 16-bit indices save
+constexpr size_t max_index16_ranges = 16;
+
+// Coarsest LOD is picked whose error projects to at most this many pixels
+constexpr float max_lod_pixel_error = 1.0f;
+constexpr float camera_near_plane = 0.1f;
+
+// local_size_x of meshlet_cull.comp
+constexpr uint32_t meshlet_cull_group_size = 64;
+
+// Staging memory shared by the textures of one upload submission, see load_textures()
+constexpr VkDeviceSize texture_staging_budget = VkDeviceSize{ 256 } << 20;
+// Keeps each texture's levels aligned for vkCmdCopyBufferToImage inside the shared buffer
+constexpr VkDeviceSize texture_staging_alignment = 16;
+
+// Texture table entries with descriptor indexing, whose devices allow at least 500000
+// update after bind samplers per stage
+constexpr uint32_t bindless_texture_table_size = 4096;
+// Without it, the smallest maxPerStageDescriptorSamplers a device may report
+constexpr uint32_t fallback_texture_table_size = 16;
+
+// Virtual texture page cache of slots squared pages, kept within the 4096 texel
+// maxImageDimension2D every device supports; and the pages uploaded per frame at most
+constexpr uint32_t virtual_cache_slots = 30;
+constexpr uint32_t max_virtual_page_uploads = 32;
+// Feedback texels per side, whatever the swapchain size; matches shader.frag
+constexpr uint32_t virtual_feedback_extent = 128;
+// Seconds between virtual texturing reports
+constexpr double virtual_texture_report_interval = 2.0;
+
 // Environment depdent code: Windows
 void vulkan_wrapper::init_window(
    const char* title,
@@ -57,6 +133,30 @@ void vulkan_wrapper::init_window(
 void vulkan_wrapper::init_vulkan(
    const char* appname )
 {
+   init_start_time = std::chrono::steady_clock::now();
+
+   // Opened before anything is loaded, the model included
+   if ( asset_archive_path.has_value() )
+   {
+      asset_archive = asset_archive_t( *asset_archive_path );
+      std::cout << "asset archive: " << asset_archive_path->string() << ", " << asset_archive.size() << " assets"
+                << std::endl;
+
+      if ( verify_asset_archive )
+      {
+         auto damaged = asset_archive.verify();
+         for ( const auto& name : damaged )
+         {
+            std::cerr << "damaged archive entry: " << name << std::endl;
+         }
+
+         if ( !damaged.empty() )
+         {
+            throw std::runtime_error( "asset archive is damaged!" );
+         }
+      }
+   }
+
    create_instance( appname );
    create_surface();
    pick_physical_device();
@@ -65,18 +165,21 @@ void vulkan_wrapper::init_vulkan(
    create_image_views();
    create_render_pass();
    create_descriptor_set_layout();
-   create_graphics_pipeline();
    create_command_pool();
+   create_shader_modules();
+
+   // The model is parsed and uploaded while the rest is set up
+   start_model_streaming();
 
    create_color_resources();
    create_depth_resources();
    create_framebuffers();
-   create_texture_image();
-   create_texture_image_view();
-   create_texture_sampler();
-   load_model();
-   create_vertex_buffer();
-   create_index_buffer();
+   source_textures = load_textures( TEXTURE_PATHS );
+   model_texture = source_textures.front();
+   if ( virtual_texture_path.has_value() )
+   {
+      create_virtual_texture();
+   }
    create_uniform_buffers();
 
    create_descriptor_pool();
@@ -84,10 +187,26 @@ void vulkan_wrapper::init_vulkan(
 
    create_command_buffer();
    create_sync_objects();
+
+   if ( !mesh_import_options.async_loading )
+   {
+      wait_for_model();
+   }
+
+   if ( hot_reload )
+   {
+      watch_assets();
+   }
 }
 
 void vulkan_wrapper::cleanup()
 {
+   // The loader task works on this object, so it has to finish first
+   if ( model_stream.valid() )
+   {
+      model_stream.wait();
+   }
+
    // destroy_debug_messenger();
 
    destroy_window();
@@ -132,6 +251,9 @@ auto vulkan_wrapper::get_required_instance_extensions()
       used_extensions.add_extension( glfw_used_vk_extension_name_string );
    }
 
+   // Required by VK_EXT_descriptor_indexing, see supports_descriptor_indexing()
+   used_extensions.add_extension( VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME );
+
    // Add extra instance extension here
    // if ( enableValidationLayers )
    // {
@@ -241,7 +363,10 @@ auto vulkan_wrapper::is_device_suitable(
 
    VkPhysicalDeviceFeatures supportedFeatures = device.vkGetPhysicalDeviceFeatures();
 
-   return indices.isComplete() && extensionsSupported && supportedFeatures.samplerAnisotropy;
+   // The fragment shader selects its texture table entry with a push constant, with or
+   // without descriptor indexing
+   return indices.isComplete() && extensionsSupported && supportedFeatures.samplerAnisotropy &&
+          supportedFeatures.shaderSampledImageArrayDynamicIndexing;
 }
 
 auto vulkan_wrapper::check_device_extension_support(
@@ -263,6 +388,27 @@ auto vulkan_wrapper::check_device_extension_support(
    return required_extensions.empty();
 }
 
+auto vulkan_wrapper::supports_descriptor_indexing(
+   const physical_device_wrapper_t& device )
+   -> bool
+{
+   std::optional<const std::string> layer_name{ std::nullopt };
+   auto available_extensions = device.vkEnumerateDeviceExtensionProperties( layer_name );
+
+   std::set<std::string> required_extensions{
+      VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+      VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
+
+   for ( const auto& extension : available_extensions )
+   {
+      required_extensions.erase( extension.extensionName );
+   }
+
+   // The extension guarantees partially bound, update after bind and update unused while
+   // pending sampled images, so the features need no separate query
+   return required_extensions.empty();
+}
+
 
 // Looks like something wrong here
 auto vulkan_wrapper::find_queue_families(
@@ -323,18 +469,40 @@ void vulkan_wrapper::create_logical_device()
 
    VkPhysicalDeviceFeatures device_features{};
    device_features.samplerAnisotropy = VK_TRUE;
+   // Cooked textures may be block compressed
+   device_features.textureCompressionBC = physical_device->vkGetPhysicalDeviceFeatures().textureCompressionBC;
+   // The fragment shader indexes the texture table with a push constant, see is_device_suitable()
+   device_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+   // Virtual texture feedback is written from the fragment shader
+   device_features.fragmentStoresAndAtomics =
+      virtual_texture_path.has_value() && physical_device->vkGetPhysicalDeviceFeatures().fragmentStoresAndAtomics;
 
    std::vector<const char*> c_device_extensions;
    c_device_extensions.reserve(
-      deviceExtensions.size() );
+      deviceExtensions.size() + 2 );
 
    for ( const auto& s : deviceExtensions )
    {
       c_device_extensions.push_back( s );
    }
 
+   bindless_textures = supports_descriptor_indexing( *physical_device );
+
+   VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features{};
+   descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+   descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+   descriptor_indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+   descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+
+   if ( bindless_textures )
+   {
+      c_device_extensions.push_back( VK_KHR_MAINTENANCE3_EXTENSION_NAME );
+      c_device_extensions.push_back( VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME );
+   }
+
    VkDeviceCreateInfo create_info{
       .sType = get_sType<VkDeviceCreateInfo>(),
+      .pNext = bindless_textures ? &descriptor_indexing_features : nullptr,
       .queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size()),
       .pQueueCreateInfos = queue_create_infos.data(),
       .enabledLayerCount = 0,
@@ -355,6 +523,12 @@ void vulkan_wrapper::create_logical_device()
       graphics_queue = result.value()->vkGetDeviceQueue( *indices.graphicsFamily, 0 );
       present_queue = result.value()->vkGetDeviceQueue( *indices.presentFamily, 0 );
    }
+
+   device_allocator =
+      std::make_unique<device_allocator_t>(
+         logical_device,
+         physical_device->vkGetPhysicalDeviceMemoryProperties(),
+         physical_device->vkGetPhysicalDeviceProperties().limits.bufferImageGranularity );
 }
 
 auto vulkan_wrapper::get_required_extensions()
@@ -522,25 +696,48 @@ void vulkan_wrapper::create_image_views()
 
 void vulkan_wrapper::create_graphics_pipeline()
 {
-   // create shaders
-   auto vert_shader_code = read_file( "shaders/vert.spv" );
-   auto frag_shader_code = read_file( "shaders/frag.spv" );
-
-   auto vert_shader_module = create_shader_module( vert_shader_code );
-   auto frag_shader_module = create_shader_module( frag_shader_code );
-
+   // Shader modules
    VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
    vert_shader_stage_info.sType = get_sType<VkPipelineShaderStageCreateInfo>();
    vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-   vert_shader_stage_info.module = vert_shader_module.get();
+   vert_shader_stage_info.module = packed_vertex_layout ? packed_vertex_shader_module.get() : vertex_shader_module.get();
    vert_shader_stage_info.pName = "main";
 
    VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
    frag_shader_stage_info.sType = get_sType<VkPipelineShaderStageCreateInfo>();
    frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-   frag_shader_stage_info.module = frag_shader_module.get();
+   frag_shader_stage_info.module = fragment_shader_module.get();
    frag_shader_stage_info.pName = "main";
 
+   // constant_id 0 sizes the texture table array to the descriptor count, 1 to 4 describe
+   // the virtual texture to frag_virtual.spv
+   std::array<uint32_t, 5> frag_constants{ texture_table_size, 1, 1, 1, virtual_cache_slots };
+   if ( virtual_texture_file )
+   {
+      frag_constants[1] = virtual_texture_file->width();
+      frag_constants[2] = virtual_texture_file->height();
+      frag_constants[3] = virtual_texture_file->level_count();
+   }
+
+   std::array<VkSpecializationMapEntry, 5> frag_constant_entries{};
+   for ( uint32_t i = 0;
+         i < frag_constant_entries.size();
+         ++i )
+   {
+      frag_constant_entries[i] = {
+         .constantID = i,
+         .offset = i * static_cast<uint32_t>( sizeof( uint32_t ) ),
+         .size = sizeof( uint32_t ) };
+   }
+
+   VkSpecializationInfo frag_specialization{
+      .mapEntryCount = static_cast<uint32_t>( frag_constant_entries.size() ),
+      .pMapEntries = frag_constant_entries.data(),
+      .dataSize = sizeof( frag_constants ),
+      .pData = frag_constants.data() };
+
+   frag_shader_stage_info.pSpecializationInfo = &frag_specialization;
+
    std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages{
       vert_shader_stage_info,
       frag_shader_stage_info };
@@ -554,8 +751,20 @@ void vulkan_wrapper::create_graphics_pipeline()
    dynamic_state.pDynamicStates = dynamic_states.data();
 
    // Vertex input
-   auto bindingDescription = Vertex::getBindingDescription();
-   auto attributeDescriptions = Vertex::getAttributeDescriptions();
+   auto bindingDescription =
+      packed_vertex_layout ? packed_vertex_t::getBindingDescription() : vertex_binding_description();
+
+   std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+   if ( packed_vertex_layout )
+   {
+      auto packed_attributes = packed_vertex_t::getAttributeDescriptions();
+      attributeDescriptions.assign( packed_attributes.begin(), packed_attributes.end() );
+   }
+   else
+   {
+      auto attributes = vertex_attribute_descriptions();
+      attributeDescriptions.assign( attributes.begin(), attributes.end() );
+   }
 
    VkPipelineVertexInputStateCreateInfo vertex_input_info{
       .sType = get_sType<VkPipelineVertexInputStateCreateInfo>(),
@@ -654,11 +863,17 @@ void vulkan_wrapper::create_graphics_pipeline()
    };
 
    // Pipeline layout
+   VkPushConstantRange material_range{
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      .offset = 0,
+      .size = sizeof( material_push_constants_t ) };
+
    VkPipelineLayoutCreateInfo pipeline_layout_info{
       .sType = get_sType<VkPipelineLayoutCreateInfo>(),
       .setLayoutCount = 1,
       .pSetLayouts = &descriptor_set_layout.get(),
-      .pushConstantRangeCount = 0 };
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &material_range };
 
    auto pipeline_layout_result = logical_device->vkCreatePipelineLayout( pipeline_layout_info );
    if ( pipeline_layout_result.holds_error() )
@@ -701,38 +916,68 @@ void vulkan_wrapper::create_graphics_pipeline()
 }
 
 
-auto vulkan_wrapper::read_file(
-   const std::string& filename )
-   -> std::vector<char>
+void vulkan_wrapper::pack_assets(
+   const std::filesystem::path& archive_path )
 {
-   std::ifstream file( filename, std::ios::ate | std::ios::binary );
+   std::vector<asset_archive_input_t> inputs;
+
+   auto add =
+      [&]( const std::filesystem::path& path, bool required )
+      {
+         std::error_code error;
+         if ( !std::filesystem::exists( path, error ) )
+         {
+            if ( required )
+            {
+               throw std::runtime_error( "asset to pack not found: " + path.string() );
+            }
+            return;
+         }
+
+         inputs.push_back( { path.generic_string(), path } );
+      };
+
+   // Caches are written by a run with the loose files. Without its cache the model is
+   // imported from the packed source at every start; textures are only cooked from
+   // loose sources, so just their caches are packed.
+   add( MODEL_PATH, true );
+   add( MODEL_CACHE_PATH, false );
 
-   if ( !file.is_open() )
+   for ( const auto& texture : TEXTURE_PATHS )
    {
-      throw std::runtime_error( "failed to open file!" );
-   }
+      auto cache_path = texture;
+      cache_path += ".ktx2";
 
-   size_t fileSize = (size_t)file.tellg();
-   std::vector<char> buffer( fileSize );
+      add( cache_path, false );
+   }
 
-   file.seekg( 0 );
-   file.read(
-      buffer.data(),
-      fileSize );
+   asset_archive_t::write( archive_path, inputs );
 
-   file.close();
+   std::cout << "packed " << inputs.size() << " assets into " << archive_path.string() << std::endl;
+}
 
-   return buffer;
+auto vulkan_wrapper::read_file(
+   const std::string& filename ) const
+   -> asset_data_t
+{
+   try
+   {
+      return asset_data_t( asset_archive, filename );
+   }
+   catch ( const std::exception& )
+   {
+      throw std::runtime_error( "failed to open file: " + filename );
+   }
 }
 
 auto vulkan_wrapper::create_shader_module(
-   const std::vector<char>& code )
+   std::span<const uint32_t> code )
    -> VkShaderModule_resource_t
 {
    VkShaderModuleCreateInfo create_info{};
    create_info.sType = get_sType<VkShaderModuleCreateInfo>();   // VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO
-   create_info.codeSize = code.size();
-   create_info.pCode = reinterpret_cast<const uint32_t*>( code.data() );
+   create_info.codeSize = code.size_bytes();
+   create_info.pCode = code.data();
 
    auto shader_module = logical_device->vkCreateShaderModule( create_info );
 
@@ -744,6 +989,24 @@ auto vulkan_wrapper::create_shader_module(
    return std::move( shader_module ).value();
 }
 
+void vulkan_wrapper::create_shader_modules()
+{
+   // Both vertex layouts are ready before the loader task picks one
+   vertex_shader_module = create_shader_module( vert_spv );
+   packed_vertex_shader_module = create_shader_module( vert_packed_spv );
+
+   if ( virtual_texture_path.has_value() )
+   {
+      fragment_shader_module = create_shader_module( frag_virtual_spv );
+   }
+   else
+   {
+      fragment_shader_module = create_shader_module( frag_spv );
+   }
+
+   cull_shader_module = create_shader_module( meshlet_cull_spv );
+}
+
 void vulkan_wrapper::create_render_pass()
 {
    // Attachment description
@@ -918,6 +1181,23 @@ void vulkan_wrapper::record_command_buffer(
       throw std::runtime_error( "failed to begin recording command buffer!" );
    }
 
+   // The culling pass writes the index buffer and draw command used in the render pass
+   if ( model_resident && meshlet_culling )
+   {
+      record_meshlet_culling( command_buffer );
+   }
+
+   // Reloaded textures are written before anything samples them
+   if ( !pending_texture_rewrites.empty() )
+   {
+      record_texture_rewrites( command_buffer );
+   }
+
+   if ( virtual_texture_file )
+   {
+      record_virtual_texture_uploads( command_buffer );
+   }
+
    std::array<VkClearValue, 2> clear_values{};
    clear_values[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
    clear_values[1].depthStencil = { 1.0f, 0 };
@@ -935,6 +1215,29 @@ void vulkan_wrapper::record_command_buffer(
 
    command_buffer.vkCmdBeginRenderPass( render_pass_info, VK_SUBPASS_CONTENTS_INLINE );
 
+   // Until the model is resident the frame is only cleared
+   if ( model_resident )
+   {
+      record_model_draw( command_buffer );
+   }
+
+   // Finishing up
+   command_buffer.vkCmdEndRenderPass();
+
+   if ( virtual_texture_file )
+   {
+      record_feedback_readback( command_buffer );
+   }
+
+   if ( command_buffer.vkEndCommandBuffer() != VK_SUCCESS )
+   {
+      throw std::runtime_error( "failed to record command buffer!" );
+   }
+}
+
+void vulkan_wrapper::record_model_draw(
+   command_buffer_wrapper_t& command_buffer )
+{
    //  bind command_buffer to the graphics pipeline
    command_buffer.vkCmdBindPipeline(
       VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -960,9 +1263,9 @@ void vulkan_wrapper::record_command_buffer(
       offsets );
 
    command_buffer.vkCmdBindIndexBuffer(
-      index_buffer.get(),
+      meshlet_culling ? visible_index_buffers[current_frame].get() : index_buffer.get(),
       0,
-      VK_INDEX_TYPE_UINT32 );
+      meshlet_culling ? VK_INDEX_TYPE_UINT32 : g_index_type );
 
    std::vector<uint32_t> dynamic_offsets{};
 
@@ -973,22 +1276,48 @@ void vulkan_wrapper::record_command_buffer(
       std::span( &descriptor_sets.get()[current_frame], 1 ),
       dynamic_offsets );
 
-   // Draw command buffer
-   // command_buffer.vkCmdDraw( 3, 1, 0, 0 );
-   command_buffer.vkCmdDrawIndexed(
-      static_cast<uint32_t>( g_indices.size() ),
-      1,
-      0,
+   // Materials only differ in push constants; the texture table stays bound
+   texture_binding_t texture = texture_binding( model_texture );
+
+   material_push_constants_t material{
+      .texture_transform =
+         glm::vec4( texture.remap.transform[0], texture.remap.transform[1], texture.remap.transform[2], texture.remap.transform[3] ),
+      .texture_bounds =
+         glm::vec4( texture.remap.bounds[0], texture.remap.bounds[1], texture.remap.bounds[2], texture.remap.bounds[3] ),
+      .texture_index = texture.table_index,
+      .texture_layer = texture.remap.layer,
+      .feedback_scale =
+         glm::vec2( virtual_feedback_extent ) /
+         glm::vec2( static_cast<float>( swapchain_extent.width ), static_cast<float>( swapchain_extent.height ) ) };
+
+   command_buffer.vkCmdPushConstants(
+      *pipeline_layout,
+      VK_SHADER_STAGE_FRAGMENT_BIT,
       0,
-      0 );
-
-
-   // Finishing up
-   command_buffer.vkCmdEndRenderPass();
+      sizeof( material ),
+      &material );
 
-   if ( command_buffer.vkEndCommandBuffer() != VK_SUCCESS )
+   // Draw command buffer
+   // command_buffer.vkCmdDraw( 3, 1, 0, 0 );
+   if ( meshlet_culling )
    {
-      throw std::runtime_error( "failed to record command buffer!" );
+      command_buffer.vkCmdDrawIndexedIndirect(
+         draw_command_buffers[current_frame].get(),
+         0,
+         1,
+         sizeof( VkDrawIndexedIndirectCommand ) );
+   }
+   else
+   {
+      for ( const auto& range : g_lod_ranges[current_lod] )
+      {
+         command_buffer.vkCmdDrawIndexed(
+            range.index_count,
+            1,
+            range.first_index,
+            range.vertex_offset,
+            0 );
+      }
    }
 }
 
@@ -1034,6 +1363,28 @@ void vulkan_wrapper::draw_frame()
    {
       throw std::runtime_error( "failed to wait for fences!" );
    }
+
+   // Every frame in flight when these were replaced has finished now
+   release_retired_resources();
+
+   if ( asset_watcher )
+   {
+      reload_changed_assets();
+   }
+
+   // Swap in the streamed model between frames once its upload has finished
+   poll_model_stream();
+
+   // This frame's set is no longer in use, so texture arrays published since it was
+   // last recorded can be written to it
+   flush_texture_table( current_frame );
+
+   // The feedback this frame's slot wrote last time is complete now
+   if ( virtual_texture_file )
+   {
+      update_virtual_texture( current_frame );
+   }
+
    // Acquire an image from the swap chain
 
    uint32_t image_index =
@@ -1103,7 +1454,10 @@ void vulkan_wrapper::draw_frame()
       throw std::runtime_error( "failed to queue present KHR!" );
    }
 
+   report_frame_times();
+
    current_frame = ( current_frame + 1 ) % max_frames_in_flight;
+   ++frame_number;
 }
 
 void vulkan_wrapper::recreate_swapchain()
@@ -1118,7 +1472,10 @@ void vulkan_wrapper::recreate_swapchain()
    create_swap_chain();
    create_image_views();
    create_render_pass();
-   create_graphics_pipeline();
+   if ( model_resident )
+   {
+      create_graphics_pipeline();
+   }
    create_color_resources();
    create_depth_resources();
    create_framebuffers();
@@ -1154,373 +1511,1836 @@ void vulkan_wrapper::cleanup_swapchain()
    swapchain.reset();
 }
 
-void vulkan_wrapper::create_vertex_buffer()
+void vulkan_wrapper::start_model_streaming()
 {
-   VkDeviceSize buffer_size = sizeof( Vertex ) * vertices.size();
-
-   VkBuffer_resource_t staging_buffer;
-   VkDeviceMemory_resource_t staging_buffer_memory;
+   uint32_t queue_family = find_queue_families( *physical_device ).graphicsFamily.value();
 
-   // Create staging buffer
-   std::tie( staging_buffer, staging_buffer_memory ) =
-      create_buffer(
-         buffer_size,
-         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+   model_stream =
+      thread_pool_t::shared().submit(
+         [this, queue_family]()
+         {
+            return prepare_model_upload( queue_family );
+         } );
+}
 
-   // Filling the staging buffer
-   void* data;
-   auto result =
-      logical_device->vkMapMemory(
-         staging_buffer_memory.get(),
-         0,
-         buffer_size,
-         0,
-         &data );
+void vulkan_wrapper::wait_for_model()
+{
+   pending_upload = model_stream.get();
+   submit_model_upload( *pending_upload );
 
-   if ( result != VK_SUCCESS )
+   std::span<const VkFence> fences{ &pending_upload->fence.get(), 1 };
+   if ( logical_device->vkWaitForFences( fences, VK_TRUE, UINT64_MAX ) != VK_SUCCESS )
    {
-      throw std::runtime_error( "failed to map vertex buffer memory!" );
+      throw std::runtime_error( "failed to wait for model upload!" );
    }
-   memcpy(
-      data,
-      vertices.data(),
-      buffer_size );
-
-   logical_device->vkUnmapMemory(
-      staging_buffer_memory.get() );
-
-   // Create vertex buffer
-   std::tie( vertex_buffer, vertex_buffer_memory ) =
-      create_buffer(
-         buffer_size,
-         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
 
-   // Copy data to vertex buffer
-   copy_buffer(
-      staging_buffer.get(),
-      vertex_buffer.get(),
-      buffer_size );
+   install_model( *pending_upload );
+   pending_upload.reset();
 }
 
-void vulkan_wrapper::create_index_buffer()
+auto vulkan_wrapper::prepare_model_upload(
+   uint32_t queue_family )
+   -> mesh_upload_t
 {
-   VkDeviceSize buffer_size = sizeof( g_indices[0] ) * g_indices.size();
-
-   VkBuffer_resource_t staging_buffer;
-   VkDeviceMemory_resource_t staging_buffer_memory;
+   // Runs on a worker thread in async mode: nothing here may touch the queues, the
+   // render loop's command pool or state read by draw_frame()
+   load_model();
+   choose_vertex_layout();
+   build_meshlet_table();
+   choose_index_layout();
 
-   // Create staging buffer
-   std::tie( staging_buffer, staging_buffer_memory ) =
-      create_buffer(
-         buffer_size,
-         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+   mesh_upload_t upload;
 
-   // Filling the staging buffer
-   void* data;
-   auto result =
-      logical_device->vkMapMemory(
-         staging_buffer_memory.get(),
-         0,
-         buffer_size,
-         0,
-         &data );
+   VkCommandPoolCreateInfo pool_info{
+      .sType = get_sType<VkCommandPoolCreateInfo>(),
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = queue_family };
 
-   if ( result != VK_SUCCESS )
+   auto command_pool_result = logical_device->vkCreateCommandPool( pool_info );
+   if ( command_pool_result.holds_error() )
    {
-      throw std::runtime_error( "failed to map index buffer memory!" );
+      throw std::runtime_error( "failed to create upload command pool!" );
    }
-   memcpy(
-      data,
-      g_indices.data(),
-      buffer_size );
 
-   logical_device->vkUnmapMemory(
-      staging_buffer_memory.get() );
+   upload.command_pool = std::move( command_pool_result ).value();
 
-   // Create index buffer
-   std::tie( index_buffer, index_buffer_memory ) =
-      create_buffer(
-         buffer_size,
-         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+   DPVkCommandBufferAllocateInfo_t command_buffer_alloc_info{
+      .command_pool = upload.command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .command_buffer_count = 1 };
 
-   // Copy data to vertex buffer
-   copy_buffer(
-      staging_buffer.get(),
-      index_buffer.get(),
-      buffer_size );
-}
+   auto command_buffer_result = logical_device->vkAllocateCommandBuffers( command_buffer_alloc_info );
+   if ( command_buffer_result.holds_error() )
+   {
+      throw std::runtime_error( "failed to allocate upload command buffer!" );
+   }
 
+   upload.command_buffers = std::move( command_buffer_result ).value();
 
-auto vulkan_wrapper::find_memory_type(
-   uint32_t type_filter,
-   VkMemoryPropertyFlags properties )
-   -> uint32_t
-{
-   VkPhysicalDeviceMemoryProperties mem_properties = physical_device->vkGetPhysicalDeviceMemoryProperties();
+   VkCommandBufferBeginInfo begin_info{
+      .sType = get_sType<VkCommandBufferBeginInfo>(),
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr };
 
-   for ( uint32_t i = 0;
-         i < mem_properties.memoryTypeCount;
-         i++ )
+   if ( upload.command_buffers.front().vkBeginCommandBuffer( begin_info ) != VK_SUCCESS )
    {
-      if ( ( type_filter & ( 1 << i ) ) &&
-           ( mem_properties.memoryTypes[i].propertyFlags & properties ) == properties )
-      {
-         return i;
-      }
+      throw std::runtime_error( "failed to begin recording upload command buffer!" );
    }
 
-   throw std::runtime_error( "failed to find suitable memory type!" );
-}
-
-auto vulkan_wrapper::create_buffer(
-   VkDeviceSize size,
-   VkBufferUsageFlags usage,
-   VkMemoryPropertyFlags properties )
-   -> std::pair<
-      VkBuffer_resource_t,
-      VkDeviceMemory_resource_t>
-{
-   VkBufferCreateInfo buffer_info{
-      .sType = get_sType<VkBufferCreateInfo>(),
-      .size = size,
-      .usage = usage,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE };
+   std::tie( upload.vertex_buffer, upload.vertex_buffer_memory ) =
+      stage_buffer( upload, g_vertex_data, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
 
-   auto buffer = logical_device->vkCreateBuffer( buffer_info );
-   if ( buffer.holds_error() )
+   // The index buffer is also the source of the meshlet culling pass
+   VkBufferUsageFlags index_usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+   if ( meshlet_culling )
    {
-      throw std::runtime_error( "failed to create buffer!" );
+      index_usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
    }
 
-   // Memory requirements
-   VkMemoryRequirements mem_requirements = logical_device->vkGetBufferMemoryRequirements( *buffer.value() );
-
-   // Memory allocation
-   VkMemoryAllocateInfo alloc_info{
-      .sType = get_sType<VkMemoryAllocateInfo>(),
-      .allocationSize = mem_requirements.size,
-      .memoryTypeIndex = find_memory_type( mem_requirements.memoryTypeBits, properties ) };
+   std::tie( upload.index_buffer, upload.index_buffer_memory ) =
+      stage_buffer( upload, g_index_data, index_usage );
 
-   auto buffer_memory = logical_device->vkAllocateMemory( alloc_info );
+   if ( meshlet_culling )
+   {
+      std::tie( upload.meshlet_buffer, upload.meshlet_buffer_memory ) =
+         stage_buffer(
+            upload,
+            std::as_bytes( std::span<const meshlet_t>( g_meshlets ) ),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT );
+   }
 
-   if ( buffer_memory.holds_error() )
+   if ( upload.command_buffers.front().vkEndCommandBuffer() != VK_SUCCESS )
    {
-      throw std::runtime_error( "failed to allocate buffer memory!" );
+      throw std::runtime_error( "failed to record upload command buffer!" );
    }
 
-   auto result =
-      logical_device->vkBindBufferMemory(
-         buffer.value().get(),
-         buffer_memory.value().get(),
-         0 );
+   VkFenceCreateInfo fence_info{
+      .sType = get_sType<VkFenceCreateInfo>(),
+      .flags = 0 };
 
-   if ( result != VK_SUCCESS )
+   auto fence_result = logical_device->vkCreateFence( fence_info );
+   if ( fence_result.holds_error() )
    {
-      throw std::runtime_error( "failed to bind buffer and alloced memory together!" );
+      throw std::runtime_error( "failed to create upload fence!" );
    }
 
-   return
-      std::pair<VkBuffer_resource_t, VkDeviceMemory_resource_t>(
-         std::move( buffer ).value(),
-         std::move( buffer_memory ).value() );
+   upload.fence = std::move( fence_result ).value();
+
+   return upload;
 }
 
-void vulkan_wrapper::copy_buffer(
+auto vulkan_wrapper::stage_buffer(
+   mesh_upload_t& upload,
+   std::span<const std::byte> contents,
+   VkBufferUsageFlags usage )
+   -> std::pair<
+      VkBuffer_resource_t,
+      device_allocation_t>
+{
+   VkDeviceSize buffer_size = contents.size_bytes();
+
+   auto staging =
+      create_buffer(
+         buffer_size,
+         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+   memcpy(
+      staging.second.mapped_data(),
+      contents.data(),
+      buffer_size );
+
+   auto device_buffer =
+      create_buffer(
+         buffer_size,
+         VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+   VkBufferCopy copy_region{
+      .srcOffset = 0,
+      .dstOffset = 0,
+      .size = buffer_size };
+
+   upload.command_buffers.front().vkCmdCopyBuffer(
+      staging.first.get(),
+      device_buffer.first.get(),
+      std::span<VkBufferCopy>( &copy_region, 1 ) );
+
+   // The staging buffer has to live until the upload fence signals
+   upload.staging_buffers.push_back( std::move( staging ) );
+
+   return device_buffer;
+}
+
+void vulkan_wrapper::submit_model_upload(
+   mesh_upload_t& upload )
+{
+   VkCommandBuffer command_buffer_handle = upload.command_buffers.front().handle();
+   VkSubmitInfo submit_info{
+      .sType = get_sType<VkSubmitInfo>(),
+      .commandBufferCount = 1,
+      .pCommandBuffers = &command_buffer_handle };
+
+   if ( graphics_queue->vkQueueSubmit( std::span<const VkSubmitInfo>( &submit_info, 1 ), upload.fence ) !=
+        VK_SUCCESS )
+   {
+      throw std::runtime_error( "failed to submit model upload!" );
+   }
+}
+
+void vulkan_wrapper::poll_model_stream()
+{
+   if ( model_resident )
+   {
+      return;
+   }
+
+   if ( !pending_upload.has_value() )
+   {
+      if ( !model_stream.valid() ||
+           model_stream.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+      {
+         return;
+      }
+
+      // Rethrows anything the loader task threw. With hot reload the app keeps running
+      // without the model until its file is fixed.
+      try
+      {
+         pending_upload = model_stream.get();
+      }
+      catch ( const std::exception& e )
+      {
+         if ( !asset_watcher )
+         {
+            throw;
+         }
+
+         std::cerr << "model not loaded: " << e.what() << std::endl;
+         return;
+      }
+
+      submit_model_upload( *pending_upload );
+      return;
+   }
+
+   if ( logical_device->vkGetFenceStatus( pending_upload->fence.get() ) != VK_SUCCESS )
+   {
+      return;
+   }
+
+   install_model( *pending_upload );
+   pending_upload.reset();
+}
+
+void vulkan_wrapper::install_model(
+   mesh_upload_t& upload )
+{
+   vertex_buffer = std::move( upload.vertex_buffer );
+   vertex_buffer_memory = std::move( upload.vertex_buffer_memory );
+   index_buffer = std::move( upload.index_buffer );
+   index_buffer_memory = std::move( upload.index_buffer_memory );
+   meshlet_buffer = std::move( upload.meshlet_buffer );
+   meshlet_buffer_memory = std::move( upload.meshlet_buffer_memory );
+
+   // The vertex layout and culling chosen while loading decide both pipelines
+   create_graphics_pipeline();
+
+   if ( meshlet_culling )
+   {
+      create_meshlet_buffers();
+      create_cull_pipeline();
+      create_cull_descriptor_sets();
+   }
+
+   model_resident = true;
+
+   std::cout << "model resident after "
+             << std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - init_start_time ).count()
+             << " ms" << std::endl;
+
+   auto memory = device_allocator->statistics();
+   std::cout << "device memory: " << memory.allocation_count << " resources in " << memory.block_count
+             << " allocations (" << memory.dedicated_count << " dedicated), "
+             << static_cast<double>( memory.bytes_allocated ) / ( 1024.0 * 1024.0 ) << " of "
+             << static_cast<double>( memory.bytes_reserved ) / ( 1024.0 * 1024.0 ) << " MiB used" << std::endl;
+}
+
+void vulkan_wrapper::report_frame_times()
+{
+   auto elapsed =
+      std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - init_start_time ).count();
+
+   if ( !first_frame_reported )
+   {
+      first_frame_reported = true;
+      std::cout << "time to first frame: " << elapsed << " ms" << std::endl;
+   }
+
+   if ( model_resident && !first_model_frame_reported )
+   {
+      first_model_frame_reported = true;
+      std::cout << "time to first model frame: " << elapsed << " ms" << std::endl;
+   }
+}
+
+void vulkan_wrapper::watch_assets()
+{
+   asset_watcher = std::make_unique<asset_watcher_t>();
+
+   // Only loose files are read again, whatever the archive holds stays as packed
+   auto watch_loose =
+      [&]( const std::filesystem::path& path, const std::filesystem::path& packed_path )
+      {
+         if ( !asset_archive.find( packed_path.generic_string() ) )
+         {
+            asset_watcher->watch( path );
+         }
+      };
+
+   for ( const auto& shader :
+         { VERTEX_SHADER_PATH,
+           PACKED_VERTEX_SHADER_PATH,
+           FRAGMENT_SHADER_PATH,
+           VIRTUAL_TEXTURE_FRAGMENT_SHADER_PATH,
+           MESHLET_CULL_SHADER_PATH } )
+   {
+      watch_loose( shader, shader );
+   }
+
+   // A packed cache is used whatever the source says
+   if ( !asset_archive.find( MODEL_CACHE_PATH ) )
+   {
+      watch_loose( MODEL_PATH, MODEL_PATH );
+   }
+
+   for ( const auto& texture : TEXTURE_PATHS )
+   {
+      auto cache_path = texture;
+      cache_path += ".ktx2";
+
+      watch_loose( texture, cache_path );
+   }
+}
+
+void vulkan_wrapper::reload_changed_assets()
+{
+   bool graphics_shader_changed = false;
+   bool cull_shader_changed = false;
+
+   for ( const auto& path : asset_watcher->poll() )
+   {
+      auto name = path.generic_string();
+      std::cout << "reloading " << name << std::endl;
+
+      if ( name == MODEL_PATH )
+      {
+         model_reload_requested = true;
+      }
+      else if ( path.extension() == ".spv" )
+      {
+         // The pipelines using it are rebuilt below
+         try
+         {
+            if ( reload_shader_module( name ) )
+            {
+               ( name == MESHLET_CULL_SHADER_PATH ? cull_shader_changed : graphics_shader_changed ) = true;
+            }
+         }
+         catch ( const std::exception& e )
+         {
+            std::cerr << "shader not reloaded: " << e.what() << std::endl;
+         }
+      }
+
+      for ( size_t i = 0;
+            i < TEXTURE_PATHS.size();
+            ++i )
+      {
+         if ( TEXTURE_PATHS[i] != path )
+         {
+            continue;
+         }
+
+         // A failed reload keeps the texture as it was
+         try
+         {
+            reload_texture( source_textures[i], path );
+         }
+         catch ( const std::exception& e )
+         {
+            std::cerr << "texture not reloaded: " << e.what() << std::endl;
+         }
+      }
+   }
+
+   // A model still loading is replaced once it has been installed. Installing the new
+   // one builds both pipelines, from the current shaders.
+   if ( model_reload_requested && !model_stream.valid() && !pending_upload.has_value() )
+   {
+      model_reload_requested = false;
+      reload_model();
+      return;
+   }
+
+   // The pipelines depend on the vertex layout and culling the loader task chooses
+   if ( !model_resident )
+   {
+      return;
+   }
+
+   // A failed rebuild keeps the pipeline as it was
+   try
+   {
+      if ( graphics_shader_changed )
+      {
+         reload_graphics_pipeline();
+      }
+
+      if ( cull_shader_changed && meshlet_culling )
+      {
+         reload_cull_pipeline();
+      }
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << "pipeline not rebuilt: " << e.what() << std::endl;
+   }
+}
+
+auto vulkan_wrapper::reload_shader_module(
+   const std::string& name )
+   -> bool
+{
+   VkShaderModule_resource_t* module = nullptr;
+
+   if ( name == VERTEX_SHADER_PATH )
+   {
+      module = &vertex_shader_module;
+   }
+   else if ( name == PACKED_VERTEX_SHADER_PATH )
+   {
+      module = &packed_vertex_shader_module;
+   }
+   else if ( name == ( virtual_texture_path.has_value() ? VIRTUAL_TEXTURE_FRAGMENT_SHADER_PATH : FRAGMENT_SHADER_PATH ) )
+   {
+      module = &fragment_shader_module;
+   }
+   else if ( name == MESHLET_CULL_SHADER_PATH )
+   {
+      module = &cull_shader_module;
+   }
+   else
+   {
+      return false;
+   }
+
+   auto code = read_file( name );
+   if ( code.data().empty() || code.data().size() % sizeof( uint32_t ) != 0 )
+   {
+      throw std::runtime_error( "not SPIR-V: " + name );
+   }
+
+   // The file is mapped page aligned, so its words are passed in place. Pipelines keep
+   // working once their modules are destroyed, so the old one goes straight away.
+   *module =
+      create_shader_module(
+         std::span(
+            reinterpret_cast<const uint32_t*>( code.data().data() ),
+            code.data().size() / sizeof( uint32_t ) ) );
+
+   return true;
+}
+
+void vulkan_wrapper::reload_graphics_pipeline()
+{
+   auto old_pipeline = std::move( graphics_pipeline );
+   auto old_layout = std::move( pipeline_layout );
+
+   try
+   {
+      create_graphics_pipeline();
+   }
+   catch ( ... )
+   {
+      graphics_pipeline = std::move( old_pipeline );
+      pipeline_layout = std::move( old_layout );
+      throw;
+   }
+
+   retire( std::move( old_pipeline ) );
+   retire( std::move( old_layout ) );
+}
+
+void vulkan_wrapper::reload_cull_pipeline()
+{
+   // The sets are allocated with the layout create_cull_pipeline() replaces, so they are
+   // replaced as well
+   auto old_sets = std::move( cull_descriptor_sets );
+   auto old_pool = std::move( cull_descriptor_pool );
+   auto old_pipeline = std::move( cull_pipeline );
+   auto old_pipeline_layout = std::move( cull_pipeline_layout );
+   auto old_set_layout = std::move( cull_descriptor_set_layout );
+
+   try
+   {
+      create_cull_pipeline();
+      create_cull_descriptor_sets();
+   }
+   catch ( ... )
+   {
+      cull_descriptor_sets = std::move( old_sets );
+      cull_descriptor_pool = std::move( old_pool );
+      cull_pipeline = std::move( old_pipeline );
+      cull_pipeline_layout = std::move( old_pipeline_layout );
+      cull_descriptor_set_layout = std::move( old_set_layout );
+      throw;
+   }
+
+   retire( std::move( old_sets ) );
+   retire( std::move( old_pool ) );
+   retire( std::move( old_pipeline ) );
+   retire( std::move( old_pipeline_layout ) );
+   retire( std::move( old_set_layout ) );
+}
+
+void vulkan_wrapper::reload_model()
+{
+   // The loader task rewrites the model state draw_frame() reads, so as on the first
+   // load the model is left out of the frames until the new one is resident
+   model_resident = false;
+
+   retire( std::move( vertex_buffer ) );
+   retire( std::move( vertex_buffer_memory ) );
+   retire( std::move( index_buffer ) );
+   retire( std::move( index_buffer_memory ) );
+   retire( std::move( meshlet_buffer ) );
+   retire( std::move( meshlet_buffer_memory ) );
+   retire( std::move( graphics_pipeline ) );
+   retire( std::move( pipeline_layout ) );
+
+   if ( meshlet_culling )
+   {
+      retire( std::move( cull_descriptor_sets ) );
+      retire( std::move( cull_descriptor_pool ) );
+      retire( std::move( cull_pipeline ) );
+      retire( std::move( cull_pipeline_layout ) );
+      retire( std::move( cull_descriptor_set_layout ) );
+      retire( std::move( visible_index_buffers ) );
+      retire( std::move( visible_index_buffers_memory ) );
+      retire( std::move( draw_command_buffers ) );
+      retire( std::move( draw_command_buffers_memory ) );
+   }
+
+   start_model_streaming();
+}
+
+void vulkan_wrapper::reload_texture(
+   texture_handle_t handle,
+   const std::filesystem::path& source )
+{
+   uint32_t old_array = textures.at( handle.index ).array;
+
+   auto shares_old_array =
+      [&]( const texture_slot_t& slot )
+      {
+         return &slot != &textures[handle.index] && slot.array == old_array;
+      };
+
+   // A texture sharing its array that keeps its format and size is written over its old
+   // texels, which takes no table entry
+   if ( std::any_of( textures.begin(), textures.end(), shares_old_array ) && rewrite_texture( handle, source ) )
+   {
+      return;
+   }
+
+   size_t texture_count = textures.size();
+   size_t array_count = texture_arrays.size();
+
+   // Cooked and uploaded into an array of its own, waiting for that upload only
+   texture_handle_t reloaded{};
+   try
+   {
+      reloaded = load_textures( std::span( &source, 1 ) ).front();
+   }
+   catch ( ... )
+   {
+      // load_textures() waits for its upload before it throws, so nothing uses what was added
+      textures.resize( texture_count );
+      texture_arrays.resize( array_count );
+      throw;
+   }
+
+   uint32_t new_array = textures.at( reloaded.index ).array;
+
+   textures[handle.index] = textures[reloaded.index];
+   textures.pop_back();
+
+   // An array also holding other textures stays and the handle now points into the new
+   // one. That array is the handle's alone, so its later reloads take over its entry and
+   // each handle adds at most one to the table.
+   if ( std::any_of( textures.begin(), textures.end(), shares_old_array ) )
+   {
+      return;
+   }
+
+   // Otherwise the new array takes over the old one's table entry, so reloads never fill
+   // the table
+   auto& array = texture_arrays[old_array];
+   retire( std::move( array.view ) );
+   retire( std::move( array.sampler ) );
+   retire( std::move( array.image ) );
+   retire( std::move( array.image_memory ) );
+
+   array = std::move( texture_arrays[new_array] );
+   texture_arrays.pop_back();
+   textures[handle.index].array = old_array;
+   textures[handle.index].placement.array = old_array;
+
+   // Each frame's set is rewritten once that frame's fence has signalled. The fallback
+   // table repeats the model texture's array in its unused entries, so all of it is.
+   for ( auto& writes : pending_texture_table_writes )
+   {
+      if ( bindless_textures )
+      {
+         writes.push_back( old_array );
+         continue;
+      }
+
+      for ( uint32_t entry = 0;
+            entry < texture_table_size;
+            ++entry )
+      {
+         writes.push_back( entry );
+      }
+   }
+}
+
+auto vulkan_wrapper::rewrite_texture(
+   texture_handle_t handle,
+   const std::filesystem::path& source )
+   -> bool
+{
+   const auto& slot = textures.at( handle.index );
+   const auto& array = texture_arrays.at( slot.array );
+
+   auto layout = read_texture_layout( source, slot.format );
+   if ( layout.format != slot.format || layout.width != slot.width || layout.height != slot.height ||
+        layout.levels.size() < slot.mip_levels )
+   {
+      return false;
+   }
+
+   auto [staging_buffer, staging_buffer_memory] =
+      create_buffer(
+         layout.data_size(),
+         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+         host_cached_memory_properties() );
+
+   std::span<std::byte> target( staging_buffer_memory.mapped_data(), layout.data_size() );
+   layout =
+      cook_texture_into(
+         source,
+         slot.format,
+         [&]( size_t size )
+         {
+            return target.first( std::min( size, target.size() ) );
+         } );
+
+   auto cache_path = source;
+   cache_path += ".ktx2";
+
+   try
+   {
+      texture_cache_t::write( cache_path, source, layout.view( target ) );
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << "texture cache not written: " << e.what() << std::endl;
+   }
+
+   // The copy regions of the texture's own placement, in a pack of its array alone
+   texture_pack_t pack;
+   pack.arrays = { array.desc };
+   pack.placements = { slot.placement };
+   pack.placements[0].array = 0;
+
+   // Recorded into the next frame rather than submitted and waited for here
+   pending_texture_rewrites.push_back(
+      { std::move( staging_buffer ),
+        std::move( staging_buffer_memory ),
+        array.image.get(),
+        slot.placement.layer,
+        array.desc.mip_levels,
+        pack.regions( 0, layout.levels ) } );
+
+   return true;
+}
+
+void vulkan_wrapper::record_texture_rewrites(
+   const command_buffer_wrapper_t& command_buffer )
+{
+   std::vector<VkMemoryBarrier> memory_barriers;
+   std::vector<VkBufferMemoryBarrier> buffer_barriers;
+
+   for ( auto& rewrite : pending_texture_rewrites )
+   {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = rewrite.image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = rewrite.mip_levels;
+      barrier.subresourceRange.baseArrayLayer = rewrite.layer;
+      barrier.subresourceRange.layerCount = 1;
+
+      // Earlier frames may still sample the texels about to be overwritten
+      barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+      command_buffer.vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         VK_PIPELINE_STAGE_TRANSFER_BIT,
+         0,
+         memory_barriers,
+         buffer_barriers,
+         std::span( &barrier, 1 ) );
+
+      copy_levels_to_image(
+         command_buffer,
+         rewrite.staging_buffer.get(),
+         0,
+         rewrite.image,
+         rewrite.regions );
+
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+      command_buffer.vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_TRANSFER_BIT,
+         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         0,
+         memory_barriers,
+         buffer_barriers,
+         std::span( &barrier, 1 ) );
+
+      // Read until this frame's fence has signalled
+      retire( std::move( rewrite.staging_buffer ) );
+      retire( std::move( rewrite.staging_buffer_memory ) );
+   }
+
+   pending_texture_rewrites.clear();
+}
+
+void vulkan_wrapper::release_retired_resources()
+{
+   while ( !retired_resources.empty() &&
+           frame_number >= retired_resources.front().frame + static_cast<uint64_t>( max_frames_in_flight ) )
+   {
+      retired_resources.pop_front();
+   }
+}
+
+
+auto vulkan_wrapper::create_buffer(
+   VkDeviceSize size,
+   VkBufferUsageFlags usage,
+   VkMemoryPropertyFlags properties )
+   -> std::pair<
+      VkBuffer_resource_t,
+      device_allocation_t>
+{
+   VkBufferCreateInfo buffer_info{
+      .sType = get_sType<VkBufferCreateInfo>(),
+      .size = size,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE };
+
+   auto buffer = logical_device->vkCreateBuffer( buffer_info );
+   if ( buffer.holds_error() )
+   {
+      throw std::runtime_error( "failed to create buffer!" );
+   }
+
+   // Memory requirements
+   VkMemoryRequirements mem_requirements = logical_device->vkGetBufferMemoryRequirements( *buffer.value() );
+
+   // Memory allocation
+   auto buffer_memory = device_allocator->allocate( mem_requirements, properties, device_resource_layout_t::linear );
+
+   auto result =
+      logical_device->vkBindBufferMemory(
+         buffer.value().get(),
+         buffer_memory.memory(),
+         buffer_memory.offset() );
+
+   if ( result != VK_SUCCESS )
+   {
+      throw std::runtime_error( "failed to bind buffer and alloced memory together!" );
+   }
+
+   return
+      std::pair<VkBuffer_resource_t, device_allocation_t>(
+         std::move( buffer ).value(),
+         std::move( buffer_memory ) );
+}
+
+auto vulkan_wrapper::create_device_local_buffer(
+   std::span<const std::byte> contents,
+   VkBufferUsageFlags usage )
+   -> std::pair<
+      VkBuffer_resource_t,
+      device_allocation_t>
+{
+   VkDeviceSize buffer_size = contents.size_bytes();
+
+   auto [staging_buffer, staging_buffer_memory] =
+      create_buffer(
+         buffer_size,
+         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+   memcpy(
+      staging_buffer_memory.mapped_data(),
+      contents.data(),
+      buffer_size );
+
+   auto device_buffer =
+      create_buffer(
+         buffer_size,
+         VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+   copy_buffer(
+      staging_buffer.get(),
+      device_buffer.first.get(),
+      buffer_size );
+
+   return device_buffer;
+}
+
+void vulkan_wrapper::copy_buffer(
    VkBuffer srcBuffer,
    VkBuffer dstBuffer,
    VkDeviceSize size )
 {
-   single_time_command_t command_buffer( logical_device, graphics_queue.value(), command_pool );
+   single_time_command_t command_buffer( logical_device, graphics_queue.value(), command_pool );
+
+   VkBufferCopy copy_region{
+      .srcOffset = 0,   // Optional
+      .dstOffset = 0,   // Optional
+      .size = size };
+
+   command_buffer().vkCmdCopyBuffer(
+      srcBuffer,
+      dstBuffer,
+      std::span<VkBufferCopy>( &copy_region, 1 ) );
+}
+
+void vulkan_wrapper::create_descriptor_set_layout()
+{
+   VkDescriptorSetLayoutBinding uboLayoutBinding{};
+   uboLayoutBinding.binding = 0;
+   uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   uboLayoutBinding.descriptorCount = 1;
+   uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+   uboLayoutBinding.pImmutableSamplers = nullptr;
+
+   texture_table_size = bindless_textures ? bindless_texture_table_size : fallback_texture_table_size;
+
+   VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+   samplerLayoutBinding.binding = 1;
+   samplerLayoutBinding.descriptorCount = texture_table_size;
+   samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+   samplerLayoutBinding.pImmutableSamplers = nullptr;
+   samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+   // Entries not yet written are never read, and new ones are written while the frames
+   // in flight still use the set
+   std::vector<VkDescriptorBindingFlagsEXT> binding_flags = {
+      0,
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+         VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT };
+
+   std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, samplerLayoutBinding };
+
+   // Page cache, page table and feedback buffer of the virtual texture
+   if ( virtual_texture_path.has_value() )
+   {
+      for ( auto type :
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER } )
+      {
+         VkDescriptorSetLayoutBinding binding{};
+         binding.binding = static_cast<uint32_t>( bindings.size() );
+         binding.descriptorCount = 1;
+         binding.descriptorType = type;
+         binding.pImmutableSamplers = nullptr;
+         binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+         bindings.push_back( binding );
+         binding_flags.push_back( 0 );
+      }
+   }
+
+   VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_info{};
+   binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+   binding_flags_info.bindingCount = static_cast<uint32_t>( binding_flags.size() );
+   binding_flags_info.pBindingFlags = binding_flags.data();
+
+   VkDescriptorSetLayoutCreateInfo layoutInfo{};
+   layoutInfo.sType = get_sType<VkDescriptorSetLayoutCreateInfo>();
+   layoutInfo.bindingCount = static_cast<uint32_t>( bindings.size() );
+   layoutInfo.pBindings = bindings.data();
+
+   if ( bindless_textures )
+   {
+      layoutInfo.pNext = &binding_flags_info;
+      layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+   }
+
+   auto result = logical_device->vkCreateDescriptorSetLayout( layoutInfo );
+   if ( result.holds_error() )
+   {
+      throw std::runtime_error( "failed to create descriptor set layout!" );
+   }
+
+   descriptor_set_layout = std::move( result ).value();
+}
+
+void vulkan_wrapper::create_uniform_buffers()
+{
+   VkDeviceSize buffer_size = sizeof( UniformBufferObject );
+
+   uniform_buffers.resize( max_frames_in_flight );
+   uniform_buffers_memory.resize( max_frames_in_flight );
+
+   std::vector<VkBuffer_resource_t>::iterator buffer_iter;
+   std::vector<device_allocation_t>::iterator dev_memory_iter;
+
+   for ( buffer_iter =
+            uniform_buffers.begin(),
+         dev_memory_iter = uniform_buffers_memory.begin();
+         buffer_iter != uniform_buffers.end();
+         ++buffer_iter, ++dev_memory_iter )
+   {
+      std::tie( *buffer_iter, *dev_memory_iter ) =
+         create_buffer(
+            buffer_size,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+   }
+}
+
+void vulkan_wrapper::update_uniform_buffer(
+   uint32_t current_frame )
+{
+   static auto start_time = std::chrono::high_resolution_clock::now();
+
+   auto current_time = std::chrono::high_resolution_clock::now();
+
+   float time =
+      std::chrono::duration<float, std::chrono::seconds::period>( current_time - start_time ).count();
+
+   UniformBufferObject ubo{};
+   ubo.model =
+      glm::rotate(
+         glm::mat4( 1.0f ),
+         time * glm::radians( 90.0f ),
+         glm::vec3( 0.0f, 0.0f, 1.0f ) );
+   ubo.view =
+      glm::lookAt(
+         glm::vec3( 2.0f, 2.0f, 2.0f ),
+         glm::vec3( 0.0f, 0.0f, 0.0f ),
+         glm::vec3( 0.0f, 0.0f, 1.0f ) );
+   ubo.proj =
+      glm::perspective(
+         glm::radians( 45.0f ),
+         swapchain_extent.width / (float)swapchain_extent.height,
+         camera_near_plane,
+         10.0f );
+   ubo.proj[1][1] *= -1;
+
+   // Model state is written by the loader task until the model is resident
+   if ( model_resident )
+   {
+      current_lod = select_lod( ubo );
+
+      if ( meshlet_culling )
+      {
+         ubo.first_meshlet = g_lod_meshlets[current_lod].first_meshlet;
+         ubo.meshlet_count = g_lod_meshlets[current_lod].meshlet_count;
+      }
+
+      ubo.position_scale = glm::vec4( g_vertex_quantization.scale, 0.0f );
+      ubo.position_offset = glm::vec4( g_vertex_quantization.offset, 0.0f );
+   }
+
+   memcpy( uniform_buffers_memory[current_frame].mapped_data(), &ubo, sizeof( ubo ) );
+}
+
+void vulkan_wrapper::create_descriptor_pool()
+{
+   // The virtual texture adds two samplers and a storage buffer per set
+   uint32_t virtual_samplers = virtual_texture_file ? 2 : 0;
+
+   std::array<VkDescriptorPoolSize, 3> poolSizes{};
+   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   poolSizes[0].descriptorCount = static_cast<uint32_t>( max_frames_in_flight );
+   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+   poolSizes[1].descriptorCount = static_cast<uint32_t>( max_frames_in_flight ) * ( texture_table_size + virtual_samplers );
+   poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   poolSizes[2].descriptorCount = static_cast<uint32_t>( max_frames_in_flight );
+
+   VkDescriptorPoolCreateFlags pool_flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+   if ( bindless_textures )
+   {
+      pool_flags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+   }
+
+   VkDescriptorPoolCreateInfo pool_info{
+      .sType = get_sType<VkDescriptorPoolCreateInfo>(),
+      .flags = pool_flags,
+      .maxSets = static_cast<uint32_t>( max_frames_in_flight ),
+      .poolSizeCount = static_cast<uint32_t>( poolSizes.size() ),
+      .pPoolSizes = poolSizes.data() };
+
+   auto result = logical_device->vkCreateDescriptorPool( pool_info );
+   if ( result.holds_error() )
+   {
+      throw std::runtime_error( "failed to create descriptor pool!" );
+   }
+   descriptor_pool = std::move( result ).value();
+}
+
+void vulkan_wrapper::create_descriptor_sets()
+{
+   std::vector<VkDescriptorSetLayout> layouts(
+      max_frames_in_flight,
+      descriptor_set_layout.get() );
+
+   datapath::DPVkDescriptorSetAllocateInfo_t alloc_info{
+      .descriptor_pool = descriptor_pool,
+      .set_layouts = layouts };
+
+   auto result = logical_device->vkAllocateDescriptorSets( alloc_info );
+   if ( result.holds_error() )
+   {
+      throw std::runtime_error( "failed to allocate descriptor sets!" );
+   }
+
+   descriptor_sets = std::move( result ).value();
+
+   for ( size_t i = 0;
+         auto& uniform_buffer : uniform_buffers )
+   {
+      VkDescriptorBufferInfo buffer_info{
+         .buffer = uniform_buffer.get(),
+         .offset = 0,
+         .range = sizeof( UniformBufferObject ) };
+
+      std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+
+      descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descriptorWrites[0].dstSet = descriptor_sets.get()[i];
+      descriptorWrites[0].dstBinding = 0;
+      descriptorWrites[0].dstArrayElement = 0;
+      descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      descriptorWrites[0].descriptorCount = 1;
+      descriptorWrites[0].pBufferInfo = &buffer_info;
+
+      std::vector<VkCopyDescriptorSet> copy_descriptor_set{};
+
+      logical_device->vkUpdateDescriptorSets( descriptorWrites, copy_descriptor_set );
+
+      if ( virtual_texture_file )
+      {
+         std::array<VkDescriptorImageInfo, 2> page_infos{};
+         page_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         page_infos[0].imageView = page_cache_view.get();
+         page_infos[0].sampler = page_cache_sampler.get();
+         page_infos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         page_infos[1].imageView = page_table_view.get();
+         page_infos[1].sampler = page_table_sampler.get();
+
+         VkDescriptorBufferInfo feedback_info{
+            .buffer = feedback_buffers[i].get(),
+            .offset = 0,
+            .range = VK_WHOLE_SIZE };
+
+         std::array<VkWriteDescriptorSet, 3> virtual_writes{};
+         for ( uint32_t k = 0;
+               k < virtual_writes.size();
+               ++k )
+         {
+            virtual_writes[k].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            virtual_writes[k].dstSet = descriptor_sets.get()[i];
+            virtual_writes[k].dstBinding = 2 + k;
+            virtual_writes[k].dstArrayElement = 0;
+            virtual_writes[k].descriptorCount = 1;
+
+            if ( k < page_infos.size() )
+            {
+               virtual_writes[k].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+               virtual_writes[k].pImageInfo = &page_infos[k];
+            }
+            else
+            {
+               virtual_writes[k].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+               virtual_writes[k].pBufferInfo = &feedback_info;
+            }
+         }
+
+         logical_device->vkUpdateDescriptorSets( virtual_writes, copy_descriptor_set );
+      }
+
+      ++i;
+   }
+
+   // A partially bound table only needs the arrays published so far, the fallback table
+   // needs every entry
+   std::vector<uint32_t> entries;
+   uint32_t entry_count = bindless_textures ? static_cast<uint32_t>( texture_arrays.size() ) : texture_table_size;
+
+   for ( uint32_t entry = 0;
+         entry < entry_count;
+         ++entry )
+   {
+      if ( !bindless_textures || texture_arrays[entry].view.get() != VK_NULL_HANDLE )
+      {
+         entries.push_back( entry );
+      }
+   }
+
+   for ( size_t frame = 0;
+         frame < max_frames_in_flight;
+         ++frame )
+   {
+      write_texture_table( frame, entries );
+   }
+
+   pending_texture_table_writes.assign( max_frames_in_flight, {} );
+}
+
+void vulkan_wrapper::publish_texture_array(
+   uint32_t array )
+{
+   // Until the sets exist create_descriptor_sets() writes every published array
+   if ( pending_texture_table_writes.empty() )
+   {
+      return;
+   }
+
+   for ( size_t frame = 0;
+         frame < max_frames_in_flight;
+         ++frame )
+   {
+      if ( bindless_textures )
+      {
+         write_texture_table( frame, std::span( &array, 1 ) );
+      }
+      else
+      {
+         pending_texture_table_writes[frame].push_back( array );
+      }
+   }
+}
+
+void vulkan_wrapper::write_texture_table(
+   size_t frame,
+   std::span<const uint32_t> entries )
+{
+   if ( entries.empty() )
+   {
+      return;
+   }
+
+   // Fallback entries without a published array repeat the model texture's
+   uint32_t model_array = textures.at( model_texture.index ).array;
+
+   std::vector<VkDescriptorImageInfo> image_infos;
+   image_infos.reserve( entries.size() );
+
+   for ( uint32_t entry : entries )
+   {
+      bool published = entry < texture_arrays.size() && texture_arrays[entry].view.get() != VK_NULL_HANDLE;
+      const auto& array = texture_arrays.at( published ? entry : model_array );
+
+      VkDescriptorImageInfo image_info{};
+      image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      image_info.imageView = array.view.get();
+      image_info.sampler = array.sampler.get();
+
+      image_infos.push_back( image_info );
+   }
+
+   std::vector<VkWriteDescriptorSet> descriptor_writes;
+   descriptor_writes.reserve( entries.size() );
+
+   for ( size_t i = 0;
+         i < entries.size();
+         ++i )
+   {
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = descriptor_sets.get()[frame];
+      write.dstBinding = 1;
+      write.dstArrayElement = entries[i];
+      write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      write.descriptorCount = 1;
+      write.pImageInfo = &image_infos[i];
+
+      descriptor_writes.push_back( write );
+   }
+
+   std::vector<VkCopyDescriptorSet> copy_descriptor_set{};
+
+   logical_device->vkUpdateDescriptorSets( descriptor_writes, copy_descriptor_set );
+}
+
+void vulkan_wrapper::flush_texture_table(
+   size_t frame )
+{
+   if ( frame >= pending_texture_table_writes.size() )
+   {
+      return;
+   }
+
+   write_texture_table( frame, pending_texture_table_writes[frame] );
+   pending_texture_table_writes[frame].clear();
+}
+
+void vulkan_wrapper::create_virtual_texture()
+{
+   virtual_texture_file = std::make_unique<virtual_texture_file_t>( *virtual_texture_path );
+   const auto& file = *virtual_texture_file;
+
+   if ( !is_texture_format_supported( file.format() ) )
+   {
+      throw std::runtime_error( "virtual texture format not supported!" );
+   }
+
+   if ( !physical_device->vkGetPhysicalDeviceFeatures().fragmentStoresAndAtomics )
+   {
+      throw std::runtime_error( "virtual texture feedback needs fragmentStoresAndAtomics!" );
+   }
+
+   virtual_texture_cache = std::make_unique<virtual_texture_cache_t>( file, virtual_cache_slots, virtual_cache_slots );
+
+   // One level, pages carry their own mips as pages of coarser levels
+   uint32_t cache_extent = virtual_cache_slots * virtual_page_slot_size;
+   std::tie( page_cache_image, page_cache_image_memory ) =
+      create_image(
+         cache_extent,
+         cache_extent,
+         1,
+         VK_SAMPLE_COUNT_1_BIT,
+         file.format(),
+         VK_IMAGE_TILING_OPTIMAL,
+         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+   page_cache_view = create_image_view( page_cache_image.get(), file.format(), VK_IMAGE_ASPECT_COLOR_BIT, 1 );
+
+   // A layer per level, each as large as level 0's page grid
+   std::tie( page_table_image, page_table_image_memory ) =
+      create_image(
+         file.pages_x( 0 ),
+         file.pages_y( 0 ),
+         1,
+         VK_SAMPLE_COUNT_1_BIT,
+         VK_FORMAT_R8G8B8A8_UINT,
+         VK_IMAGE_TILING_OPTIMAL,
+         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+         file.level_count() );
+   page_table_view =
+      create_image_view(
+         page_table_image.get(),
+         VK_FORMAT_R8G8B8A8_UINT,
+         VK_IMAGE_ASPECT_COLOR_BIT,
+         1,
+         VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+         file.level_count() );
+
+   // The shader picks levels itself, so neither sampler has mips; the page border
+   // keeps bilinear filtering inside a slot
+   auto create_sampler =
+      [this]( VkFilter filter )
+      {
+         VkSamplerCreateInfo sampler_info{};
+         sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+         sampler_info.magFilter = filter;
+         sampler_info.minFilter = filter;
+         sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+         sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+         sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+         sampler_info.anisotropyEnable = VK_FALSE;
+         sampler_info.maxAnisotropy = 1.0f;
+         sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+         sampler_info.unnormalizedCoordinates = VK_FALSE;
+         sampler_info.compareEnable = VK_FALSE;
+         sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+         sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+         sampler_info.mipLodBias = 0.0f;
+         sampler_info.minLod = 0.0f;
+         sampler_info.maxLod = 0.0f;
+
+         auto result = logical_device->vkCreateSampler( sampler_info );
+         if ( result.holds_error() )
+         {
+            throw std::runtime_error( "failed to create virtual texture sampler!" );
+         }
+
+         return std::move( result ).value();
+      };
+
+   page_cache_sampler = create_sampler( VK_FILTER_LINEAR );
+   page_table_sampler = create_sampler( VK_FILTER_NEAREST );
+
+   // Both images are read before their first upload lands, so they start out readable
+   {
+      single_time_command_t command_buffer( logical_device, graphics_queue.value(), command_pool );
+
+      std::array<VkImageMemoryBarrier, 2> barriers{};
+      for ( size_t i = 0;
+            i < barriers.size();
+            ++i )
+      {
+         barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+         barriers[i].srcAccessMask = 0;
+         barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+         barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+         barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         barriers[i].subresourceRange.baseMipLevel = 0;
+         barriers[i].subresourceRange.levelCount = 1;
+         barriers[i].subresourceRange.baseArrayLayer = 0;
+      }
+
+      barriers[0].image = page_cache_image.get();
+      barriers[0].subresourceRange.layerCount = 1;
+      barriers[1].image = page_table_image.get();
+      barriers[1].subresourceRange.layerCount = file.level_count();
+
+      std::vector<VkMemoryBarrier> memory_barriers;
+      std::vector<VkBufferMemoryBarrier> buffer_barriers;
+
+      command_buffer().vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         0,
+         memory_barriers,
+         buffer_barriers,
+         std::span( barriers ) );
+   }
+
+   VkDeviceSize feedback_size = VkDeviceSize{ virtual_feedback_extent } * virtual_feedback_extent * sizeof( uint32_t );
+   VkDeviceSize staging_size =
+      VkDeviceSize{ max_virtual_page_uploads } * file.page_bytes() +
+      virtual_texture_cache->page_table().size_bytes();
+
+   feedback_buffers.resize( max_frames_in_flight );
+   feedback_buffers_memory.resize( max_frames_in_flight );
+   page_staging_buffers.resize( max_frames_in_flight );
+   page_staging_buffers_memory.resize( max_frames_in_flight );
+   page_copies.resize( max_frames_in_flight );
+   page_table_copies.resize( max_frames_in_flight );
+
+   for ( size_t i = 0;
+         i < feedback_buffers.size();
+         ++i )
+   {
+      // Read back on the host every frame
+      std::tie( feedback_buffers[i], feedback_buffers_memory[i] ) =
+         create_buffer(
+            feedback_size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            host_cached_memory_properties() );
+
+      memset( feedback_buffers_memory[i].mapped_data(), 0xFF, feedback_size );
+
+      std::tie( page_staging_buffers[i], page_staging_buffers_memory[i] ) =
+         create_buffer(
+            staging_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+   }
+
+   virtual_texture_report_time = std::chrono::steady_clock::now();
+
+   std::cout << "virtual texture: " << file.width() << "x" << file.height() << ", " << file.level_count()
+             << " levels, " << virtual_cache_slots * virtual_cache_slots << " cache slots" << std::endl;
+}
+
+void vulkan_wrapper::update_virtual_texture(
+   uint32_t frame )
+{
+   const auto& file = *virtual_texture_file;
+   auto& cache = *virtual_texture_cache;
 
-   VkBufferCopy copy_region{
-      .srcOffset = 0,   // Optional
-      .dstOffset = 0,   // Optional
-      .size = size };
+   // Host visible memory stays mapped
+   const auto* feedback_data = reinterpret_cast<const uint32_t*>( feedback_buffers_memory[frame].mapped_data() );
 
-   command_buffer().vkCmdCopyBuffer(
-      srcBuffer,
-      dstBuffer,
-      std::span<VkBufferCopy>( &copy_region, 1 ) );
+   auto uploads =
+      cache.update(
+         std::span( feedback_data, virtual_feedback_extent * virtual_feedback_extent ),
+         max_virtual_page_uploads );
+
+   auto dirty_levels = cache.take_dirty_levels();
+
+   page_copies[frame].clear();
+   page_table_copies[frame].clear();
+
+   if ( !uploads.empty() || !dirty_levels.empty() )
+   {
+      auto* staging_data = page_staging_buffers_memory[frame].mapped_data();
+
+      // Pages come straight from the file mapping; pages not read yet fault in on the pool
+      thread_pool_t::shared().parallel_for(
+         uploads.size(),
+         [&]( size_t i )
+         {
+            auto page = file.page( uploads[i].page );
+            memcpy( staging_data + i * file.page_bytes(), page.data(), page.size() );
+         } );
+
+      for ( size_t i = 0;
+            i < uploads.size();
+            ++i )
+      {
+         VkBufferImageCopy copy{};
+         copy.bufferOffset = i * file.page_bytes();
+         copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         copy.imageSubresource.mipLevel = 0;
+         copy.imageSubresource.baseArrayLayer = 0;
+         copy.imageSubresource.layerCount = 1;
+         copy.imageOffset = {
+            static_cast<int32_t>( uploads[i].slot_x * virtual_page_slot_size ),
+            static_cast<int32_t>( uploads[i].slot_y * virtual_page_slot_size ),
+            0 };
+         copy.imageExtent = { virtual_page_slot_size, virtual_page_slot_size, 1 };
+
+         page_copies[frame].push_back( copy );
+      }
+
+      // Changed page table layers follow the pages
+      VkDeviceSize table_offset = VkDeviceSize{ max_virtual_page_uploads } * file.page_bytes();
+      size_t layer_bytes = cache.page_table_layer_size() * sizeof( uint32_t );
+
+      for ( uint32_t level : dirty_levels )
+      {
+         memcpy(
+            staging_data + table_offset,
+            cache.page_table().data() + level * cache.page_table_layer_size(),
+            layer_bytes );
+
+         VkBufferImageCopy copy{};
+         copy.bufferOffset = table_offset;
+         copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         copy.imageSubresource.mipLevel = 0;
+         copy.imageSubresource.baseArrayLayer = level;
+         copy.imageSubresource.layerCount = 1;
+         copy.imageOffset = { 0, 0, 0 };
+         copy.imageExtent = { file.pages_x( 0 ), file.pages_y( 0 ), 1 };
+
+         page_table_copies[frame].push_back( copy );
+         table_offset += layer_bytes;
+      }
+   }
+
+   auto now = std::chrono::steady_clock::now();
+   double seconds = std::chrono::duration<double>( now - virtual_texture_report_time ).count();
+
+   if ( seconds >= virtual_texture_report_interval )
+   {
+      const auto& stats = cache.statistics();
+      std::cout << "virtual texture: hit rate " << stats.hit_rate() * 100.0 << "%, upload "
+                << static_cast<double>( stats.uploaded_bytes ) / ( 1024.0 * 1024.0 ) / seconds
+                << " MiB/s, popping latency " << stats.average_latency_ms() << " ms avg, " << stats.latency_max_ms
+                << " ms max" << std::endl;
+
+      cache.reset_statistics();
+      virtual_texture_report_time = now;
+   }
 }
 
-void vulkan_wrapper::create_descriptor_set_layout()
+void vulkan_wrapper::record_virtual_texture_uploads(
+   const command_buffer_wrapper_t& command_buffer )
 {
-   VkDescriptorSetLayoutBinding uboLayoutBinding{};
-   uboLayoutBinding.binding = 0;
-   uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-   uboLayoutBinding.descriptorCount = 1;
-   uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-   uboLayoutBinding.pImmutableSamplers = nullptr;
+   const auto& copies = page_copies[current_frame];
+   const auto& table_copies = page_table_copies[current_frame];
 
-   VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-   samplerLayoutBinding.binding = 1;
-   samplerLayoutBinding.descriptorCount = 1;
-   samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-   samplerLayoutBinding.pImmutableSamplers = nullptr;
-   samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+   std::vector<VkMemoryBarrier> memory_barriers;
+   std::vector<VkBufferMemoryBarrier> buffer_barriers;
+   std::vector<VkImageMemoryBarrier> image_barriers;
 
-   std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-   VkDescriptorSetLayoutCreateInfo layoutInfo{};
-   layoutInfo.sType = get_sType<VkDescriptorSetLayoutCreateInfo>();
-   layoutInfo.bindingCount = static_cast<uint32_t>( bindings.size() );
-   layoutInfo.pBindings = bindings.data();
+   auto image_barrier =
+      [&]( VkImage image, uint32_t layer_count )
+      {
+         VkImageMemoryBarrier barrier{};
+         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+         barrier.image = image;
+         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         barrier.subresourceRange.baseMipLevel = 0;
+         barrier.subresourceRange.levelCount = 1;
+         barrier.subresourceRange.baseArrayLayer = 0;
+         barrier.subresourceRange.layerCount = layer_count;
+
+         return barrier;
+      };
 
-   auto result = logical_device->vkCreateDescriptorSetLayout( layoutInfo );
-   if ( result.holds_error() )
+   if ( !copies.empty() )
    {
-      throw std::runtime_error( "failed to create descriptor set layout!" );
+      image_barriers.push_back( image_barrier( page_cache_image.get(), 1 ) );
+   }
+   if ( !table_copies.empty() )
+   {
+      image_barriers.push_back( image_barrier( page_table_image.get(), virtual_texture_file->level_count() ) );
    }
 
-   descriptor_set_layout = std::move( result ).value();
+   if ( !image_barriers.empty() )
+   {
+      // Earlier frames may still sample slots that are about to be overwritten
+      for ( auto& barrier : image_barriers )
+      {
+         barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+         barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+         barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      }
+
+      command_buffer.vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+         VK_PIPELINE_STAGE_TRANSFER_BIT,
+         0,
+         memory_barriers,
+         buffer_barriers,
+         std::span( image_barriers ) );
+
+      if ( !copies.empty() )
+      {
+         command_buffer.vkCmdCopyBufferToImage(
+            page_staging_buffers[current_frame].get(),
+            page_cache_image.get(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            std::span( copies ) );
+      }
+
+      if ( !table_copies.empty() )
+      {
+         command_buffer.vkCmdCopyBufferToImage(
+            page_staging_buffers[current_frame].get(),
+            page_table_image.get(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            std::span( table_copies ) );
+      }
+
+      for ( auto& barrier : image_barriers )
+      {
+         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+         barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+         barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      }
+   }
+
+   // Feedback starts out as "nothing drawn" every frame
+   command_buffer.vkCmdFillBuffer(
+      feedback_buffers[current_frame].get(),
+      0,
+      VK_WHOLE_SIZE,
+      invalid_virtual_page );
+
+   VkBufferMemoryBarrier feedback_barrier{
+      .sType = get_sType<VkBufferMemoryBarrier>(),
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = feedback_buffers[current_frame].get(),
+      .offset = 0,
+      .size = VK_WHOLE_SIZE };
+
+   command_buffer.vkCmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0,
+      memory_barriers,
+      std::span( &feedback_barrier, 1 ),
+      std::span( image_barriers ) );
 }
 
-void vulkan_wrapper::create_uniform_buffers()
+void vulkan_wrapper::record_feedback_readback(
+   const command_buffer_wrapper_t& command_buffer )
 {
-   VkDeviceSize buffer_size = sizeof( UniformBufferObject );
+   // The host reads the feedback once this frame's fence has signalled
+   VkBufferMemoryBarrier feedback_barrier{
+      .sType = get_sType<VkBufferMemoryBarrier>(),
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = feedback_buffers[current_frame].get(),
+      .offset = 0,
+      .size = VK_WHOLE_SIZE };
+
+   std::vector<VkMemoryBarrier> memory_barriers;
+   std::vector<VkImageMemoryBarrier> image_barriers;
+
+   command_buffer.vkCmdPipelineBarrier(
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      memory_barriers,
+      std::span( &feedback_barrier, 1 ),
+      image_barriers );
+}
 
-   uniform_buffers.resize( max_frames_in_flight );
-   uniform_buffers_memory.resize( max_frames_in_flight );
+void vulkan_wrapper::create_meshlet_buffers()
+{
+   // The meshlet table itself arrives with the model upload. Room for the largest LOD with nothing culled
+   uint32_t max_index_count = 0;
+   for ( const auto& lod : g_mesh_lods )
+   {
+      max_index_count = std::max( max_index_count, lod.index_count );
+   }
 
-   std::vector<VkBuffer_resource_t>::iterator buffer_iter;
-   std::vector<VkDeviceMemory_resource_t>::iterator dev_memory_iter;
+   // instance_count stays 1, the culling pass only rewrites index_count
+   VkDrawIndexedIndirectCommand draw_command{
+      .indexCount = 0,
+      .instanceCount = 1,
+      .firstIndex = 0,
+      .vertexOffset = 0,
+      .firstInstance = 0 };
 
-   for ( buffer_iter =
-            uniform_buffers.begin(),
-         dev_memory_iter = uniform_buffers_memory.begin();
-         buffer_iter != uniform_buffers.end();
-         ++buffer_iter, ++dev_memory_iter )
+   visible_index_buffers.resize( max_frames_in_flight );
+   visible_index_buffers_memory.resize( max_frames_in_flight );
+   draw_command_buffers.resize( max_frames_in_flight );
+   draw_command_buffers_memory.resize( max_frames_in_flight );
+
+   for ( size_t i = 0;
+         i < visible_index_buffers.size();
+         ++i )
    {
-      std::tie( *buffer_iter, *dev_memory_iter ) =
+      std::tie( visible_index_buffers[i], visible_index_buffers_memory[i] ) =
          create_buffer(
-            buffer_size,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+            max_index_count * sizeof( uint32_t ),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+      std::tie( draw_command_buffers[i], draw_command_buffers_memory[i] ) =
+         create_device_local_buffer(
+            std::as_bytes( std::span( &draw_command, 1 ) ),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT );
    }
 }
 
-void vulkan_wrapper::update_uniform_buffer(
-   uint32_t current_frame )
+void vulkan_wrapper::create_cull_pipeline()
 {
-   static auto start_time = std::chrono::high_resolution_clock::now();
+   // UBO, meshlets, source indices, visible indices, draw command
+   std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+   for ( uint32_t binding = 0;
+         binding < bindings.size();
+         ++binding )
+   {
+      bindings[binding].binding = binding;
+      bindings[binding].descriptorType =
+         binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[binding].descriptorCount = 1;
+      bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      bindings[binding].pImmutableSamplers = nullptr;
+   }
 
-   auto current_time = std::chrono::high_resolution_clock::now();
+   VkDescriptorSetLayoutCreateInfo layout_info{
+      .sType = get_sType<VkDescriptorSetLayoutCreateInfo>(),
+      .bindingCount = static_cast<uint32_t>( bindings.size() ),
+      .pBindings = bindings.data() };
 
-   float time =
-      std::chrono::duration<float, std::chrono::seconds::period>( current_time - start_time ).count();
+   auto layout_result = logical_device->vkCreateDescriptorSetLayout( layout_info );
+   if ( layout_result.holds_error() )
+   {
+      throw std::runtime_error( "failed to create cull descriptor set layout!" );
+   }
 
-   UniformBufferObject ubo{};
-   ubo.model =
-      glm::rotate(
-         glm::mat4( 1.0f ),
-         time * glm::radians( 90.0f ),
-         glm::vec3( 0.0f, 0.0f, 1.0f ) );
-   ubo.view =
-      glm::lookAt(
-         glm::vec3( 2.0f, 2.0f, 2.0f ),
-         glm::vec3( 0.0f, 0.0f, 0.0f ),
-         glm::vec3( 0.0f, 0.0f, 1.0f ) );
-   ubo.proj =
-      glm::perspective(
-         glm::radians( 45.0f ),
-         swapchain_extent.width / (float)swapchain_extent.height,
-         0.1f,
-         10.0f );
-   ubo.proj[1][1] *= -1;
+   cull_descriptor_set_layout = std::move( layout_result ).value();
 
-   void* data;
-   [[maybe_unused]] auto result =
-      logical_device->vkMapMemory(
-         uniform_buffers_memory[current_frame],
-         0,
-         sizeof( ubo ),
-         0,
-         &data );
-   memcpy( data, &ubo, sizeof( ubo ) );
-   logical_device->vkUnmapMemory( uniform_buffers_memory[current_frame] );
+   VkPipelineLayoutCreateInfo pipeline_layout_info{
+      .sType = get_sType<VkPipelineLayoutCreateInfo>(),
+      .setLayoutCount = 1,
+      .pSetLayouts = &cull_descriptor_set_layout.get(),
+      .pushConstantRangeCount = 0 };
+
+   auto pipeline_layout_result = logical_device->vkCreatePipelineLayout( pipeline_layout_info );
+   if ( pipeline_layout_result.holds_error() )
+   {
+      throw std::runtime_error( "failed to create cull pipeline layout!" );
+   }
+
+   cull_pipeline_layout = std::move( pipeline_layout_result ).value();
+
+   VkComputePipelineCreateInfo pipeline_info{
+      .sType = get_sType<VkComputePipelineCreateInfo>(),
+      .stage{
+         .sType = get_sType<VkPipelineShaderStageCreateInfo>(),
+         .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+         .module = cull_shader_module.get(),
+         .pName = "main" },
+      .layout = cull_pipeline_layout.get(),
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1 };
+
+   VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+   std::span<VkComputePipelineCreateInfo> pipeline_infos{ &pipeline_info, 1 };
+
+   auto cull_pipeline_result = logical_device->vkCreateComputePipelines( pipeline_cache, pipeline_infos );
+   if ( cull_pipeline_result.holds_error() )
+   {
+      throw std::runtime_error( "failed to create cull pipeline!" );
+   }
+
+   cull_pipeline = std::move( cull_pipeline_result ).value();
 }
 
-void vulkan_wrapper::create_descriptor_pool()
+void vulkan_wrapper::create_cull_descriptor_sets()
 {
-   std::array<VkDescriptorPoolSize, 2> poolSizes{};
-   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-   poolSizes[0].descriptorCount = static_cast<uint32_t>( max_frames_in_flight );
-   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-   poolSizes[1].descriptorCount = static_cast<uint32_t>( max_frames_in_flight );
+   std::array<VkDescriptorPoolSize, 2> pool_sizes{};
+   pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   pool_sizes[0].descriptorCount = static_cast<uint32_t>( max_frames_in_flight );
+   pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   pool_sizes[1].descriptorCount = static_cast<uint32_t>( 4 * max_frames_in_flight );
 
    VkDescriptorPoolCreateInfo pool_info{
       .sType = get_sType<VkDescriptorPoolCreateInfo>(),
       .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
       .maxSets = static_cast<uint32_t>( max_frames_in_flight ),
-      .poolSizeCount = static_cast<uint32_t>( poolSizes.size() ),
-      .pPoolSizes = poolSizes.data() };
+      .poolSizeCount = static_cast<uint32_t>( pool_sizes.size() ),
+      .pPoolSizes = pool_sizes.data() };
 
-   auto result = logical_device->vkCreateDescriptorPool( pool_info );
-   if ( result.holds_error() )
+   auto pool_result = logical_device->vkCreateDescriptorPool( pool_info );
+   if ( pool_result.holds_error() )
    {
-      throw std::runtime_error( "failed to create descriptor pool!" );
+      throw std::runtime_error( "failed to create cull descriptor pool!" );
    }
-   descriptor_pool = std::move( result ).value();
-}
+   cull_descriptor_pool = std::move( pool_result ).value();
 
-void vulkan_wrapper::create_descriptor_sets()
-{
    std::vector<VkDescriptorSetLayout> layouts(
       max_frames_in_flight,
-      descriptor_set_layout.get() );
+      cull_descriptor_set_layout.get() );
 
    datapath::DPVkDescriptorSetAllocateInfo_t alloc_info{
-      .descriptor_pool = descriptor_pool,
+      .descriptor_pool = cull_descriptor_pool,
       .set_layouts = layouts };
 
    auto result = logical_device->vkAllocateDescriptorSets( alloc_info );
    if ( result.holds_error() )
    {
-      throw std::runtime_error( "failed to allocate descriptor sets!" );
+      throw std::runtime_error( "failed to allocate cull descriptor sets!" );
    }
 
-   descriptor_sets = std::move( result ).value();
+   cull_descriptor_sets = std::move( result ).value();
 
    for ( size_t i = 0;
-         auto& uniform_buffer : uniform_buffers )
+         i < uniform_buffers.size();
+         ++i )
    {
-      VkDescriptorBufferInfo buffer_info{
-         .buffer = uniform_buffer.get(),
-         .offset = 0,
-         .range = sizeof( UniformBufferObject ) };
+      std::array<VkDescriptorBufferInfo, 5> buffer_infos{ {
+         { .buffer = uniform_buffers[i].get(), .offset = 0, .range = sizeof( UniformBufferObject ) },
+         { .buffer = meshlet_buffer.get(), .offset = 0, .range = VK_WHOLE_SIZE },
+         { .buffer = index_buffer.get(), .offset = 0, .range = VK_WHOLE_SIZE },
+         { .buffer = visible_index_buffers[i].get(), .offset = 0, .range = VK_WHOLE_SIZE },
+         { .buffer = draw_command_buffers[i].get(), .offset = 0, .range = VK_WHOLE_SIZE } } };
+
+      std::array<VkWriteDescriptorSet, 5> descriptor_writes{};
+      for ( uint32_t binding = 0;
+            binding < descriptor_writes.size();
+            ++binding )
+      {
+         descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+         descriptor_writes[binding].dstSet = cull_descriptor_sets.get()[i];
+         descriptor_writes[binding].dstBinding = binding;
+         descriptor_writes[binding].dstArrayElement = 0;
+         descriptor_writes[binding].descriptorType =
+            binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+         descriptor_writes[binding].descriptorCount = 1;
+         descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+      }
 
-      VkDescriptorImageInfo imageInfo{};
-      imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfo.imageView = *texture_image_view;
-      imageInfo.sampler = *texture_sampler;
+      std::vector<VkCopyDescriptorSet> copy_descriptor_set{};
 
-      std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+      logical_device->vkUpdateDescriptorSets( descriptor_writes, copy_descriptor_set );
+   }
+}
 
-      descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[0].dstSet = descriptor_sets.get()[i];
-      descriptorWrites[0].dstBinding = 0;
-      descriptorWrites[0].dstArrayElement = 0;
-      descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[0].descriptorCount = 1;
-      descriptorWrites[0].pBufferInfo = &buffer_info;
+void vulkan_wrapper::record_meshlet_culling(
+   command_buffer_wrapper_t& command_buffer )
+{
+   VkBuffer draw_command_buffer = draw_command_buffers[current_frame].get();
 
-      descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[1].dstSet = descriptor_sets.get()[i];
-      descriptorWrites[1].dstBinding = 1;
-      descriptorWrites[1].dstArrayElement = 0;
-      descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      descriptorWrites[1].descriptorCount = 1;
-      descriptorWrites[1].pImageInfo = &imageInfo;
+   // Only index_count is reset, the rest of the command never changes
+   command_buffer.vkCmdFillBuffer(
+      draw_command_buffer,
+      offsetof( VkDrawIndexedIndirectCommand, indexCount ),
+      sizeof( uint32_t ),
+      0 );
 
-      std::vector<VkCopyDescriptorSet> copy_descriptor_set{};
+   std::vector<VkBufferMemoryBarrier> BufferMemoryBarriers;
+   std::vector<VkImageMemoryBarrier> ImageMemoryBarriers;
 
-      logical_device->vkUpdateDescriptorSets( descriptorWrites, copy_descriptor_set );
+   VkMemoryBarrier reset_barrier{
+      .sType = get_sType<VkMemoryBarrier>(),
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
 
-      ++i;
-   }
+   command_buffer.vkCmdPipelineBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      std::span( &reset_barrier, 1 ),
+      BufferMemoryBarriers,
+      ImageMemoryBarriers );
+
+   command_buffer.vkCmdBindPipeline(
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      cull_pipeline.front().get() );
+
+   std::vector<uint32_t> dynamic_offsets{};
+
+   command_buffer.vkCmdBindDescriptorSets(
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      *cull_pipeline_layout,
+      0,
+      std::span( &cull_descriptor_sets.get()[current_frame], 1 ),
+      dynamic_offsets );
+
+   uint32_t meshlet_count = g_lod_meshlets[current_lod].meshlet_count;
+   command_buffer.vkCmdDispatch(
+      ( meshlet_count + meshlet_cull_group_size - 1 ) / meshlet_cull_group_size,
+      1,
+      1 );
+
+   VkMemoryBarrier cull_barrier{
+      .sType = get_sType<VkMemoryBarrier>(),
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT };
+
+   command_buffer.vkCmdPipelineBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      0,
+      std::span( &cull_barrier, 1 ),
+      BufferMemoryBarriers,
+      ImageMemoryBarriers );
 }
 
 //_____________________________________________________________________________
@@ -1532,10 +3352,11 @@ auto vulkan_wrapper::create_image(
    VkFormat format,
    VkImageTiling tiling,
    VkBufferUsageFlags usage,
-   VkMemoryPropertyFlags properties )
+   VkMemoryPropertyFlags properties,
+   uint32_t array_layers )
    -> std::pair<
       VkImage_resource_t,
-      VkDeviceMemory_resource_t>
+      device_allocation_t>
 {
    VkImageCreateInfo image_info{
       .sType = get_sType<VkImageCreateInfo>(),
@@ -1544,7 +3365,7 @@ auto vulkan_wrapper::create_image(
       .format = format,
       .extent = { static_cast<uint32_t>( tex_width ), static_cast<uint32_t>( tex_height ), 1 },
       .mipLevels = mip_levels,
-      .arrayLayers = 1,
+      .arrayLayers = array_layers,
       .samples = num_samples,   // VK_SAMPLE_COUNT_1_BIT,
       .tiling = tiling,
       .usage = usage,
@@ -1562,24 +3383,18 @@ auto vulkan_wrapper::create_image(
    // Memory requirements
    VkMemoryRequirements mem_requirements = logical_device->vkGetImageMemoryRequirements( *image.value() );
 
-   // Memory allocation
-   VkMemoryAllocateInfo alloc_info{
-      .sType = get_sType<VkMemoryAllocateInfo>(),
-      .allocationSize = mem_requirements.size,
-      .memoryTypeIndex = find_memory_type( mem_requirements.memoryTypeBits, properties ) };
-
-   auto buffer_memory = logical_device->vkAllocateMemory( alloc_info );
-
-   if ( buffer_memory.holds_error() )
-   {
-      throw std::runtime_error( "failed to allocate image memory!" );
-   }
+   // Linear images share blocks with buffers, optimal ones may not
+   auto image_memory =
+      device_allocator->allocate(
+         mem_requirements,
+         properties,
+         tiling == VK_IMAGE_TILING_LINEAR ? device_resource_layout_t::linear : device_resource_layout_t::optimal );
 
    auto result =
       logical_device->vkBindImageMemory(
          image.value().get(),
-         buffer_memory.value().get(),
-         0 );
+         image_memory.memory(),
+         image_memory.offset() );
 
    if ( result != VK_SUCCESS )
    {
@@ -1587,9 +3402,9 @@ auto vulkan_wrapper::create_image(
    }
 
    return
-      std::pair<VkImage_resource_t, VkDeviceMemory_resource_t>(
+      std::pair<VkImage_resource_t, device_allocation_t>(
          std::move( image ).value(),
-         std::move( buffer_memory ).value() );
+         std::move( image_memory ) );
 }
 
 
@@ -1836,99 +3651,578 @@ void vulkan_wrapper::copy_buffer_to_image(
       std::span( &region, 1 ) );
 }
 
+void vulkan_wrapper::copy_levels_to_image(
+   const command_buffer_wrapper_t& command_buffer,
+   VkBuffer buffer,
+   VkDeviceSize buffer_offset,
+   VkImage image,
+   std::span<const texture_region_t> regions )
+{
+   std::vector<VkBufferImageCopy> copies;
+   copies.reserve( regions.size() );
+
+   for ( const auto& region : regions )
+   {
+      VkBufferImageCopy copy{};
+      copy.bufferOffset = buffer_offset + region.buffer_offset;
+      copy.bufferRowLength = 0;
+      copy.bufferImageHeight = 0;
+
+      copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      copy.imageSubresource.mipLevel = region.level;
+      copy.imageSubresource.baseArrayLayer = region.layer;
+      copy.imageSubresource.layerCount = 1;
+
+      copy.imageOffset = { static_cast<int32_t>( region.x ), static_cast<int32_t>( region.y ), 0 };
+      copy.imageExtent = { region.width, region.height, 1 };
+
+      copies.push_back( copy );
+   }
+
+   command_buffer.vkCmdCopyBufferToImage(
+      buffer,
+      image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      std::span( copies ) );
+}
+
 
 //______________________________________________________________________________
 // Images
-void vulkan_wrapper::create_texture_image()
+auto vulkan_wrapper::load_textures(
+   std::span<const std::filesystem::path> sources )
+   -> std::vector<texture_handle_t>
 {
-   int tex_width, tex_height, tex_channels;
-   // stbi_uc* pixels =
-   //    stbi_load( "textures/texture.jpg", &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha );
-   stbi_uc* pixels =
-      stbi_load(
-         TEXTURE_PATH.c_str(),
-         &tex_width,
-         &tex_height,
-         &tex_channels,
-         STBI_rgb_alpha );
-   VkDeviceSize image_size = tex_width * tex_height * 4;
+   using clock_t = std::chrono::steady_clock;
+   auto start_time = clock_t::now();
+
+   VkFormat preferred_format = choose_texture_format();
+
+   auto cache_path_of =
+      []( const std::filesystem::path& source )
+      {
+         auto path = source;
+         path += ".ktx2";
+         return path;
+      };
+
+   struct pending_texture_t
+   {
+      // Unset when the texture has to be cooked
+      std::optional<texture_cache_t> cache;
+      texture_layout_t layout;
+      VkDeviceSize staging_offset{ 0 };
+   };
+
+   // Textures [first, end) share a staging buffer and one submission
+   struct texture_batch_t
+   {
+      size_t first{ 0 };
+      size_t end{ 0 };
+      VkDeviceSize staging_size{ 0 };
+      bool cooks{ false };
+      // Arrays first written by this batch, and those it writes last and so publishes
+      std::vector<size_t> opened_arrays;
+      std::vector<size_t> completed_arrays;
+
+      VkBuffer_resource_t staging_buffer;
+      device_allocation_t staging_buffer_memory;
+      std::vector<command_buffer_wrapper_t> command_buffers;
+      datapath::VkFence_resource_t fence;
+      clock_t::time_point submit_time;
+   };
+
+   std::vector<pending_texture_t> pending( sources.size() );
+
+   // Caches are opened and image headers read up front, so every texture's staging
+   // range is known before anything is decoded
+   thread_pool_t::shared().parallel_for(
+      sources.size(),
+      [&]( size_t i )
+      {
+         auto& texture = pending[i];
+
+         // A packed cache is read in place, else the loose one next to the source. A cache
+         // cooked on another device in a format this one lacks is cooked again.
+         if ( auto packed = asset_archive.find( cache_path_of( sources[i] ).generic_string() ) )
+         {
+            texture.cache = texture_cache_t::open( packed->data );
+         }
+
+         if ( !texture.cache.has_value() || texture.cache->view().format != preferred_format )
+         {
+            texture.cache = texture_cache_t::open( cache_path_of( sources[i] ), sources[i] );
+         }
+
+         if ( texture.cache.has_value() && texture.cache->view().format == preferred_format )
+         {
+            auto view = texture.cache->view();
+            texture.layout = { view.format, view.width, view.height, { view.levels.begin(), view.levels.end() } };
+         }
+         else
+         {
+            texture.cache.reset();
+            texture.layout = read_texture_layout( sources[i], preferred_format );
+         }
+      } );
+
+   std::vector<texture_batch_t> batches;
+   for ( size_t i = 0;
+         i < pending.size();
+         ++i )
+   {
+      VkDeviceSize size = pending[i].layout.data_size();
+
+      // A texture larger than the budget gets a batch of its own
+      if ( batches.empty() ||
+           ( batches.back().staging_size > 0 && batches.back().staging_size + size > texture_staging_budget ) )
+      {
+         batches.emplace_back();
+         batches.back().first = i;
+      }
+
+      auto& batch = batches.back();
+      pending[i].staging_offset = batch.staging_size;
+      batch.staging_size += ( size + texture_staging_alignment - 1 ) & ~( texture_staging_alignment - 1 );
+      batch.cooks = batch.cooks || !pending[i].cache.has_value();
+      batch.end = i + 1;
+   }
 
-   if ( !pixels )
+   // Handles are valid from here on; their bindings stay null until published
+   std::vector<texture_handle_t> handles;
+   for ( size_t i = 0;
+         i < sources.size();
+         ++i )
    {
-      throw std::runtime_error( "failed to load texture image!" );
+      handles.push_back( { static_cast<uint32_t>( textures.size() + i ) } );
    }
 
-   mip_levels = static_cast<uint32_t>( std::floor(
-                   std::log2(
-                      std::max( tex_width, tex_height ) ) ) ) +
-                1;
+   size_t first_slot = textures.size();
+   textures.resize( textures.size() + sources.size() );
+
+   // Same sized textures become layers of one array and small ones share atlas pages,
+   // so a descriptor per array rather than per texture is bound
+   std::vector<packable_texture_t> packables;
+   for ( const auto& texture : pending )
+   {
+      const auto& layout = texture.layout;
+      packables.push_back( { layout.format, layout.width, layout.height, static_cast<uint32_t>( layout.levels.size() ) } );
+   }
 
-   //
-   VkBuffer_resource_t staging_buffer;
-   VkDeviceMemory_resource_t staging_buffer_memory;
+   auto pack = plan_texture_packing( packables );
 
-   std::tie( staging_buffer, staging_buffer_memory ) =
-      create_buffer(
-         image_size,
-         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+   // Every array takes the texture table entry of its index
+   if ( texture_arrays.size() + pack.arrays.size() > texture_table_size )
+   {
+      throw std::runtime_error( "texture table full!" );
+   }
+
+   size_t first_array = texture_arrays.size();
+   texture_arrays.resize( texture_arrays.size() + pack.arrays.size() );
+
+   for ( size_t a = 0;
+         a < pack.arrays.size();
+         ++a )
+   {
+      auto& array = texture_arrays[first_array + a];
+      array.desc = pack.arrays[a];
+
+      std::tie( array.image, array.image_memory ) =
+         create_image(
+            array.desc.width,
+            array.desc.height,
+            array.desc.mip_levels,
+            VK_SAMPLE_COUNT_1_BIT,
+            array.desc.format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            array.desc.layer_count );
+   }
+
+   for ( size_t i = 0;
+         i < pending.size();
+         ++i )
+   {
+      const auto& layout = pending[i].layout;
+      auto& slot = textures[first_slot + i];
+
+      slot.format = layout.format;
+      slot.width = layout.width;
+      slot.height = layout.height;
+      slot.mip_levels = pack.placements[i].mip_levels;
+      slot.array = static_cast<uint32_t>( first_array + pack.placements[i].array );
+      slot.remap = pack.remap( i );
+      slot.placement = pack.placements[i];
+      slot.placement.array = slot.array;
+   }
+
+   // An array's layout changes with the first batch writing it and back with the last
+   // one; submissions on the queue run in order, so batches in between copy into it as is
+   std::vector<size_t> first_batch( pack.arrays.size(), batches.size() );
+   std::vector<size_t> last_batch( pack.arrays.size(), 0 );
+
+   for ( size_t b = 0;
+         b < batches.size();
+         ++b )
+   {
+      for ( size_t i = batches[b].first;
+            i < batches[b].end;
+            ++i )
+      {
+         size_t a = pack.placements[i].array;
+         first_batch[a] = std::min( first_batch[a], b );
+         last_batch[a] = std::max( last_batch[a], b );
+      }
+   }
+
+   for ( size_t a = 0;
+         a < pack.arrays.size();
+         ++a )
+   {
+      batches[first_batch[a]].opened_arrays.push_back( first_array + a );
+      batches[last_batch[a]].completed_arrays.push_back( first_array + a );
+   }
+
+   double decode_seconds = 0.0;
+   double upload_seconds = 0.0;
+   double decoded_megapixels = 0.0;
+   VkDeviceSize staged_bytes = 0;
+
+   // Waits for a submitted batch, then publishes its views and samplers
+   auto finish_batch =
+      [&]( texture_batch_t& batch )
+      {
+         std::span<const VkFence> fences{ &batch.fence.get(), 1 };
+         if ( logical_device->vkWaitForFences( fences, VK_TRUE, UINT64_MAX ) != VK_SUCCESS )
+         {
+            throw std::runtime_error( "failed to wait for texture upload!" );
+         }
+
+         upload_seconds += std::chrono::duration<double>( clock_t::now() - batch.submit_time ).count();
+
+         for ( size_t a : batch.completed_arrays )
+         {
+            auto& array = texture_arrays[a];
+            array.view =
+               create_image_view(
+                  *array.image,
+                  array.desc.format,
+                  VK_IMAGE_ASPECT_COLOR_BIT,
+                  array.desc.mip_levels,
+                  VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                  array.desc.layer_count );
+            array.sampler = create_texture_sampler( array.desc.mip_levels );
+
+            publish_texture_array( static_cast<uint32_t>( a ) );
+         }
+
+         batch.command_buffers.clear();
+         batch.staging_buffer.reset();
+         batch.staging_buffer_memory.reset();
+      };
+
+   // While one batch uploads the next one is decoded, so at most two staging buffers
+   // are alive at a time
+   texture_batch_t* in_flight = nullptr;
+
+   // Unwinding destroys the staging buffer, command buffer and fence of the batch in
+   // flight, so an exception first waits for the GPU to be done with them
+   struct in_flight_guard_t
+   {
+      const datapath::device_dispatcher_t& device;
+      texture_batch_t*& batch;
+      int exceptions{ std::uncaught_exceptions() };
+
+      ~in_flight_guard_t()
+      {
+         if ( batch && std::uncaught_exceptions() > exceptions )
+         {
+            std::span<const VkFence> fences{ &batch->fence.get(), 1 };
+            [[maybe_unused]] auto result = device.vkWaitForFences( fences, VK_TRUE, UINT64_MAX );
+         }
+      }
+   };
+
+   in_flight_guard_t in_flight_guard{ *logical_device, in_flight };
 
-   void* data;
-   [[maybe_unused]] auto result =
-      logical_device->vkMapMemory(
-         staging_buffer_memory.get(),
+   for ( auto& batch : batches )
+   {
+      std::tie( batch.staging_buffer, batch.staging_buffer_memory ) =
+         create_buffer(
+            batch.staging_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            batch.cooks ? host_cached_memory_properties()
+                        : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+      auto* staging_data = batch.staging_buffer_memory.mapped_data();
+
+      // Cache hits are only copied, so they do not count towards the decode rate
+      for ( size_t i = batch.first;
+            i < batch.end;
+            ++i )
+      {
+         if ( !pending[i].cache.has_value() )
+         {
+            decoded_megapixels += static_cast<double>( pending[i].layout.width ) * pending[i].layout.height / 1e6;
+         }
+      }
+
+      // Every texture is copied or cooked straight into its range of the staging buffer
+      auto decode_start = clock_t::now();
+
+      thread_pool_t::shared().parallel_for(
+         batch.end - batch.first,
+         [&]( size_t k )
+         {
+            size_t i = batch.first + k;
+            auto& texture = pending[i];
+            std::span<std::byte> target( staging_data + texture.staging_offset, texture.layout.data_size() );
+
+            if ( texture.cache.has_value() )
+            {
+               auto view = texture.cache->view();
+               memcpy( target.data(), view.data.data(), target.size() );
+               texture.cache.reset();
+               return;
+            }
+
+            cook_texture_into(
+               sources[i],
+               preferred_format,
+               [&]( size_t size )
+               {
+                  return target.first( std::min( size, target.size() ) );
+               } );
+
+            // A missing cache only costs the next start, so failing to write it is not fatal
+            try
+            {
+               texture_cache_t::write( cache_path_of( sources[i] ), sources[i], texture.layout.view( target ) );
+            }
+            catch ( const std::exception& e )
+            {
+               std::cerr << "texture cache not written: " << e.what() << std::endl;
+            }
+         } );
+
+      decode_seconds += std::chrono::duration<double>( clock_t::now() - decode_start ).count();
+
+      // One command buffer per batch: a barrier for the arrays it opens, every copy, a
+      // barrier for the arrays it completes
+      DPVkCommandBufferAllocateInfo_t command_buffer_alloc_info{
+         .command_pool = command_pool,
+         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+         .command_buffer_count = 1 };
+
+      auto command_buffer_result = logical_device->vkAllocateCommandBuffers( command_buffer_alloc_info );
+      if ( command_buffer_result.holds_error() )
+      {
+         throw std::runtime_error( "failed to allocate texture upload command buffer!" );
+      }
+
+      batch.command_buffers = std::move( command_buffer_result ).value();
+      const auto& command_buffer = batch.command_buffers.front();
+
+      VkCommandBufferBeginInfo begin_info{
+         .sType = get_sType<VkCommandBufferBeginInfo>(),
+         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+         .pInheritanceInfo = nullptr };
+
+      if ( command_buffer.vkBeginCommandBuffer( begin_info ) != VK_SUCCESS )
+      {
+         throw std::runtime_error( "failed to begin recording texture upload command buffer!" );
+      }
+
+      auto array_barrier =
+         [&]( size_t a )
+         {
+            const auto& array = texture_arrays[a];
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = array.image.get();
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = array.desc.mip_levels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = array.desc.layer_count;
+
+            return barrier;
+         };
+
+      std::vector<VkImageMemoryBarrier> barriers;
+
+      for ( size_t a : batch.opened_arrays )
+      {
+         VkImageMemoryBarrier barrier = array_barrier( a );
+         barrier.srcAccessMask = 0;
+         barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+         barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+         barriers.push_back( barrier );
+      }
+
+      std::vector<VkMemoryBarrier> memory_barriers;
+      std::vector<VkBufferMemoryBarrier> buffer_barriers;
+
+      command_buffer.vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+         VK_PIPELINE_STAGE_TRANSFER_BIT,
          0,
-         image_size,
+         memory_barriers,
+         buffer_barriers,
+         std::span( barriers ) );
+
+      for ( size_t i = batch.first;
+            i < batch.end;
+            ++i )
+      {
+         copy_levels_to_image(
+            command_buffer,
+            batch.staging_buffer.get(),
+            pending[i].staging_offset,
+            texture_arrays[textures[first_slot + i].array].image.get(),
+            pack.regions( i, pending[i].layout.levels ) );
+      }
+
+      barriers.clear();
+
+      for ( size_t a : batch.completed_arrays )
+      {
+         VkImageMemoryBarrier barrier = array_barrier( a );
+         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+         barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+         barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+         barriers.push_back( barrier );
+      }
+
+      command_buffer.vkCmdPipelineBarrier(
+         VK_PIPELINE_STAGE_TRANSFER_BIT,
+         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
          0,
-         &data );
-   memcpy( data, pixels, static_cast<size_t>( image_size ) );
-   logical_device->vkUnmapMemory(
-      staging_buffer_memory.get() );
+         memory_barriers,
+         buffer_barriers,
+         std::span( barriers ) );
 
-   stbi_image_free( pixels );
+      if ( command_buffer.vkEndCommandBuffer() != VK_SUCCESS )
+      {
+         throw std::runtime_error( "failed to record texture upload command buffer!" );
+      }
 
+      VkFenceCreateInfo fence_info{
+         .sType = get_sType<VkFenceCreateInfo>(),
+         .flags = 0 };
 
-   //
-   std::tie( texture_image, texture_image_memory ) =
-      create_image(
-         tex_width,
-         tex_height,
-         mip_levels,
-         VK_SAMPLE_COUNT_1_BIT,
-         VK_FORMAT_R8G8B8A8_SRGB,
-         VK_IMAGE_TILING_OPTIMAL,
-         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+      auto fence_result = logical_device->vkCreateFence( fence_info );
+      if ( fence_result.holds_error() )
+      {
+         throw std::runtime_error( "failed to create texture upload fence!" );
+      }
 
-   transition_image_layout(
-      texture_image.get(),
-      VK_FORMAT_R8G8B8A8_SRGB,
-      VK_IMAGE_LAYOUT_UNDEFINED,
-      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-      mip_levels );
+      batch.fence = std::move( fence_result ).value();
+
+      // The previous batch has had this batch's decode time to finish
+      if ( in_flight )
+      {
+         finish_batch( *in_flight );
+      }
+
+      VkCommandBuffer command_buffer_handle = command_buffer.handle();
+      VkSubmitInfo submit_info{
+         .sType = get_sType<VkSubmitInfo>(),
+         .commandBufferCount = 1,
+         .pCommandBuffers = &command_buffer_handle };
+
+      if ( graphics_queue->vkQueueSubmit( std::span<const VkSubmitInfo>( &submit_info, 1 ), batch.fence ) !=
+           VK_SUCCESS )
+      {
+         throw std::runtime_error( "failed to submit texture upload!" );
+      }
+
+      batch.submit_time = clock_t::now();
+      staged_bytes += batch.staging_size;
+      in_flight = &batch;
+   }
+
+   if ( in_flight )
+   {
+      finish_batch( *in_flight );
+   }
+
+   // Upload time runs from submit until the fence is seen, which includes decoding
+   // the next batch, so upload throughput is a lower bound
+   double total_seconds = std::chrono::duration<double>( clock_t::now() - start_time ).count();
+   double staged_megabytes = static_cast<double>( staged_bytes ) / ( 1024.0 * 1024.0 );
+
+   std::cout << "textures: " << sources.size() << " in " << pack.arrays.size() << " arrays, " << batches.size()
+             << " submissions, " << staged_megabytes << " MiB in " << total_seconds * 1000.0 << " ms; decode "
+             << decoded_megapixels / decode_seconds << " MPix/s, upload " << staged_megabytes / upload_seconds
+             << " MiB/s, total " << staged_megabytes / total_seconds << " MiB/s" << std::endl;
+
+   return handles;
+}
+
+auto vulkan_wrapper::texture_binding(
+   texture_handle_t handle ) const
+   -> texture_binding_t
+{
+   // Both handles are null until finish_batch() in load_textures() created them
+   const auto& slot = textures.at( handle.index );
+   const auto& array = texture_arrays.at( slot.array );
+   return { array.view.get(), array.sampler.get(), slot.array, slot.remap };
+}
 
-   copy_buffer_to_image(
-      *staging_buffer,
-      *texture_image,
-      static_cast<uint32_t>( tex_width ),
-      static_cast<uint32_t>( tex_height ) );
+auto vulkan_wrapper::host_cached_memory_properties()
+   -> VkMemoryPropertyFlags
+{
+   VkMemoryPropertyFlags cached =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+   VkPhysicalDeviceMemoryProperties mem_properties = physical_device->vkGetPhysicalDeviceMemoryProperties();
 
-   // transition_image_layout(
-   //    texture_image.get(),
-   //    VK_FORMAT_R8G8B8A8_SRGB,
-   //    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-   //    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-   //    mip_levels );
+   for ( uint32_t i = 0;
+         i < mem_properties.memoryTypeCount;
+         i++ )
+   {
+      if ( ( mem_properties.memoryTypes[i].propertyFlags & cached ) == cached )
+      {
+         return cached;
+      }
+   }
 
-   //
-   generate_mipmaps( *texture_image, VK_FORMAT_R8G8B8A8_SRGB, tex_width, tex_height, mip_levels );
+   // Reading back is slow from write-combined memory but still correct
+   return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 }
 
+auto vulkan_wrapper::choose_texture_format()
+   -> VkFormat
+{
+   // BC7 keeps alpha and most detail; BC1 is half the size but opaque only
+   for ( VkFormat format : { VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK } )
+   {
+      if ( is_texture_format_supported( format ) )
+      {
+         return format;
+      }
+   }
+
+   return VK_FORMAT_R8G8B8A8_SRGB;
+}
 
-void vulkan_wrapper::create_texture_image_view()
+auto vulkan_wrapper::is_texture_format_supported(
+   VkFormat format )
+   -> bool
 {
-   texture_image_view =
-      create_image_view( *texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels );
+   VkFormatProperties props = physical_device->vkGetPhysicalDeviceFormatProperties( format );
+
+   VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+   return ( props.optimalTilingFeatures & required ) == required;
 }
 
 
@@ -1936,19 +4230,21 @@ auto vulkan_wrapper::create_image_view(
    VkImage image,
    VkFormat format,
    VkImageAspectFlags aspectFlags,
-   uint32_t mipLevels )
+   uint32_t mipLevels,
+   VkImageViewType view_type,
+   uint32_t layer_count )
    -> VkImageView_resource_t
 {
    VkImageViewCreateInfo viewInfo{};
    viewInfo.sType = get_sType<VkImageViewCreateInfo>();
    viewInfo.image = image;
-   viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+   viewInfo.viewType = view_type;
    viewInfo.format = format;
    viewInfo.subresourceRange.aspectMask = aspectFlags;   // VK_IMAGE_ASPECT_COLOR_BIT;
    viewInfo.subresourceRange.baseMipLevel = 0;
    viewInfo.subresourceRange.levelCount = mipLevels;
    viewInfo.subresourceRange.baseArrayLayer = 0;
-   viewInfo.subresourceRange.layerCount = 1;
+   viewInfo.subresourceRange.layerCount = layer_count;
 
    auto image_view = logical_device->vkCreateImageView( viewInfo );
 
@@ -1960,7 +4256,9 @@ auto vulkan_wrapper::create_image_view(
    return std::move( image_view ).value();
 }
 
-void vulkan_wrapper::create_texture_sampler()
+auto vulkan_wrapper::create_texture_sampler(
+   uint32_t mip_levels )
+   -> VkSampler_resource_t
 {
    auto properties = physical_device->vkGetPhysicalDeviceProperties();
 
@@ -1992,7 +4290,7 @@ void vulkan_wrapper::create_texture_sampler()
       throw std::runtime_error( "failed to create texture sampler!" );
    }
 
-   texture_sampler = std::move( result ).value();
+   return std::move( result ).value();
 }
 
 void vulkan_wrapper::create_depth_resources()
@@ -2068,53 +4366,212 @@ bool vulkan_wrapper::has_stencil_component(
 
 void vulkan_wrapper::load_model()
 {
-   tinyobj::attrib_t attrib;
-   std::vector<tinyobj::shape_t> shapes;
-   std::vector<tinyobj::material_t> materials;
-   std::string warn, err;
+   // A packed cache is used as it is; there may be no loose source to check it against
+   g_mesh_cache.reset();
+   if ( auto packed = asset_archive.find( MODEL_CACHE_PATH ) )
+   {
+      g_mesh_cache = mesh_cache_t::open( packed->data, mesh_import_options.key() );
+   }
+
+   if ( !g_mesh_cache.has_value() )
+   {
+      g_mesh_cache = mesh_cache_t::open( MODEL_CACHE_PATH, MODEL_PATH, mesh_import_options.key() );
+   }
+
+   if ( g_mesh_cache.has_value() )
+   {
+      // The cache is mapped, so the buffers are filled straight from the file
+      g_indices.clear();
+      vertices.clear();
+      g_mesh_vertices = g_mesh_cache->vertices();
+      g_mesh_indices = g_mesh_cache->indices();
+      g_mesh_lods = g_mesh_cache->lods();
+      g_mesh_bounds = g_mesh_cache->bounds();
+      return;
+   }
+
+   auto model_source = read_file( MODEL_PATH );
+   auto mesh = cook_mesh( model_source.data(), mesh_import_options, std::cout );
+
+   vertices = std::move( mesh.vertices );
+   g_indices = std::move( mesh.indices );
+   g_lods = std::move( mesh.lods );
+   g_mesh_bounds = mesh.bounds;
+
+   g_mesh_vertices = vertices;
+   g_mesh_indices = g_indices;
+   g_mesh_lods = g_lods;
+
+   // The archive is never rewritten; a packed source only gets a cache by packing again
+   if ( model_source.is_archived() )
+   {
+      return;
+   }
+
+   // A missing cache only costs the next start, so failing to write it is not fatal
+   try
+   {
+      mesh_cache_t::write(
+         MODEL_CACHE_PATH,
+         MODEL_PATH,
+         mesh_import_options.key(),
+         g_mesh_vertices,
+         g_mesh_indices,
+         g_mesh_lods,
+         g_mesh_bounds );
+   }
+   catch ( const std::exception& e )
+   {
+      std::cerr << "mesh cache not written: " << e.what() << std::endl;
+   }
+}
+
+void vulkan_wrapper::choose_vertex_layout()
+{
+   packed_vertex_layout = mesh_import_options.packed_vertices && can_pack_vertices( g_mesh_vertices );
 
-   if ( !tinyobj::LoadObj(
-           &attrib,
-           &shapes,
-           &materials,
-           &warn,
-           &err,
-           MODEL_PATH.c_str() ) )
+   auto lod0_indices = g_mesh_indices.subspan( g_mesh_lods[0].first_index, g_mesh_lods[0].index_count );
+   auto full_fetch = analyze_vertex_fetch( lod0_indices, g_mesh_vertices.size(), sizeof( Vertex ) );
+
+   if ( !packed_vertex_layout )
    {
-      throw std::runtime_error( warn + err );
+      g_vertex_quantization = {};
+      g_vertex_data = std::as_bytes( g_mesh_vertices );
+
+      std::cout << "vertex layout: full, " << g_vertex_data.size_bytes() << " bytes, "
+                << full_fetch.bytes_per_triangle << " bytes/triangle fetched" << std::endl;
+      return;
    }
 
-   g_indices.clear();
-   vertices.clear();
-   std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+   g_vertex_quantization = make_vertex_quantization( g_mesh_bounds );
+   pack_vertices( g_mesh_vertices, g_vertex_quantization, g_packed_vertices );
+   g_vertex_data = std::as_bytes( std::span<const packed_vertex_t>( g_packed_vertices ) );
+
+   auto packed_fetch = analyze_vertex_fetch( lod0_indices, g_mesh_vertices.size(), sizeof( packed_vertex_t ) );
+
+   // Vertex fetch is bandwidth bound, so fetched bytes stand in for vertex throughput
+   std::cout << "vertex layout: packed, " << g_vertex_data.size_bytes() << " bytes (full "
+             << g_mesh_vertices.size_bytes() << "), " << packed_fetch.bytes_per_triangle
+             << " bytes/triangle fetched (full " << full_fetch.bytes_per_triangle << ", "
+             << full_fetch.bytes_per_triangle / packed_fetch.bytes_per_triangle << "x)" << std::endl;
+}
+
+void vulkan_wrapper::build_meshlet_table()
+{
+   g_meshlets.clear();
+   g_lod_meshlets.clear();
+
+   meshlet_culling = mesh_import_options.meshlet_culling;
 
-   //
-   for ( const auto& shape : shapes )
+   if ( !meshlet_culling )
    {
-      for ( const auto& index : shape.mesh.indices )
+      return;
+   }
+
+   for ( const auto& lod : g_mesh_lods )
+   {
+      auto lod_meshlets =
+         build_meshlets( g_mesh_indices.subspan( lod.first_index, lod.index_count ), g_mesh_vertices );
+
+      for ( auto& meshlet : lod_meshlets )
       {
-         Vertex vertex{};
+         meshlet.first_index += lod.first_index;
+      }
+
+      g_lod_meshlets.push_back( {
+         .first_meshlet = static_cast<uint32_t>( g_meshlets.size() ),
+         .meshlet_count = static_cast<uint32_t>( lod_meshlets.size() ) } );
+
+      g_meshlets.insert( g_meshlets.end(), lod_meshlets.begin(), lod_meshlets.end() );
+   }
 
-         vertex.pos = {
-            attrib.vertices[3 * index.vertex_index + 0],
-            attrib.vertices[3 * index.vertex_index + 1],
-            attrib.vertices[3 * index.vertex_index + 2] };
+   std::cout << "meshlets: " << g_lod_meshlets[0].meshlet_count << " at LOD 0, " << g_meshlets.size()
+             << " in total, " << g_meshlets.size() * sizeof( meshlet_t ) << " bytes" << std::endl;
+}
+
+void vulkan_wrapper::choose_index_layout()
+{
+   // One index type serves the whole buffer, so every LOD has to fit 16-bit ranges.
+   // The culling pass reads the index buffer as uint32 storage, so it stays 32-bit.
+   g_indices16.clear();
+   g_lod_ranges.clear();
 
-         vertex.texCoord = {
-            attrib.texcoords[2 * index.texcoord_index + 0],
-            1.0f - attrib.texcoords[2 * index.texcoord_index + 1] };
+   if ( !meshlet_culling )
+   {
+      for ( const auto& lod : g_mesh_lods )
+      {
+         auto lod16 =
+            build_index16_buffer( g_mesh_indices.subspan( lod.first_index, lod.index_count ), max_index16_ranges );
 
-         vertex.color = { 1.0f, 1.0f, 1.0f };
+         if ( !lod16.has_value() )
+         {
+            g_indices16.clear();
+            g_lod_ranges.clear();
+            break;
+         }
 
-         if ( uniqueVertices.count( vertex ) == 0 )
+         for ( auto& range : lod16->ranges )
          {
-            uniqueVertices[vertex] = static_cast<uint32_t>( vertices.size() );
-            vertices.push_back( vertex );
+            range.first_index += static_cast<uint32_t>( g_indices16.size() );
          }
 
-         g_indices.push_back( uniqueVertices[vertex] );
+         g_indices16.insert( g_indices16.end(), lod16->indices.begin(), lod16->indices.end() );
+         g_lod_ranges.push_back( std::move( lod16->ranges ) );
+      }
+   }
+
+   if ( !g_lod_ranges.empty() )
+   {
+      g_index_type = VK_INDEX_TYPE_UINT16;
+      g_index_data = std::as_bytes( std::span<const uint16_t>( g_indices16 ) );
+   }
+   else
+   {
+      g_index_type = VK_INDEX_TYPE_UINT32;
+      g_index_data = std::as_bytes( g_mesh_indices );
+
+      for ( const auto& lod : g_mesh_lods )
+      {
+         g_lod_ranges.push_back( { {
+            .first_index = lod.first_index,
+            .index_count = lod.index_count,
+            .vertex_offset = 0 } } );
       }
    }
+
+   std::cout << "index buffer: " << ( g_index_type == VK_INDEX_TYPE_UINT16 ? 16 : 32 ) << "-bit, "
+             << g_lod_ranges[0].size() << " draw range(s) at LOD 0, " << g_index_data.size_bytes() << " bytes"
+             << std::endl;
+}
+
+auto vulkan_wrapper::select_lod(
+   const UniformBufferObject& ubo ) const
+   -> uint32_t
+{
+   // Nearest point of the mesh bounding sphere in view space
+   glm::vec3 center = ( g_mesh_bounds.min + g_mesh_bounds.max ) * 0.5f;
+   float radius = glm::length( g_mesh_bounds.max - g_mesh_bounds.min ) * 0.5f;
+
+   float model_scale = std::max( {
+      glm::length( glm::vec3( ubo.model[0] ) ),
+      glm::length( glm::vec3( ubo.model[1] ) ),
+      glm::length( glm::vec3( ubo.model[2] ) ) } );
+
+   glm::vec4 view_center = ubo.view * ubo.model * glm::vec4( center, 1.0f );
+   float distance = std::max( -view_center.z - radius * model_scale, camera_near_plane );
+
+   // proj[1][1] is the focal length for the vertical field of view in NDC units
+   float pixels_per_unit =
+      std::abs( ubo.proj[1][1] ) * 0.5f * static_cast<float>( swapchain_extent.height ) / distance;
+
+   uint32_t lod = 0;
+   while ( lod + 1 < g_mesh_lods.size() &&
+           g_mesh_lods[lod + 1].error * model_scale * pixels_per_unit <= max_lod_pixel_error )
+   {
+      ++lod;
+   }
+
+   return lod;
 }
 
 void vulkan_wrapper::generate_mipmaps(
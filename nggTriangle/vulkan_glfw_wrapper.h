@@ -1,7 +1,21 @@
 #pragma once
 
+#include "asset_archive.h"
+#include "asset_watcher.h"
+#include "device_allocator.h"
+#include "mesh_import.h"
+#include "mesh_types.h"
+#include "texture_cache.h"
+#include "texture_packer.h"
+#include "virtual_texture.h"
+
 #include <vulkan_utils/vulkan_utils.hpp>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
 #include <optional>
+#include <span>
 #include <vector>
 
 #define VK_USE_PLATFORM_WIN32_KHR
@@ -10,14 +24,6 @@
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-
-#pragma warning( disable : 4201 )
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp>
-
 using namespace datapath;
 
 void DestroyDebugUtilsMessengerEXT(
@@ -49,75 +55,123 @@ struct SwapChainSupportDetails
    std::vector<VkPresentModeKHR> presentModes;
 };
 
-struct Vertex
+// Vertex input state for the full Vertex layout, see packed_vertex_t for the compact one
+inline auto vertex_binding_description()
+   -> VkVertexInputBindingDescription
 {
-   glm::vec3 pos;
-   glm::vec3 color;
-   glm::vec2 texCoord;
+   VkVertexInputBindingDescription binding_description{};
+   binding_description.binding = 0;
+   binding_description.stride = sizeof( Vertex );
+   binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+   return binding_description;
+}
+
+inline auto vertex_attribute_descriptions()
+   -> std::array<
+      VkVertexInputAttributeDescription,
+      3>
+{
+   std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
 
-   bool operator==(
-      const Vertex& other ) const
-   {
-      return pos == other.pos && color == other.color && texCoord == other.texCoord;
-   }
+   attribute_descriptions[0].binding = 0;
+   attribute_descriptions[0].location = 0;
+   attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+   attribute_descriptions[0].offset = offsetof( Vertex, pos );
 
-   static
-   auto getBindingDescription()
-      -> VkVertexInputBindingDescription
-   {
-      VkVertexInputBindingDescription binding_description{};
-      binding_description.binding = 0;
-      binding_description.stride = sizeof( Vertex );
-      binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+   attribute_descriptions[1].binding = 0;
+   attribute_descriptions[1].location = 1;
+   attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+   attribute_descriptions[1].offset = offsetof( Vertex, color );
 
-      return binding_description;
-   }
+   attribute_descriptions[2].binding = 0;
+   attribute_descriptions[2].location = 2;
+   attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+   attribute_descriptions[2].offset = offsetof( Vertex, texCoord );
 
-   static
-   auto getAttributeDescriptions()
-      -> std::array<
-         VkVertexInputAttributeDescription,
-         3>
-   {
-      std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
+   return attribute_descriptions;
+}
 
-      attribute_descriptions[0].binding = 0;
-      attribute_descriptions[0].location = 0;
-      attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-      attribute_descriptions[0].offset = offsetof( Vertex, pos );
+struct UniformBufferObject
+{
+   alignas(16) glm::mat4 model;
+   alignas(16) glm::mat4 view;
+   alignas(16) glm::mat4 proj;
+   // Vertex position dequantisation, identity for the full Vertex layout
+   alignas(16) glm::vec4 position_scale;
+   alignas(16) glm::vec4 position_offset;
+   // Meshlets of the current LOD, read by the culling pass
+   alignas(16) uint32_t first_meshlet;
+   uint32_t meshlet_count;
+};
 
-      attribute_descriptions[1].binding = 0;
-      attribute_descriptions[1].location = 1;
-      attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-      attribute_descriptions[1].offset = offsetof( Vertex, color );
+// Per draw material pushed to the fragment shader: its texture table entry and where
+// the texture sits in that array, see texture_remap_t
+struct material_push_constants_t
+{
+   glm::vec4 texture_transform;
+   glm::vec4 texture_bounds;
+   uint32_t texture_index;
+   uint32_t texture_layer;
+   // Swapchain pixel to virtual texture feedback texel
+   glm::vec2 feedback_scale;
+};
+
+// Model buffers recorded by the loader task, installed by the render loop once the
+// fence of their upload has signalled
+struct mesh_upload_t
+{
+   VkCommandPool_resource_shared_t command_pool;
+   std::vector<command_buffer_wrapper_t> command_buffers;
+   datapath::VkFence_resource_t fence;
+   std::vector<std::pair<VkBuffer_resource_t, device_allocation_t>> staging_buffers;
 
-      attribute_descriptions[2].binding = 0;
-      attribute_descriptions[2].location = 2;
-      attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-      attribute_descriptions[2].offset = offsetof( Vertex, texCoord );
+   VkBuffer_resource_t vertex_buffer;
+   device_allocation_t vertex_buffer_memory;
+   VkBuffer_resource_t index_buffer;
+   device_allocation_t index_buffer_memory;
+   VkBuffer_resource_t meshlet_buffer;
+   device_allocation_t meshlet_buffer_memory;
+};
 
-      return attribute_descriptions;
-   }
+// Slot in the texture table filled by load_textures()
+struct texture_handle_t
+{
+   uint32_t index;
 };
 
-namespace std
+// Array view and sampler of a texture, both null until its array has been uploaded,
+// its entry in the texture table and where in the array the texture is
+struct texture_binding_t
 {
-template <>
-struct hash<Vertex>
+   VkImageView view{ VK_NULL_HANDLE };
+   VkSampler sampler{ VK_NULL_HANDLE };
+   uint32_t table_index{ 0 };
+   texture_remap_t remap;
+};
+
+struct texture_slot_t
 {
-   size_t operator()( const Vertex& vertex ) const
-   {
-      return ( ( hash<glm::vec3>()( vertex.pos ) ^ ( hash<glm::vec3>()( vertex.color ) << 1 ) ) >> 1 ) ^
-             ( hash<glm::vec2>()( vertex.texCoord ) << 1 );
-   }
+   VkFormat format{ VK_FORMAT_UNDEFINED };
+   uint32_t width{ 0 };
+   uint32_t height{ 0 };
+   uint32_t mip_levels{ 0 };
+   // Index into texture_arrays
+   uint32_t array{ 0 };
+   texture_remap_t remap;
+   // Its layer and rectangle in the array, placement.array being array as well
+   texture_placement_t placement;
 };
-};   // namespace std
 
-struct UniformBufferObject
+// A layered image holding the textures plan_texture_packing() grouped together,
+// bound through one descriptor
+struct texture_array_slot_t
 {
-   alignas(16) glm::mat4 model;
-   alignas(16) glm::mat4 view;
-   alignas(16) glm::mat4 proj;
+   texture_array_desc_t desc;
+   VkImage_resource_t image;
+   device_allocation_t image_memory;
+   VkImageView_resource_t view;
+   VkSampler_resource_t sampler;
 };
 
 
@@ -173,6 +227,47 @@ public:
       cleanup();
    }
 
+   void set_mesh_import_options(
+      const mesh_import_options_t& options )
+   {
+      mesh_import_options = options;
+   }
+
+   // Assets are read from this archive, and from loose files only where it lacks them
+   void set_asset_archive(
+      const std::filesystem::path& path )
+   {
+      asset_archive_path = path;
+   }
+
+   // Hashes every archive entry on opening and refuses damaged archives. Always on in
+   // debug builds.
+   void set_verify_asset_archive(
+      bool enable )
+   {
+      verify_asset_archive = enable;
+   }
+
+   // Packs the model and the textures with whichever of their caches exist below the
+   // working directory. The shaders are embedded in the executable.
+   static
+   void pack_assets(
+      const std::filesystem::path& archive_path );
+
+   // The model samples this virtual texture file instead of its regular texture
+   void set_virtual_texture(
+      const std::filesystem::path& path )
+   {
+      virtual_texture_path = path;
+   }
+
+   // Loose shaders, model and textures are reloaded while running when their files change
+   void set_hot_reload(
+      bool enable )
+   {
+      hot_reload = enable;
+   }
+
 protected:
 
 private:
@@ -190,6 +285,8 @@ private:
 
    std::optional<datapath::physical_device_wrapper_t> physical_device;
    std::shared_ptr<const datapath::device_dispatcher_t> logical_device;
+   // Every buffer and image below is bound to memory from it, so it is destroyed after them
+   std::unique_ptr<device_allocator_t> device_allocator;
 
    std::optional<datapath::queue_wrapper_t> graphics_queue{};
    std::optional<datapath::queue_wrapper_t> present_queue{};
@@ -206,41 +303,149 @@ private:
    VkPipelineLayout_resource_t pipeline_layout;
    std::vector<datapath::VkPipeline_resource_t> graphics_pipeline;
 
+   // Created once from the embedded SPIR-V, so rebuilding a pipeline reads no files.
+   // fragment_shader_module is the virtual texturing variant when that is enabled.
+   VkShaderModule_resource_t vertex_shader_module;
+   VkShaderModule_resource_t packed_vertex_shader_module;
+   VkShaderModule_resource_t fragment_shader_module;
+   VkShaderModule_resource_t cull_shader_module;
+
    VkCommandPool_resource_shared_t command_pool;
    std::vector<command_buffer_wrapper_t> command_buffers;
 
    VkBuffer_resource_t vertex_buffer;
-   VkDeviceMemory_resource_t vertex_buffer_memory;
+   device_allocation_t vertex_buffer_memory;
    VkBuffer_resource_t index_buffer;
-   VkDeviceMemory_resource_t index_buffer_memory;
+   device_allocation_t index_buffer_memory;
    std::vector<VkBuffer_resource_t> uniform_buffers;
-   std::vector<VkDeviceMemory_resource_t> uniform_buffers_memory;
+   std::vector<device_allocation_t> uniform_buffers_memory;
 
    datapath::VkDescriptorPool_resource_shared_t descriptor_pool;
    datapath::VkDescriptorSet_resource_t descriptor_sets;
 
+   // Meshlet culling: a compute pass per frame packs the visible meshlets' indices
+   // into visible_index_buffers and the index count into draw_command_buffers
+   bool meshlet_culling{ false };
+   VkDescriptorSetLayout_resource_t cull_descriptor_set_layout;
+   VkPipelineLayout_resource_t cull_pipeline_layout;
+   std::vector<datapath::VkPipeline_resource_t> cull_pipeline;
+   VkBuffer_resource_t meshlet_buffer;
+   device_allocation_t meshlet_buffer_memory;
+   std::vector<VkBuffer_resource_t> visible_index_buffers;
+   std::vector<device_allocation_t> visible_index_buffers_memory;
+   std::vector<VkBuffer_resource_t> draw_command_buffers;
+   std::vector<device_allocation_t> draw_command_buffers_memory;
+   datapath::VkDescriptorPool_resource_shared_t cull_descriptor_pool;
+   datapath::VkDescriptorSet_resource_t cull_descriptor_sets;
+
    VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
-   uint32_t mip_levels;
-   VkImage_resource_t texture_image;
-   VkDeviceMemory_resource_t texture_image_memory;
-   VkImageView_resource_t texture_image_view;
-   VkSampler_resource_t texture_sampler;
+   // Every loaded texture, indexed by texture_handle_t, and the arrays they were packed
+   // into. The model samples model_texture.
+   std::vector<texture_slot_t> textures;
+   std::vector<texture_array_slot_t> texture_arrays;
+
+   // Binding 1 is a table of every texture array, entry i holding texture_arrays[i].
+   // With descriptor indexing it is large, partially bound and written as arrays are
+   // published. Without, it is small and fully written, and a frame's set only takes
+   // new entries once that frame's fence has signalled.
+   bool bindless_textures{ false };
+   uint32_t texture_table_size{ 0 };
+   std::vector<std::vector<uint32_t>> pending_texture_table_writes;
+
+   // Virtual texturing: pages live in slots of page_cache_image and page_table_image maps
+   // every page to the finest resident one. Each frame the fragment shader writes the
+   // pages it wanted to its feedback buffer, which is read back once that frame's fence
+   // has signalled; the pages then uploaded are copied from page_staging_buffers at the
+   // start of the next frame recorded with them.
+   std::optional<std::filesystem::path> virtual_texture_path;
+   std::unique_ptr<virtual_texture_file_t> virtual_texture_file;
+   std::unique_ptr<virtual_texture_cache_t> virtual_texture_cache;
+   VkImage_resource_t page_cache_image;
+   device_allocation_t page_cache_image_memory;
+   VkImageView_resource_t page_cache_view;
+   VkSampler_resource_t page_cache_sampler;
+   VkImage_resource_t page_table_image;
+   device_allocation_t page_table_image_memory;
+   VkImageView_resource_t page_table_view;
+   VkSampler_resource_t page_table_sampler;
+   std::vector<VkBuffer_resource_t> feedback_buffers;
+   std::vector<device_allocation_t> feedback_buffers_memory;
+   std::vector<VkBuffer_resource_t> page_staging_buffers;
+   std::vector<device_allocation_t> page_staging_buffers_memory;
+   std::vector<std::vector<VkBufferImageCopy>> page_copies;
+   std::vector<std::vector<VkBufferImageCopy>> page_table_copies;
+   std::chrono::steady_clock::time_point virtual_texture_report_time;
+
+   texture_handle_t model_texture{ 0 };
+   // Handle of each TEXTURE_PATHS entry
+   std::vector<texture_handle_t> source_textures;
 
    VkImage_resource_t color_image;
-   VkDeviceMemory_resource_t color_image_memory;
+   device_allocation_t color_image_memory;
    VkImageView_resource_t color_image_view;
 
    VkImage_resource_t depth_image;
-   VkDeviceMemory_resource_t depth_image_memory;
+   device_allocation_t depth_image_memory;
    VkImageView_resource_t depth_image_view;
 
    std::vector<datapath::VkSemaphore_resource_t> image_available_semaphores;
    std::vector<datapath::VkSemaphore_resource_t> render_finished_semaphores;
    std::vector<datapath::VkFence_resource_t> in_flight_fences;
    uint32_t current_frame = 0;
+   // Frames drawn so far
+   uint64_t frame_number{ 0 };
 
    bool framebuffer_resized{ false };
 
+   // Mapped for the whole run; the mesh cache and texture caches read from it in place
+   std::optional<std::filesystem::path> asset_archive_path;
+   asset_archive_t asset_archive;
+#ifdef NDEBUG
+   bool verify_asset_archive{ false };
+#else
+   bool verify_asset_archive{ true };
+#endif
+
+   mesh_import_options_t mesh_import_options{};
+   bool packed_vertex_layout{ false };
+   uint32_t current_lod{ 0 };
+
+   // Model streaming: nothing loaded by the loader task is read by the render loop
+   // before model_resident is set
+   std::future<mesh_upload_t> model_stream;
+   std::optional<mesh_upload_t> pending_upload;
+   bool model_resident{ false };
+   std::chrono::steady_clock::time_point init_start_time;
+   bool first_frame_reported{ false };
+   bool first_model_frame_reported{ false };
+
+   // Hot reload: replaced resources are retired with the frame number they were replaced
+   // in and destroyed once every frame in flight then has finished, so nothing waits for
+   // the device to go idle
+   struct retired_resource_t
+   {
+      uint64_t frame;
+      std::shared_ptr<void> resource;
+   };
+
+   // A reloaded texture's texels, copied over its layer of a shared array at the start of
+   // the next frame recorded, see rewrite_texture()
+   struct texture_rewrite_t
+   {
+      VkBuffer_resource_t staging_buffer;
+      device_allocation_t staging_buffer_memory;
+      VkImage image;
+      uint32_t layer;
+      uint32_t mip_levels;
+      std::vector<texture_region_t> regions;
+   };
+
+   bool hot_reload{ false };
+   std::unique_ptr<asset_watcher_t> asset_watcher;
+   std::deque<retired_resource_t> retired_resources;
+   std::vector<texture_rewrite_t> pending_texture_rewrites;
+   bool model_reload_requested{ false };
+
    // local functions
 
    virtual
@@ -301,6 +506,9 @@ private:
    auto check_device_extension_support(
       const physical_device_wrapper_t& device )
       -> bool;
+   auto supports_descriptor_indexing(
+      const physical_device_wrapper_t& device )
+      -> bool;
 
    void create_logical_device();
 
@@ -334,54 +542,144 @@ private:
    void create_command_buffer();
 
    void load_model();
+   void choose_vertex_layout();
+   void choose_index_layout();
+   void build_meshlet_table();
+   auto select_lod(
+      const UniformBufferObject& ubo ) const
+      -> uint32_t;
 
    // Loading shader
-   static
    auto read_file(
-      const std::string& filename )
-      -> std::vector<char>;
+      const std::string& filename ) const
+      -> asset_data_t;
 
    auto create_shader_module(
-      const std::vector<char>& code )
+      std::span<const uint32_t> code )
       -> VkShaderModule_resource_t;
+   void create_shader_modules();
+
+   // Model streaming
+   void start_model_streaming();
+   void wait_for_model();
+   auto prepare_model_upload(
+      uint32_t queue_family )
+      -> mesh_upload_t;
+   auto stage_buffer(
+      mesh_upload_t& upload,
+      std::span<const std::byte> contents,
+      VkBufferUsageFlags usage )
+      -> std::pair<
+         VkBuffer_resource_t,
+         device_allocation_t>;
+   void submit_model_upload(
+      mesh_upload_t& upload );
+   void poll_model_stream();
+   void install_model(
+      mesh_upload_t& upload );
+   void report_frame_times();
+
+   // Hot reload
+   void watch_assets();
+   void reload_changed_assets();
+   auto reload_shader_module(
+      const std::string& name )
+      -> bool;
+   void reload_graphics_pipeline();
+   void reload_cull_pipeline();
+   void reload_model();
+   void reload_texture(
+      texture_handle_t handle,
+      const std::filesystem::path& source );
+   auto rewrite_texture(
+      texture_handle_t handle,
+      const std::filesystem::path& source )
+      -> bool;
+   void record_texture_rewrites(
+      const command_buffer_wrapper_t& command_buffer );
+   void release_retired_resources();
+
+   template <typename resource_t>
+   void retire(
+      resource_t resource )
+   {
+      retired_resources.push_back( { frame_number, std::make_shared<resource_t>( std::move( resource ) ) } );
+   }
 
    // Buffer related methods
-   void create_vertex_buffer();
-   void create_index_buffer();
    void create_uniform_buffers();
    void create_descriptor_pool();
    void create_descriptor_sets();
 
+   // Meshlet culling
+   void create_meshlet_buffers();
+   void create_cull_pipeline();
+   void create_cull_descriptor_sets();
+   void record_meshlet_culling(
+      command_buffer_wrapper_t& command_buffer );
+
    auto create_buffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties )
       -> std::pair<
          VkBuffer_resource_t,
-         VkDeviceMemory_resource_t>;
+         device_allocation_t>;
+   auto create_device_local_buffer(
+      std::span<const std::byte> contents,
+      VkBufferUsageFlags usage )
+      -> std::pair<
+         VkBuffer_resource_t,
+         device_allocation_t>;
    void copy_buffer(
       VkBuffer srcBuffer,
       VkBuffer dstBuffer,
       VkDeviceSize size );
 
-   auto find_memory_type(
-      uint32_t typeFilter,
-      VkMemoryPropertyFlags properties )
-      -> uint32_t;
-
    // Descriptors
    void create_descriptor_set_layout();
+   void publish_texture_array(
+      uint32_t array );
+   void write_texture_table(
+      size_t frame,
+      std::span<const uint32_t> entries );
+   void flush_texture_table(
+      size_t frame );
+
+   // Virtual texturing
+   void create_virtual_texture();
+   void update_virtual_texture(
+      uint32_t frame );
+   void record_virtual_texture_uploads(
+      const command_buffer_wrapper_t& command_buffer );
+   void record_feedback_readback(
+      const command_buffer_wrapper_t& command_buffer );
 
    // Images
-   void create_texture_image();
-   void create_texture_image_view();
-   void create_texture_sampler();
+   auto load_textures(
+      std::span<const std::filesystem::path> sources )
+      -> std::vector<texture_handle_t>;
+   auto texture_binding(
+      texture_handle_t handle ) const
+      -> texture_binding_t;
+   auto create_texture_sampler(
+      uint32_t mip_levels )
+      -> VkSampler_resource_t;
+   auto choose_texture_format()
+      -> VkFormat;
+   auto host_cached_memory_properties()
+      -> VkMemoryPropertyFlags;
+   auto is_texture_format_supported(
+      VkFormat format )
+      -> bool;
 
    auto create_image_view(
       VkImage image,
       VkFormat format,
       VkImageAspectFlags aspectFlags,
-      uint32_t mipLevels )
+      uint32_t mipLevels,
+      VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D,
+      uint32_t layer_count = 1 )
       -> VkImageView_resource_t;
 
    auto create_image(
@@ -392,10 +690,11 @@ private:
       VkFormat format,
       VkImageTiling tiling,
       VkBufferUsageFlags usage,
-      VkMemoryPropertyFlags properties )
+      VkMemoryPropertyFlags properties,
+      uint32_t array_layers = 1 )
       -> std::pair<
          VkImage_resource_t,
-         VkDeviceMemory_resource_t>;
+         device_allocation_t>;
 
    void create_color_resources();
 
@@ -413,6 +712,14 @@ private:
       uint32_t width,
       uint32_t height );
 
+   // Region offsets relative to buffer_offset, see texture_pack_t::regions()
+   void copy_levels_to_image(
+      const command_buffer_wrapper_t& command_buffer,
+      VkBuffer buffer,
+      VkDeviceSize buffer_offset,
+      VkImage image,
+      std::span<const texture_region_t> regions );
+
    void generate_mipmaps(
       VkImage image,
       VkFormat imageFormat,
@@ -438,6 +745,8 @@ private:
    void record_command_buffer(
       command_buffer_wrapper_t& command_buffer,
       uint32_t imageIndex );
+   void record_model_draw(
+      command_buffer_wrapper_t& command_buffer );
 
    virtual
    void draw_frame();